@@ -1,19 +1,27 @@
 package gua
 
 /*
+#include <stdint.h>
 #include "include/pjsua.h"
+#include "include/ps_event_ring.h"
 
+static void *account_handle(uintptr_t handle) {
+	return (void*)handle;
+}
 
 */
 import "C"
 import (
 	"errors"
 	"fmt"
+	"sync"
 	"unsafe"
 )
 
 type accountConfig struct {
 	accCfg *C.struct_pjsua_acc_config
+	// strings of accCfg, pjsua_acc_add copies them
+	arena strArena
 }
 
 func NewAccountConfig() *accountConfig {
@@ -27,11 +35,11 @@ func NewAccountConfig() *accountConfig {
 }
 
 func (af *accountConfig) SetIdUri(idUri string) {
-	af.accCfg.id = str2Pj(idUri)
+	af.accCfg.id = af.arena.str2Pj(idUri)
 }
 
 func (af *accountConfig) SetRegistrarUri(regUri string) {
-	af.accCfg.reg_uri = str2Pj(regUri)
+	af.accCfg.reg_uri = af.arena.str2Pj(regUri)
 }
 
 func (af *accountConfig) SetRegistrarTimeoutSecond(timeoutSec int) {
@@ -42,25 +50,33 @@ func (af *accountConfig) AddAuthCred(aci *authCredInfo) {
 	count := af.accCfg.cred_count
 	dst := &af.accCfg.cred_info[count]
 
-	dst.realm = str2Pj(aci.realm)
-	dst.scheme = str2Pj(aci.scheme)
-	dst.username = str2Pj(aci.username)
+	dst.realm = af.arena.str2Pj(aci.realm)
+	dst.scheme = af.arena.str2Pj(aci.scheme)
+	dst.username = af.arena.str2Pj(aci.username)
 	dst.data_type = C.int(aci.dataType)
-	dst.data = str2Pj(aci.data)
+	dst.data = af.arena.str2Pj(aci.data)
 
 	// TODO fix this bug
-	// dst.ext.aka.k = str2Pj(aci.akaK)
-	// dst.ext.aka.op = str2Pj(aci.akaOp)
-	// dst.ext.aka.amf = str2Pj(aci.akaAmf)
+	// dst.ext.aka.k = af.arena.str2Pj(aci.akaK)
+	// dst.ext.aka.op = af.arena.str2Pj(aci.akaOp)
+	// dst.ext.aka.amf = af.arena.str2Pj(aci.akaAmf)
 
 	af.accCfg.cred_count = count + 1
 }
 
+// Reset sets the config back to the defaults so it can be filled for the
+// next account, the strings of the previous one are released.
+func (af *accountConfig) Reset() {
+	C.pjsua_acc_config_default(af.accCfg)
+	af.arena.reset()
+}
+
 func (af *accountConfig) Free() {
 	if af.accCfg != nil {
 		C.free(unsafe.Pointer(af.accCfg))
 		af.accCfg = nil
 	}
+	af.arena.free()
 }
 
 type AccountId C.pjsua_acc_id
@@ -68,25 +84,98 @@ type AccountId C.pjsua_acc_id
 type Account struct {
 	id C.pjsua_acc_id
 	gc *GuaContext
+	// pjsua user data of the account, 0 until created
+	handle uintptr
 }
 
 func (gc *GuaContext) NewAccount() *Account {
 	return &Account{gc: gc}
 }
 
+/****************************account handles*******************************/
+
+// The pjsua user data of an account is a handle into accountHandles, the
+// events copy it when they are posted. The event reader resolves it without
+// asking pjsua, the account may be deleted or pjsua destroyed by then.
+var (
+	accountHandlesMutex sync.Mutex
+	accountHandles      = make(map[uintptr]*Account)
+	nextAccountHandle   uintptr
+)
+
+func (ac *Account) takeHandle() {
+	accountHandlesMutex.Lock()
+	defer accountHandlesMutex.Unlock()
+
+	if ac.handle == 0 {
+		nextAccountHandle++
+		ac.handle = nextAccountHandle
+	}
+	accountHandles[ac.handle] = ac
+}
+
+func accountOfHandle(handle uintptr) *Account {
+	accountHandlesMutex.Lock()
+	defer accountHandlesMutex.Unlock()
+
+	return accountHandles[handle]
+}
+
+func forgetAccountHandle(handle uintptr) {
+	accountHandlesMutex.Lock()
+	defer accountHandlesMutex.Unlock()
+
+	delete(accountHandles, handle)
+}
+
+// releaseHandle forgets the handle once the events already posted for the
+// account are read.
+func (ac *Account) releaseHandle() {
+	if ac.handle == 0 {
+		return
+	}
+
+	var ev C.ps_event
+	C.ps_event_fill_acc_released(&ev, C.account_handle(C.uintptr_t(ac.handle)))
+	if !postEvent(&ev) {
+		forgetAccountHandle(ac.handle)
+	}
+}
+
+// forgetAccountHandles forgets the accounts of a context, after its events
+// were read.
+func forgetAccountHandles(gc *GuaContext) {
+	accountHandlesMutex.Lock()
+	defer accountHandlesMutex.Unlock()
+
+	for handle, ac := range accountHandles {
+		if ac.gc == gc {
+			delete(accountHandles, handle)
+		}
+	}
+}
+
 func (ac *Account) Create(af *accountConfig, makeDefault bool) error {
 	iMakeDefault := 0
 	if makeDefault {
 		iMakeDefault = 1
 	}
 
-	af.accCfg.user_data = unsafe.Pointer(ac)
+	ac.takeHandle()
+	af.accCfg.user_data = C.account_handle(C.uintptr_t(ac.handle))
+
+	err := ac.gc.exec.run(func() error {
+		if ret := C.pjsua_acc_add(af.accCfg, C.int(iMakeDefault), &ac.id); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Create account error: %d", ret))
+		}
 
-	if ret := C.pjsua_acc_add(af.accCfg, C.int(iMakeDefault), &ac.id); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Create account error: %d", ret))
+		return nil
+	})
+	if err != nil {
+		ac.releaseHandle()
 	}
 
-	return nil
+	return err
 }
 
 func (ac *Account) IsValid() bool {
@@ -94,7 +183,10 @@ func (ac *Account) IsValid() bool {
 }
 
 func (ac *Account) SetDefault() {
-	C.pjsua_acc_set_default(ac.id)
+	ac.gc.exec.run(func() error {
+		C.pjsua_acc_set_default(ac.id)
+		return nil
+	})
 }
 
 func (ac *Account) IsDefault() bool {
@@ -103,13 +195,18 @@ func (ac *Account) IsDefault() bool {
 
 func (ac *Account) Shutdown() {
 	if ac.IsValid() && C.pjsua_get_state() < C.PJSUA_STATE_CLOSING {
-		C.pjsua_acc_del(ac.id)
+		ac.gc.exec.run(func() error {
+			C.pjsua_acc_del(ac.id)
+			return nil
+		})
+		ac.releaseHandle()
 	}
 }
 
 type StatusCode C.enum_pjsip_status_code
 
 type AccountInfo struct {
+	id              AccountId
 	isDefault       bool
 	uri             string
 	regIsConfigured bool
@@ -124,6 +221,10 @@ type AccountInfo struct {
 	onlineStatusText string
 }
 
+func (ai *AccountInfo) Id() AccountId {
+	return ai.id
+}
+
 func (ai *AccountInfo) IsDefault() bool {
 	return ai.isDefault
 }
@@ -167,13 +268,20 @@ func (ai *AccountInfo) OnlineStatusText() string {
 func (ac *Account) GetInfo() (*AccountInfo, error) {
 	pai := &C.struct_pjsua_acc_info{}
 
-	ac.gc.checkThread()
-	if ret := C.pjsua_acc_get_info(ac.id, pai); ret != C.PJ_SUCCESS {
-		return nil, errors.New(fmt.Sprintf("account get info error: %d", ret))
+	err := ac.gc.exec.run(func() error {
+		if ret := C.pjsua_acc_get_info(ac.id, pai); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("account get info error: %d", ret))
+		}
+
+		return nil
+	})
+	if err != nil {
+		return nil, err
 	}
 
 	ai := &AccountInfo{}
 
+	ai.id = AccountId(pai.id)
 	ai.isDefault = pai.is_default != 0
 	ai.uri = pj2Str(&pai.acc_uri)
 	ai.regIsConfigured = pai.has_registration != 0
@@ -213,9 +321,10 @@ func (cs *callSetting) SetFlag(flag int) {
 }
 
 func (ac *Account) MakePlay(dstUri string) (*Call, error) {
+	var arena strArena
+	defer arena.free()
 
-	ac.gc.checkThread()
-	pj_dst_uri := str2Pj(dstUri)
+	pj_dst_uri := arena.str2Pj(dstUri)
 
 	call := &Call{}
 
@@ -223,9 +332,17 @@ func (ac *Account) MakePlay(dstUri string) (*Call, error) {
 	setting.SetAudioCount(0)
 	setting.SetFlag(0)
 
-	if ret := C.pjsua_call_make_play(ac.id, &pj_dst_uri, &setting.setting, nil, nil, &call.id); ret != C.PJ_SUCCESS {
-		return nil, errors.New(fmt.Sprintf("Make play error: %d", ret))
+	err := ac.gc.exec.run(func() error {
+		if ret := C.pjsua_call_make_play(ac.id, &pj_dst_uri, &setting.setting, nil, nil, &call.id); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Make play error: %d", ret))
+		}
+
+		return nil
+	})
+	if err != nil {
+		return nil, err
 	}
+
 	return call, nil
 }
 
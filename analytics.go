@@ -0,0 +1,195 @@
+package gua
+
+/*
+#include "include/ps_analytics.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"log"
+	"sync"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// FrameScores are the analytics of one decoded frame, computed on the
+// downscaled luma plane.
+type FrameScores struct {
+	MeanLuma float32
+	// part of the picture darker than 32, close to 1 for black frames
+	DarkRatio float32
+	Contrast  float32
+	// variance of the laplacian, low for blurred pictures
+	Sharpness float32
+	// mean abs luma difference to the previous frame of the stream
+	Motion float32
+	// part of the picture which changed more than the motion threshold
+	MotionArea float32
+	// part of the picture in the fullest histogram bin, high when occluded
+	DominantBin float32
+	// false for the first frame of a stream, motion is 0 then
+	HasPrevious bool
+	// frames in a row, this one included, without any changed cell
+	FrozenFrames int
+}
+
+// AnalyticsConsumer receives the scores of every analysed frame.
+type AnalyticsConsumer interface {
+	OnScores(calleeId string, scores *FrameScores)
+}
+
+/****************************analytics config*******************************/
+type analyticsConfig struct {
+	gridWidth       int
+	motionThreshold int
+	suppressStill   bool
+	minMotionArea   float32
+}
+
+func NewAnalyticsConfig() *analyticsConfig {
+	return &analyticsConfig{gridWidth: 160, motionThreshold: 12, minMotionArea: 0.002}
+}
+
+// SetGridWidth sets the width pictures are scaled to before analysis, 8 to
+// 1024.
+func (ac *analyticsConfig) SetGridWidth(gridWidth int) *analyticsConfig {
+	ac.gridWidth = gridWidth
+	return ac
+}
+
+// SetMotionThreshold sets the luma difference a grid cell needs to count
+// as changed.
+func (ac *analyticsConfig) SetMotionThreshold(motionThreshold int) *analyticsConfig {
+	ac.motionThreshold = motionThreshold
+	return ac
+}
+
+// SetSuppressStill skips the jpeg encode of frames whose changed area is
+// below minMotionArea. The first frame of a stream is always encoded.
+func (ac *analyticsConfig) SetSuppressStill(suppressStill bool, minMotionArea float32) *analyticsConfig {
+	ac.suppressStill = suppressStill
+	ac.minMotionArea = minMotionArea
+	return ac
+}
+
+/****************************stream analytics*******************************/
+
+// streamAnalytics is the grid of the previous frame of a stream.
+type streamAnalytics struct {
+	mutex  sync.Mutex
+	grid   *C.ps_analytics_grid
+	width  int
+	frozen int
+}
+
+func (sa *streamAnalytics) free() {
+	sa.mutex.Lock()
+	defer sa.mutex.Unlock()
+
+	if sa.grid != nil {
+		C.ps_analytics_grid_destroy(sa.grid)
+		sa.grid = nil
+	}
+}
+
+var (
+	analyticsMutex    sync.RWMutex
+	analytics         *analyticsConfig
+	analyticsConsumer AnalyticsConsumer
+)
+
+// EnableAnalytics scores every decoded frame with ac, nil disables it.
+// Scores go to ac consumer and to DecodedFrame.Scores.
+func EnableAnalytics(ac *analyticsConfig, consumer AnalyticsConsumer) error {
+	if ac != nil && (ac.gridWidth < 8 || ac.gridWidth > 1024) {
+		return errors.New(fmt.Sprintf("invalid analytics grid width: %d", ac.gridWidth))
+	}
+
+	analyticsMutex.Lock()
+	defer analyticsMutex.Unlock()
+
+	if ac != nil {
+		c := *ac
+		analytics = &c
+	} else {
+		analytics = nil
+	}
+	analyticsConsumer = consumer
+
+	return nil
+}
+
+func (ss *streamState) analytics() *streamAnalytics {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	if ss.analyticsState == nil {
+		ss.analyticsState = &streamAnalytics{}
+	}
+
+	return ss.analyticsState
+}
+
+// analyseFrame scores the frame, it returns nil when analytics are off or
+// failed. still tells the jpeg encode can be skipped.
+func analyseFrame(ss *streamState, frame *gmf.Frame) (scores *FrameScores, still bool) {
+	analyticsMutex.RLock()
+	ac, consumer := analytics, analyticsConsumer
+	analyticsMutex.RUnlock()
+
+	if ac == nil {
+		return nil, false
+	}
+
+	sa := ss.analytics()
+	sa.mutex.Lock()
+
+	if sa.grid == nil || sa.width != ac.gridWidth {
+		if sa.grid != nil {
+			C.ps_analytics_grid_destroy(sa.grid)
+			sa.grid = nil
+		}
+		if ret := C.ps_analytics_grid_create(C.int(ac.gridWidth), &sa.grid); ret != C.PJ_SUCCESS {
+			sa.mutex.Unlock()
+			log.Printf("callee[%s] create analytics grid error: %d\n", ss.calleeId, ret)
+			return nil, false
+		}
+		sa.width, sa.frozen = ac.gridWidth, 0
+	}
+
+	var cs C.ps_analytics_scores
+	if ret := C.ps_analytics_run(sa.grid, avFrame(frame), C.int(ac.motionThreshold), &cs); ret != C.PJ_SUCCESS {
+		sa.mutex.Unlock()
+		log.Printf("callee[%s] analytics error: %d\n", ss.calleeId, ret)
+		return nil, false
+	}
+
+	scores = &FrameScores{
+		MeanLuma:    float32(cs.mean_luma),
+		DarkRatio:   float32(cs.dark_ratio),
+		Contrast:    float32(cs.contrast),
+		Sharpness:   float32(cs.sharpness),
+		Motion:      float32(cs.motion),
+		MotionArea:  float32(cs.motion_area),
+		DominantBin: float32(cs.dominant_bin),
+		HasPrevious: cs.has_previous != C.PJ_FALSE,
+	}
+
+	if scores.HasPrevious && cs.motion_area == 0 {
+		sa.frozen++
+	} else {
+		sa.frozen = 0
+	}
+	scores.FrozenFrames = sa.frozen
+	sa.mutex.Unlock()
+
+	if consumer != nil {
+		consumer.OnScores(ss.calleeId, scores)
+	}
+
+	still = ac.suppressStill && scores.HasPrevious && scores.MotionArea < ac.minMotionArea
+
+	return scores, still
+}
@@ -1,50 +1,156 @@
 package gua
 
 /*
+#include <stdlib.h>
 #include "include/pjsua.h"
+#include "include/ps_event_ring.h"
 
 */
 import "C"
+import "unsafe"
 
 /****************************call back*******************************/
 type CallbackOnRegStarted interface {
 	OnRegStarted(acc *Account, accId AccountId, renew bool)
 }
 
-//export callback_on_reg_started
-func callback_on_reg_started(acc_id C.pjsua_acc_id, renew C.pj_bool_t) {
-	user_data := C.pjsua_acc_get_user_data(acc_id)
-	if user_data != nil {
-		acc := (*Account)(user_data)
-		if acc.gc != nil {
-			if cb, ok := acc.gc.callback.(CallbackOnRegStarted); ok {
-				cb.OnRegStarted(acc, AccountId(acc_id), renew > 0)
-			}
-		}
-	}
-}
-
+// RegInfo is a copy of the registration result, callbacks run after the
+// sip stack released it.
 type RegInfo struct {
-	info *C.struct_pjsua_reg_info
+	Status     int
+	Code       int
+	Reason     string
+	Expiration int
+	Renew      bool
 }
 
-func NewRegInfo(info *C.pjsua_reg_info) *RegInfo {
-	return &RegInfo{info: info}
+func newRegInfo(ev *C.ps_event) *RegInfo {
+	return &RegInfo{
+		Status:     int(ev.status),
+		Code:       int(ev.code),
+		Reason:     C.GoString(&ev.reason[0]),
+		Expiration: int(ev.expiration),
+		Renew:      ev.renew != C.PJ_FALSE,
+	}
 }
 
 type CallbackOnRegState2 interface {
 	OnRegState2(acc *Account, accId AccountId, info *RegInfo)
 }
 
-//export callback_on_reg_state2
-func callback_on_reg_state2(acc_id C.pjsua_acc_id, info *C.pjsua_reg_info) {
-	user_data := C.pjsua_acc_get_user_data(acc_id)
-	if user_data != nil {
-		acc := (*Account)(user_data)
-		if acc.gc != nil {
-			if cb, ok := acc.gc.callback.(CallbackOnRegState2); ok {
-				cb.OnRegState2(acc, AccountId(acc_id), NewRegInfo(info))
-			}
+type CallbackOnCallState interface {
+	OnCallState(acc *Account, callId int, ev *Event)
+}
+
+type CallbackOnCallMediaState interface {
+	OnCallMediaState(acc *Account, callId int, ev *Event)
+}
+
+type CallbackOnPager interface {
+	OnPager(acc *Account, from string, to string, mimeType string, body []byte)
+}
+
+// callbackSubscriber hands the bus events to the callback interfaces the
+// context callback implements.
+type callbackSubscriber struct {
+	callback interface{}
+}
+
+func (cs *callbackSubscriber) OnEvent(ev *Event) {
+	switch ev.Type {
+	case EventRegStarted:
+		if cb, ok := cs.callback.(CallbackOnRegStarted); ok && ev.Account != nil {
+			cb.OnRegStarted(ev.Account, ev.AccId, ev.Renew)
+		}
+	case EventRegState:
+		if cb, ok := cs.callback.(CallbackOnRegState2); ok && ev.Account != nil {
+			cb.OnRegState2(ev.Account, ev.AccId, ev.RegInfo)
+		}
+	case EventCallState:
+		if cb, ok := cs.callback.(CallbackOnCallState); ok {
+			cb.OnCallState(ev.Account, ev.CallId, ev)
+		}
+	case EventCallMediaState:
+		if cb, ok := cs.callback.(CallbackOnCallMediaState); ok {
+			cb.OnCallMediaState(ev.Account, ev.CallId, ev)
+		}
+	case EventPager:
+		if cb, ok := cs.callback.(CallbackOnPager); ok {
+			cb.OnPager(ev.Account, ev.From, ev.To, ev.MimeType, ev.Body)
+		}
+	}
+}
+
+// accountOf resolves the account handle copied into the event, pjsua is
+// not asked: the account may be deleted by now.
+func accountOf(ev *C.ps_event) *Account {
+	if ev.acc_user_data == nil {
+		return nil
+	}
+
+	acc := accountOfHandle(uintptr(ev.acc_user_data))
+	if acc == nil || acc.gc == nil {
+		return nil
+	}
+
+	return acc
+}
+
+// newEvent copies a pjsua event of the ring, the message body is freed.
+func newEvent(ev *C.ps_event) *Event {
+	e := &Event{
+		Account: accountOf(ev),
+		AccId:   AccountId(ev.acc_id),
+		CallId:  int(ev.call_id),
+	}
+
+	switch ev._type {
+	case C.PS_EVENT_REG_STARTED:
+		e.Type = EventRegStarted
+		e.Renew = ev.renew != C.PJ_FALSE
+	case C.PS_EVENT_REG_STATE:
+		e.Type = EventRegState
+		e.Renew = ev.renew != C.PJ_FALSE
+		e.RegInfo = newRegInfo(ev)
+	case C.PS_EVENT_CALL_STATE, C.PS_EVENT_CALL_MEDIA_STATE:
+		e.Type = EventCallState
+		if ev._type == C.PS_EVENT_CALL_MEDIA_STATE {
+			e.Type = EventCallMediaState
 		}
+		e.CallState = int(ev.call_state)
+		e.MediaStatus = int(ev.media_status)
+		e.LastStatus = StatusCode(ev.code)
+		e.LastStatusText = C.GoString(&ev.reason[0])
+	case C.PS_EVENT_PAGER:
+		e.Type = EventPager
+		e.From = C.GoString(&ev.from[0])
+		e.To = C.GoString(&ev.to[0])
+		e.MimeType = C.GoString(&ev.mime_type[0])
+		if ev.buf != nil {
+			e.Body = C.GoBytes(unsafe.Pointer(ev.buf), C.int(ev.size))
+			C.free(unsafe.Pointer(ev.buf))
+			ev.buf = nil
+		}
+	default:
+		return nil
+	}
+
+	return e
+}
+
+// dispatchEvent delivers an event drained from the event ring.
+func dispatchEvent(ev *C.ps_event) {
+	if ev._type == C.PS_EVENT_FRAME {
+		onFrameEvent(ev)
+		return
+	}
+
+	if ev._type == C.PS_EVENT_ACC_RELEASED {
+		forgetAccountHandle(uintptr(ev.acc_user_data))
+		return
+	}
+
+	if e := newEvent(ev); e != nil {
+		bus.publish(e)
 	}
 }
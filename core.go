@@ -1,8 +1,10 @@
 package gua
 
 /*
+#include <stdlib.h>
 #include "include/pjsua.h"
 #include "include/ps_codecs.h"
+#include "include/ps_event_ring.h"
 #include "include/pjsua_internal.h"
 
 
@@ -12,48 +14,101 @@ pjsip_transport_type_e to_pjsip_transport_type_e(int type) {
 	return type;
 }
 
-void libRegisterThread(char *name)
-{
-    pj_thread_t *thread;
-    pj_thread_desc *desc;
-	pj_status_t status;
+static ps_event_ring *event_ring;
+
+void set_event_ring(ps_event_ring *ring) {
+	event_ring = ring;
+}
+
+// pjsua events outlast a full ring in order, they are never delivered on
+// the sip thread. Only events without a ring, before Init or after
+// Destroy, are dropped.
+static void post_event(ps_event *ev) {
+	pj_status_t status = PJ_EINVALIDOP;
 
-	if (!name) {
-		name = "gua";
+	if (event_ring != NULL) {
+		status = ps_event_ring_post_kept(event_ring, ev);
 	}
+	if (status != PJ_SUCCESS) {
+		PJ_PERROR(4, (THIS_FILE, status, "Drop pjsua event %d", ev->type));
+		if (ev->type == PS_EVENT_PAGER) {
+			free(ev->buf);
+		}
+	}
+}
+
+static void on_reg_started(pjsua_acc_id acc_id, pj_bool_t renew) {
+	ps_event ev;
+	ps_event_fill_reg(&ev, PS_EVENT_REG_STARTED, acc_id, renew, NULL);
+	post_event(&ev);
+}
+
+static void on_reg_state2(pjsua_acc_id acc_id, pjsua_reg_info *info) {
+	ps_event ev;
+	ps_event_fill_reg(&ev, PS_EVENT_REG_STATE, acc_id, PJ_FALSE, info);
+	post_event(&ev);
+}
 
-    desc = (pj_thread_desc*)malloc(sizeof(pj_thread_desc));
-    if (!desc) {
-		PJ_LOG(1,(THIS_FILE, "pj_thread_register no mem"));
-    }
+static void on_call_state(pjsua_call_id call_id, pjsip_event *e) {
+	ps_event ev;
+	PJ_UNUSED_ARG(e);
+	ps_event_fill_call(&ev, PS_EVENT_CALL_STATE, call_id);
+	post_event(&ev);
+}
 
-    pj_bzero(desc, sizeof(pj_thread_desc));
+static void on_call_media_state(pjsua_call_id call_id) {
+	ps_event ev;
+	ps_event_fill_call(&ev, PS_EVENT_CALL_MEDIA_STATE, call_id);
+	post_event(&ev);
+}
 
-    status = pj_thread_register(name, *desc, &thread);
-    if (status == PJ_SUCCESS) {
-    	// pj_mutex_lock(threadDescMutex);
-		// threadDescMap[thread] = desc;
-		// pj_mutex_unlock(threadDescMutex);
-		free(desc);
-    } else {
-		free(desc);
-		PJ_LOG(1,(THIS_FILE, "pj_thread_register error : %d\n", status));
-    }
+static void on_pager2(pjsua_call_id call_id, const pj_str_t *from,
+		      const pj_str_t *to, const pj_str_t *contact,
+		      const pj_str_t *mime_type, const pj_str_t *body,
+		      pjsip_rx_data *rdata, pjsua_acc_id acc_id) {
+	ps_event ev;
+	PJ_UNUSED_ARG(contact);
+	PJ_UNUSED_ARG(rdata);
+	if (ps_event_fill_pager(&ev, call_id, acc_id, from, to, mime_type, body) != PJ_SUCCESS) {
+		PJ_LOG(2, (THIS_FILE, "No memory for message body from %.*s", (int)from->slen, from->ptr));
+	}
+	post_event(&ev);
 }
 
-extern void callback_on_reg_started(pjsua_acc_id acc_id, pj_bool_t renew);
-void set_on_reg_started(pjsua_config *c) {
-	c->cb.on_reg_started = callback_on_reg_started;
+// every pjsua event goes to the event bus
+void set_pjsua_callbacks(pjsua_config *c) {
+	c->cb.on_reg_started = on_reg_started;
+	c->cb.on_reg_state2 = on_reg_state2;
+	c->cb.on_call_state = on_call_state;
+	c->cb.on_call_media_state = on_call_media_state;
+	c->cb.on_pager2 = on_pager2;
 }
 
-extern void callback_on_reg_state2(pjsua_acc_id acc_id, pjsua_reg_info *info);
-void set_on_reg_state2(pjsua_config *c) {
-	c->cb.on_reg_state2 = callback_on_reg_state2;
+static void on_decode(ps_codec *ps) {
+	pj_status_t status;
+
+	if (event_ring == NULL) {
+		return;
+	}
+
+	status = ps_event_post_frame(event_ring, ps);
+	if (status != PJ_SUCCESS) {
+		PJ_PERROR(4, (THIS_FILE, status, "Drop i frame of %s", ps->callee_id));
+	}
 }
 
-extern void on_decode_cb(ps_codec *psCodec);
 void set_on_decode_cb(pjmedia_ps_codec_callback *cb) {
-	cb->on_decode_cb = on_decode_cb;
+	cb->on_decode_cb = on_decode;
+}
+
+extern void on_snapshot_cb(ps_codec *psCodec, pj_uint8_t *jpeg, unsigned len);
+void set_on_snapshot_cb(pjmedia_ps_codec_callback *cb) {
+	cb->on_snapshot_cb = (void (*)(ps_codec*, const pj_uint8_t*, unsigned))on_snapshot_cb;
+}
+
+extern void on_motion_cb(ps_codec *psCodec, float *grid, unsigned grid_w, unsigned grid_h, float activity);
+void set_on_motion_cb(pjmedia_ps_codec_callback *cb) {
+	cb->on_motion_cb = (void (*)(ps_codec*, const float*, unsigned, unsigned, float))on_motion_cb;
 }
 */
 import "C"
@@ -61,7 +116,6 @@ import "C"
 import (
 	"errors"
 	"fmt"
-	"sync"
 	"unsafe"
 )
 
@@ -71,10 +125,6 @@ const (
 	PJSIP_TRANSPORT_TLS = C.PJSIP_TRANSPORT_TLS
 )
 
-var (
-	threadMutex sync.Mutex
-)
-
 /****************************config*******************************/
 type config struct {
 	c *C.struct_pjsua_config
@@ -186,45 +236,61 @@ func (epc *endPointConfig) Free() {
 type GuaContext struct {
 	tid      C.pjsua_transport_id
 	callback interface{}
+	events   *eventRing
+	exec     *executor
+	workers  int
+
+	// delivers the bus events to the callback interfaces
+	callbackSub *Subscription
 }
 
 type codecInfo C.struct_pjsua_codec_info
 
 func NewGuaContext(callback interface{}) *GuaContext {
-	return &GuaContext{callback: callback}
+	return NewGuaContextWithWorkers(callback, defaultExecutorWorkers)
+}
+
+// NewGuaContextWithWorkers creates a context whose pjsua operations run on
+// workers registered pj threads.
+func NewGuaContextWithWorkers(callback interface{}, workers int) *GuaContext {
+	return &GuaContext{callback: callback, exec: newExecutor(workers), workers: workers}
 }
 
+// Create creates pjsua, it may be called again after Destroy.
 func (gc *GuaContext) Create() error {
-	gc.checkThread()
-	if ret := C.pjsua_create(); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Create sua error: %d", ret))
+	// Destroy stopped the workers
+	if gc.exec.stopped() {
+		gc.exec = newExecutor(gc.workers)
 	}
 
-	return nil
+	return gc.exec.run(func() error {
+		if ret := C.pjsua_create(); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Create sua error: %d", ret))
+		}
+
+		return nil
+	})
 }
 
 func (gc *GuaContext) SetNullSndDev() error {
-	gc.checkThread()
-	if ret := C.pjsua_set_null_snd_dev(); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("SetNullSndDev error: %d", ret))
-	}
+	return gc.exec.run(func() error {
+		if ret := C.pjsua_set_null_snd_dev(); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("SetNullSndDev error: %d", ret))
+		}
 
-	return nil
+		return nil
+	})
 }
 
 func (gc *GuaContext) initCallback(c *config) {
-	if gc.callback == nil {
-		return
-	}
-
-	cb := gc.callback
-
-	if _, ok := cb.(CallbackOnRegStarted); ok {
-		C.set_on_reg_started(c.c)
-	}
-
-	if _, ok := cb.(CallbackOnRegState2); ok {
-		C.set_on_reg_state2(c.c)
+	C.set_pjsua_callbacks(c.c)
+
+	// the context callback never loses an event: a full queue holds the
+	// event reader, and so the other subscribers and the frames, until
+	// the callback catches up. It must not wait for another subscriber.
+	if gc.callback != nil && gc.callbackSub == nil {
+		sc := NewSubscriberConfig().SetQueueSize(defaultEventRingSize).SetOverflow(OverflowBlock)
+		gc.callbackSub = SubscribeEvents(&callbackSubscriber{callback: gc.callback}, sc)
 	}
 }
 
@@ -233,24 +299,38 @@ func (gc *GuaContext) Init(epc *endPointConfig) error {
 		epc = NewEndPointConfig()
 	}
 
-	gc.checkThread()
+	er, err := newEventRing(defaultEventRingSize)
+	if err != nil {
+		return err
+	}
+	gc.events = er
+	C.set_event_ring(er.ring)
+
+	eventsMutex.Lock()
+	events = er
+	eventsMutex.Unlock()
+
 	gc.initCallback(epc.Config())
 
-	if ret := C.pjsua_init(epc.Config().c, epc.LogConfig().lc, epc.MediaConfig().mc); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Init sua error: %d", ret))
-	}
+	return gc.exec.run(func() error {
+		if ret := C.pjsua_init(epc.Config().c, epc.LogConfig().lc, epc.MediaConfig().mc); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Init sua error: %d", ret))
+		}
 
-	if ret := C.pjmedia_codec_ps_vid_init(nil, &C.pjsua_var.cp.factory); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Error initializing ffmpeg library: %d", ret))
-	}
+		if ret := C.pjmedia_codec_ps_vid_init(nil, &C.pjsua_var.cp.factory); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Error initializing ffmpeg library: %d", ret))
+		}
 
-	psCodecCb := (*C.pjmedia_ps_codec_callback)(C.malloc(C.sizeof_struct_pjmedia_ps_codec_callback))
-	C.set_on_decode_cb(psCodecCb)
-	if ret := C.pjmedia_codec_ps_vid_init_cb(psCodecCb); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Error initializing ps codec callback: %d", ret))
-	}
+		psCodecCb := (*C.pjmedia_ps_codec_callback)(C.calloc(1, C.sizeof_struct_pjmedia_ps_codec_callback))
+		C.set_on_decode_cb(psCodecCb)
+		C.set_on_snapshot_cb(psCodecCb)
+		C.set_on_motion_cb(psCodecCb)
+		if ret := C.pjmedia_codec_ps_vid_init_cb(psCodecCb); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Error initializing ps codec callback: %d", ret))
+		}
 
-	return nil
+		return nil
+	})
 }
 
 func (gc *GuaContext) LogSetLevel(level int) {
@@ -266,55 +346,78 @@ func (gc *GuaContext) TransportCreate(typ int, cfg *transportConfig) error {
 		cfg = NewTransportConfig()
 	}
 
-	gc.checkThread()
-	if ret := C.pjsua_transport_create(C.to_pjsip_transport_type_e(C.int(typ)), &cfg.tcfg, &gc.tid); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Init sua error: %d", ret))
-	}
+	return gc.exec.run(func() error {
+		if ret := C.pjsua_transport_create(C.to_pjsip_transport_type_e(C.int(typ)), &cfg.tcfg, &gc.tid); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Init sua error: %d", ret))
+		}
 
-	return nil
+		return nil
+	})
 }
 
 func (gc *GuaContext) Start() error {
-	gc.checkThread()
-	if ret := C.pjsua_start(); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Start sua error: %d", ret))
-	}
+	return gc.exec.run(func() error {
+		if ret := C.pjsua_start(); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Start sua error: %d", ret))
+		}
 
-	return nil
+		return nil
+	})
 }
 
+// Destroy destroys pjsua and stops the workers, Create starts them again.
 func (gc *GuaContext) Destroy() error {
-	gc.checkThread()
+	err := gc.exec.run(func() error {
+		if ret := C.pjsua_destroy(); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Destroy sua error: %d", ret))
+		}
 
-	if ret := C.pjsua_destroy(); ret != C.PJ_SUCCESS {
-		return errors.New(fmt.Sprintf("Destroy sua error: %d", ret))
+		return nil
+	})
+	if err != nil {
+		return err
 	}
 
-	return nil
-}
+	// unregistrations posted during destroy are still delivered
+	if gc.events != nil {
+		eventsMutex.Lock()
+		events = nil
+		eventsMutex.Unlock()
 
-func (gc *GuaContext) checkThread() {
-	threadMutex.Lock()
-	defer threadMutex.Unlock()
+		C.set_event_ring(nil)
+		gc.events.stop()
+		gc.events = nil
+	}
+	forgetAccountHandles(gc)
 
-	if C.pj_thread_is_registered() == 0 {
-		C.libRegisterThread(nil)
+	if gc.callbackSub != nil {
+		gc.callbackSub.Unsubscribe()
+		gc.callbackSub = nil
 	}
+
+	gc.exec.stop()
+
+	return nil
 }
 
 func (gc *GuaContext) CodecInfoIterator() <-chan codecInfo {
 	iterator := make(chan codecInfo, 30)
 
 	go func() {
-		gc.checkThread()
-
 		defer close(iterator)
 
 		count := 128
 		pj_codec := make([]codecInfo, count)
 
-		if ret := C.pjsua_enum_codecs((*C.struct_pjsua_codec_info)(&pj_codec[0]), (*C.uint)(unsafe.Pointer(&count))); ret != C.PJ_SUCCESS {
-			fmt.Printf("enum codecs error: %d", ret)
+		err := gc.exec.run(func() error {
+			if ret := C.pjsua_enum_codecs((*C.struct_pjsua_codec_info)(&pj_codec[0]), (*C.uint)(unsafe.Pointer(&count))); ret != C.PJ_SUCCESS {
+				return errors.New(fmt.Sprintf("enum codecs error: %d", ret))
+			}
+
+			return nil
+		})
+		if err != nil {
+			fmt.Printf("%v", err)
 			return
 		}
 
@@ -0,0 +1,222 @@
+package gua
+
+import (
+	"log"
+	"runtime"
+	"strconv"
+	"sync"
+
+	"github.com/peace0phmind/gmf"
+)
+
+const (
+	// pixels one decode thread is expected to handle, 720p
+	pixelsPerDecodeThread = 1280 * 720
+	// from this size on frame threading is used for continuously fed decoders
+	frameThreadingPixels = 1920 * 1080
+)
+
+/****************************decode thread config*******************************/
+
+// decodeThreadConfig is the threading a decoder context is opened with.
+type decodeThreadConfig struct {
+	threads    int
+	threadType string
+}
+
+// pairs returns the codec options for the decoder context.
+func (dtc *decodeThreadConfig) pairs() []gmf.Pair {
+	return []gmf.Pair{
+		{Key: "threads", Val: strconv.Itoa(dtc.threads)},
+		{Key: "thread_type", Val: dtc.threadType},
+	}
+}
+
+// decodeThreadType picks the threading of a decoder by resolution. Frame
+// threading delays output by one frame per thread, so it only pays off for
+// big pictures fed continuously. Snapshot decoders get a single picture and
+// use slice threading.
+func decodeThreadType(width, height int, continuous bool) string {
+	if continuous && width*height >= frameThreadingPixels {
+		return "frame"
+	}
+
+	return "slice"
+}
+
+// decodeThreadWanted is how many threads a picture of the size can use.
+func decodeThreadWanted(width, height int) int {
+	wanted := (width*height + pixelsPerDecodeThread - 1) / pixelsPerDecodeThread
+	if wanted < 1 {
+		wanted = 1
+	}
+
+	return wanted
+}
+
+/****************************decode governor*******************************/
+
+// decodeGovernor caps the decode threads of all opened decoder contexts at
+// the budget, the core count by default. A decoder needs at least one free
+// thread, extra threads are handed out while the budget lasts. Background
+// streams may only take threads from their share of the budget, the rest is
+// kept for interactive streams.
+type decodeGovernor struct {
+	mutex sync.Mutex
+	freed *sync.Cond
+
+	budget          int
+	backgroundShare int
+	maxInteractive  int
+	maxBackground   int
+
+	inUse           int
+	backgroundInUse int
+}
+
+var governor = newDecodeGovernor(runtime.NumCPU())
+
+func newDecodeGovernor(budget int) *decodeGovernor {
+	dg := &decodeGovernor{}
+	dg.freed = sync.NewCond(&dg.mutex)
+	dg.setBudget(budget)
+
+	return dg
+}
+
+// setBudget is called with the mutex held.
+func (dg *decodeGovernor) setBudget(budget int) {
+	if budget < 1 {
+		budget = 1
+	}
+
+	dg.budget = budget
+	dg.backgroundShare = budget / 2
+	if dg.backgroundShare < 1 {
+		dg.backgroundShare = 1
+	}
+
+	// interactive decoders get more threads than background ones whenever
+	// the budget has more than one thread
+	dg.maxInteractive = budget / 2
+	if dg.maxInteractive < 2 {
+		dg.maxInteractive = 2
+	}
+	if dg.maxInteractive > budget {
+		dg.maxInteractive = budget
+	}
+	dg.maxBackground = dg.maxInteractive - 1
+	if dg.maxBackground > 2 {
+		dg.maxBackground = 2
+	}
+	if dg.maxBackground < 1 {
+		dg.maxBackground = 1
+	}
+}
+
+// SetDecodeThreadBudget changes the total number of decode threads, it
+// defaults to the number of cores.
+func SetDecodeThreadBudget(budget int) {
+	if budget < 1 {
+		return
+	}
+
+	governor.mutex.Lock()
+	defer governor.mutex.Unlock()
+
+	governor.setBudget(budget)
+	governor.freed.Broadcast()
+
+	log.Printf("decode thread budget: %d, background share: %d\n", budget, governor.backgroundShare)
+}
+
+// grant takes the threads of a decoder leaving reserve threads free, 0 when
+// not a single thread is left. Called with the mutex held.
+func (dg *decodeGovernor) grant(class DecodeClass, width, height, reserve int) int {
+	wanted := decodeThreadWanted(width, height)
+
+	limit, free := dg.maxInteractive, dg.budget-dg.inUse-reserve
+	if class == DecodeClassBackground {
+		limit = dg.maxBackground
+		if share := dg.backgroundShare - dg.backgroundInUse; share < free {
+			free = share
+		}
+	}
+
+	if wanted > limit {
+		wanted = limit
+	}
+	if wanted > free {
+		wanted = free
+	}
+	if wanted < 1 {
+		return 0
+	}
+
+	dg.inUse += wanted
+	if class == DecodeClassBackground {
+		dg.backgroundInUse += wanted
+	}
+
+	return wanted
+}
+
+// acquire returns the thread config for a decoder, it waits while the
+// budget is exhausted. The threads must be given back with release when
+// the context is closed.
+func (dg *decodeGovernor) acquire(class DecodeClass, width, height int, continuous bool) *decodeThreadConfig {
+	dg.mutex.Lock()
+	defer dg.mutex.Unlock()
+
+	threads := dg.grant(class, width, height, 0)
+	for threads == 0 {
+		dg.freed.Wait()
+		threads = dg.grant(class, width, height, 0)
+	}
+
+	return &decodeThreadConfig{threads: threads, threadType: decodeThreadType(width, height, continuous)}
+}
+
+// tryAcquire is acquire failing instead of waiting, for decoders held
+// open for long. One thread of a bigger budget is left for snapshot
+// decodes, which would otherwise wait until a live stream stops.
+func (dg *decodeGovernor) tryAcquire(class DecodeClass, width, height int, continuous bool) (*decodeThreadConfig, bool) {
+	dg.mutex.Lock()
+	defer dg.mutex.Unlock()
+
+	reserve := 0
+	if dg.budget > 1 {
+		reserve = 1
+	}
+
+	threads := dg.grant(class, width, height, reserve)
+	if threads == 0 {
+		return nil, false
+	}
+
+	return &decodeThreadConfig{threads: threads, threadType: decodeThreadType(width, height, continuous)}, true
+}
+
+func (dg *decodeGovernor) release(class DecodeClass, dtc *decodeThreadConfig) {
+	dg.mutex.Lock()
+	defer dg.mutex.Unlock()
+
+	dg.inUse -= dtc.threads
+	if class == DecodeClassBackground {
+		dg.backgroundInUse -= dtc.threads
+	}
+	dg.freed.Broadcast()
+}
+
+type DecodeThreadStats struct {
+	Budget          int
+	InUse           int
+	BackgroundInUse int
+}
+
+func GetDecodeThreadStats() DecodeThreadStats {
+	governor.mutex.Lock()
+	defer governor.mutex.Unlock()
+
+	return DecodeThreadStats{Budget: governor.budget, InUse: governor.inUse, BackgroundInUse: governor.backgroundInUse}
+}
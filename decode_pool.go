@@ -0,0 +1,458 @@
+package gua
+
+/*
+#include <stdlib.h>
+#include "include/ps_event_ring.h"
+
+*/
+import "C"
+import (
+	"hash/fnv"
+	"log"
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+)
+
+const (
+	defaultDecodeQueueSize   = 64
+	defaultStarvationTimeout = 2 * time.Second
+)
+
+/****************************decode job*******************************/
+var jobPool = sync.Pool{New: func() interface{} { return new(decodeJob) }}
+
+type decodeJob struct {
+	calleeId string
+	codecId  int
+	class    DecodeClass
+	enqueued time.Time
+	buf      *C.pj_uint8_t
+	size     int
+}
+
+// newDecodeJob takes over the frame copy of the event.
+func newDecodeJob(ev *C.ps_event, calleeId string) *decodeJob {
+	job := jobPool.Get().(*decodeJob)
+	*job = decodeJob{
+		calleeId: calleeId,
+		codecId:  int(ev.codec_id),
+		buf:      ev.buf,
+		size:     int(ev.size),
+	}
+	ev.buf = nil
+
+	return job
+}
+
+// free releases the frame copy and recycles the job, it must not be used
+// afterwards and must not be queued. Only the first call does anything.
+func (dj *decodeJob) free() {
+	if dj.buf != nil {
+		C.free(unsafe.Pointer(dj.buf))
+		dj.recycle()
+	}
+}
+
+// recycle returns a job which no longer owns a frame copy to the pool.
+func (dj *decodeJob) recycle() {
+	*dj = decodeJob{}
+	jobPool.Put(dj)
+}
+
+/****************************worker deque*******************************/
+
+// workerDeque holds the queued jobs of one worker, one deque per priority.
+// A camera holds at most one queued frame: a newer frame takes over the
+// queue slot of the older one, which is dropped. When the deque is full the
+// oldest frame of the lowest priority is dropped, unless that priority is
+// above the one of the new frame, then the new frame is dropped. The owner
+// pops from the head, thieves steal from the tail.
+type workerDeque struct {
+	mutex    sync.Mutex
+	jobs     [decodeClassCount][]*decodeJob
+	pending  map[string]*decodeJob
+	capacity int
+	count    int
+}
+
+func newWorkerDeque(capacity int) *workerDeque {
+	return &workerDeque{pending: make(map[string]*decodeJob), capacity: capacity}
+}
+
+// push returns true if the job took a new queue slot.
+func (wd *workerDeque) push(job *decodeJob, dropped *uint64) bool {
+	wd.mutex.Lock()
+	defer wd.mutex.Unlock()
+
+	if old, ok := wd.pending[job.calleeId]; ok {
+		// the queued job keeps its slot, only its frame is replaced
+		C.free(unsafe.Pointer(old.buf))
+		old.codecId, old.buf, old.size = job.codecId, job.buf, job.size
+		job.buf = nil
+		job.recycle()
+		atomic.AddUint64(dropped, 1)
+		return false
+	}
+
+	p := job.class.priority()
+
+	added := true
+	if wd.count >= wd.capacity {
+		// never evict a frame of a higher priority than the new one
+		evict := -1
+		for e := decodeClassCount - 1; e >= p; e-- {
+			if len(wd.jobs[e]) > 0 {
+				evict = e
+				break
+			}
+		}
+
+		atomic.AddUint64(dropped, 1)
+		if evict < 0 {
+			job.free()
+			return false
+		}
+		wd.removeHead(evict).free()
+		added = false
+	}
+
+	wd.jobs[p] = append(wd.jobs[p], job)
+	wd.pending[job.calleeId] = job
+	wd.count++
+
+	return added
+}
+
+func (wd *workerDeque) removeHead(p int) *decodeJob {
+	job := wd.jobs[p][0]
+	wd.jobs[p][0] = nil
+	wd.jobs[p] = wd.jobs[p][1:]
+	delete(wd.pending, job.calleeId)
+	wd.count--
+	return job
+}
+
+func (wd *workerDeque) removeTail(p int) *decodeJob {
+	last := len(wd.jobs[p]) - 1
+	job := wd.jobs[p][last]
+	wd.jobs[p][last] = nil
+	wd.jobs[p] = wd.jobs[p][:last]
+	delete(wd.pending, job.calleeId)
+	wd.count--
+	return job
+}
+
+// pop takes the highest priority job, unless a lower priority job has
+// waited longer than starvation, then that one goes first.
+func (wd *workerDeque) pop(now time.Time, starvation time.Duration) *decodeJob {
+	wd.mutex.Lock()
+	defer wd.mutex.Unlock()
+
+	for p := decodeClassCount - 1; p > 0; p-- {
+		if len(wd.jobs[p]) > 0 && now.Sub(wd.jobs[p][0].enqueued) > starvation {
+			return wd.removeHead(p)
+		}
+	}
+
+	for p := 0; p < decodeClassCount; p++ {
+		if len(wd.jobs[p]) > 0 {
+			return wd.removeHead(p)
+		}
+	}
+
+	return nil
+}
+
+// steal takes the newest job of the highest priority, leaving older ones to
+// the owner whose decoder state is warm for them.
+func (wd *workerDeque) steal() *decodeJob {
+	wd.mutex.Lock()
+	defer wd.mutex.Unlock()
+
+	for p := 0; p < decodeClassCount; p++ {
+		if len(wd.jobs[p]) > 0 {
+			return wd.removeTail(p)
+		}
+	}
+
+	return nil
+}
+
+func (wd *workerDeque) depths() [decodeClassCount]int {
+	wd.mutex.Lock()
+	defer wd.mutex.Unlock()
+
+	var depths [decodeClassCount]int
+	for p := 0; p < decodeClassCount; p++ {
+		depths[p] = len(wd.jobs[p])
+	}
+	return depths
+}
+
+func (wd *workerDeque) clear() {
+	wd.mutex.Lock()
+	defer wd.mutex.Unlock()
+
+	for p := 0; p < decodeClassCount; p++ {
+		for _, job := range wd.jobs[p] {
+			job.free()
+		}
+		wd.jobs[p] = nil
+	}
+	wd.pending = make(map[string]*decodeJob)
+	wd.count = 0
+}
+
+/****************************decode pool config*******************************/
+type decodePoolConfig struct {
+	workers           int
+	queueSize         int
+	starvationTimeout time.Duration
+}
+
+func NewDecodePoolConfig() *decodePoolConfig {
+	return &decodePoolConfig{
+		workers:           runtime.NumCPU(),
+		queueSize:         defaultDecodeQueueSize,
+		starvationTimeout: defaultStarvationTimeout,
+	}
+}
+
+func (dpc *decodePoolConfig) SetWorkers(workers int) {
+	if workers > 0 {
+		dpc.workers = workers
+	}
+}
+
+// SetQueueSize sets the number of frames queued over all workers.
+func (dpc *decodePoolConfig) SetQueueSize(queueSize int) {
+	if queueSize > 0 {
+		dpc.queueSize = queueSize
+	}
+}
+
+// SetStarvationTimeout sets how long a lower priority frame may wait before
+// it is served ahead of higher priority frames.
+func (dpc *decodePoolConfig) SetStarvationTimeout(timeout time.Duration) {
+	if timeout > 0 {
+		dpc.starvationTimeout = timeout
+	}
+}
+
+/****************************decode pool*******************************/
+
+// decodePool is a work-stealing scheduler between the ps codec output and
+// the decoders. Frames of a stream are queued to the worker the stream is
+// affine to, idle workers steal from the others.
+type decodePool struct {
+	deques     []*workerDeque
+	starvation time.Duration
+
+	// queued counts jobs in the deques, it changes under idleMutex in the
+	// same step as the deques. Deque mutexes are taken under idleMutex,
+	// never the other way around.
+	idleMutex sync.Mutex
+	idle      *sync.Cond
+	queued    int64
+	closed    bool
+
+	dropped uint64
+	decoded uint64
+	stolen  uint64
+
+	wg sync.WaitGroup
+}
+
+type DecodePoolStats struct {
+	Queued  int
+	Dropped uint64
+	Decoded uint64
+	Stolen  uint64
+	// queue depth per worker, indexed by DecodeClass
+	Depths [][decodeClassCount]int
+}
+
+var (
+	poolMutex sync.Mutex
+	pool      *decodePool
+)
+
+func newDecodePool(dpc *decodePoolConfig) *decodePool {
+	capacity := (dpc.queueSize + dpc.workers - 1) / dpc.workers
+
+	dp := &decodePool{deques: make([]*workerDeque, dpc.workers), starvation: dpc.starvationTimeout}
+	dp.idle = sync.NewCond(&dp.idleMutex)
+
+	for i := range dp.deques {
+		dp.deques[i] = newWorkerDeque(capacity)
+	}
+
+	for i := range dp.deques {
+		dp.wg.Add(1)
+		go dp.work(i)
+	}
+
+	log.Printf("decode pool started, workers: %d, queue size: %d\n", dpc.workers, dpc.queueSize)
+	return dp
+}
+
+func (dp *decodePool) affinity(calleeId string) int {
+	h := fnv.New32a()
+	h.Write([]byte(calleeId))
+	return int(h.Sum32() % uint32(len(dp.deques)))
+}
+
+func (dp *decodePool) push(job *decodeJob) {
+	job.class = getStream(job.calleeId).decodeClass()
+	job.enqueued = time.Now()
+
+	// held across the enqueue, stop clears the deques once closed is set,
+	// a job queued after that would never be freed
+	dp.idleMutex.Lock()
+	defer dp.idleMutex.Unlock()
+
+	if dp.closed {
+		job.free()
+		return
+	}
+
+	if !dp.deques[dp.affinity(job.calleeId)].push(job, &dp.dropped) {
+		return
+	}
+
+	dp.queued++
+	dp.idle.Signal()
+}
+
+func (dp *decodePool) take(self int) *decodeJob {
+	if job := dp.deques[self].pop(time.Now(), dp.starvation); job != nil {
+		return job
+	}
+
+	for i := 1; i < len(dp.deques); i++ {
+		if job := dp.deques[(self+i)%len(dp.deques)].steal(); job != nil {
+			atomic.AddUint64(&dp.stolen, 1)
+			return job
+		}
+	}
+
+	return nil
+}
+
+func (dp *decodePool) work(self int) {
+	defer dp.wg.Done()
+
+	for {
+		var job *decodeJob
+
+		// the job is claimed and uncounted in one step, a worker finding
+		// nothing waits instead of spinning
+		dp.idleMutex.Lock()
+		for !dp.closed {
+			if dp.queued > 0 {
+				if job = dp.take(self); job != nil {
+					dp.queued--
+					break
+				}
+			}
+			dp.idle.Wait()
+		}
+		if job == nil {
+			dp.idleMutex.Unlock()
+			return
+		}
+		dp.idleMutex.Unlock()
+
+		decodeFrame(job)
+		job.free()
+		atomic.AddUint64(&dp.decoded, 1)
+	}
+}
+
+func (dp *decodePool) stop() {
+	dp.idleMutex.Lock()
+	dp.closed = true
+	dp.idle.Broadcast()
+	dp.idleMutex.Unlock()
+
+	dp.wg.Wait()
+
+	for _, wd := range dp.deques {
+		wd.clear()
+	}
+}
+
+// InitDecodePool starts the decode workers, replacing a running pool.
+// Without it a pool with the default config is started on the first frame.
+func InitDecodePool(dpc *decodePoolConfig) {
+	if dpc == nil {
+		dpc = NewDecodePoolConfig()
+	}
+
+	poolMutex.Lock()
+	old := pool
+	pool = newDecodePool(dpc)
+	poolMutex.Unlock()
+
+	// stop outside the lock, so producers never wait for a running decode
+	if old != nil {
+		old.stop()
+	}
+}
+
+func StopDecodePool() {
+	poolMutex.Lock()
+	old := pool
+	pool = nil
+	poolMutex.Unlock()
+
+	if old != nil {
+		old.stop()
+	}
+}
+
+// GetDecodePoolStats returns the queue depths, a box is saturated when the
+// queues stay full and Dropped keeps growing.
+func GetDecodePoolStats() DecodePoolStats {
+	poolMutex.Lock()
+	dp := pool
+	poolMutex.Unlock()
+
+	if dp == nil {
+		return DecodePoolStats{}
+	}
+
+	stats := DecodePoolStats{
+		Dropped: atomic.LoadUint64(&dp.dropped),
+		Decoded: atomic.LoadUint64(&dp.decoded),
+		Stolen:  atomic.LoadUint64(&dp.stolen),
+		Depths:  make([][decodeClassCount]int, len(dp.deques)),
+	}
+
+	for i, wd := range dp.deques {
+		depths := wd.depths()
+		for p := 0; p < decodeClassCount; p++ {
+			stats.Queued += depths[p]
+		}
+		// report by class instead of internal priority
+		for _, class := range []DecodeClass{DecodeClassBackground, DecodeClassInteractive, DecodeClassAlarm} {
+			stats.Depths[i][class] = depths[class.priority()]
+		}
+	}
+
+	return stats
+}
+
+func submitDecodeJob(job *decodeJob) {
+	poolMutex.Lock()
+	if pool == nil {
+		pool = newDecodePool(NewDecodePoolConfig())
+	}
+	dp := pool
+	poolMutex.Unlock()
+
+	dp.push(job)
+}
@@ -0,0 +1,149 @@
+package gua
+
+/*
+#include <libavcodec/avcodec.h>
+
+static int codec_max_lowres(int codec_id) {
+	const AVCodec *c = avcodec_find_decoder(codec_id);
+	return c ? c->max_lowres : 0;
+}
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"sync"
+	"time"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// DecodeProfile trades decode quality for speed.
+type DecodeProfile int
+
+const (
+	// full quality decode
+	DecodeProfileFull DecodeProfile = iota
+	// key frames only, no loop filter and reduced resolution where the
+	// codec supports it. Good enough for wall-of-cameras thumbnails.
+	DecodeProfileThumbnail
+
+	decodeProfileCount = 2
+)
+
+func (dp DecodeProfile) String() string {
+	switch dp {
+	case DecodeProfileThumbnail:
+		return "thumbnail"
+	default:
+		return "full"
+	}
+}
+
+func (dp DecodeProfile) valid() bool {
+	return dp >= 0 && dp < decodeProfileCount
+}
+
+// pairs returns the codec options of the profile. skip_idct is left alone,
+// only key frames are decoded here and skipping their idct drops all of the
+// residual.
+func (dp DecodeProfile) pairs(codecId int) []gmf.Pair {
+	if dp != DecodeProfileThumbnail {
+		return nil
+	}
+
+	pairs := []gmf.Pair{
+		{Key: "skip_loop_filter", Val: "all"},
+		{Key: "skip_frame", Val: "nokey"},
+		{Key: "flags2", Val: "+fast"},
+	}
+
+	if C.codec_max_lowres(C.int(codecId)) > 0 {
+		pairs = append(pairs, gmf.Pair{Key: "lowres", Val: "1"})
+	}
+
+	return pairs
+}
+
+// SetStreamDecodeProfile sets the profile every frame of a callee is
+// decoded with.
+func SetStreamDecodeProfile(calleeId string, profile DecodeProfile) error {
+	if !profile.valid() {
+		return errors.New(fmt.Sprintf("unknown decode profile: %d", profile))
+	}
+
+	ss := getStream(calleeId)
+
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.profile = profile
+
+	return nil
+}
+
+// RequestDecodeProfile decodes only the next frame of a callee with the
+// profile, the stream profile is used again after it.
+func RequestDecodeProfile(calleeId string, profile DecodeProfile) error {
+	if !profile.valid() {
+		return errors.New(fmt.Sprintf("unknown decode profile: %d", profile))
+	}
+
+	ss := getStream(calleeId)
+
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.nextProfile = &profile
+
+	return nil
+}
+
+/****************************decode profile stats*******************************/
+
+// decode cost is measured per KB of bitstream, so streams of different
+// resolution and bitrate can be compared.
+type decodeProfileStats struct {
+	mutex    sync.Mutex
+	frames   [decodeProfileCount]uint64
+	bytes    [decodeProfileCount]uint64
+	duration [decodeProfileCount]time.Duration
+}
+
+var profileStats decodeProfileStats
+
+func (dps *decodeProfileStats) add(profile DecodeProfile, size int, duration time.Duration) {
+	dps.mutex.Lock()
+	defer dps.mutex.Unlock()
+
+	dps.frames[profile]++
+	dps.bytes[profile] += uint64(size)
+	dps.duration[profile] += duration
+}
+
+type DecodeProfileStats struct {
+	Frames [decodeProfileCount]uint64
+	// average decode time per KB of bitstream
+	CostPerKB [decodeProfileCount]time.Duration
+	// full profile cost divided by thumbnail profile cost, 0 until both
+	// profiles decoded a frame
+	ThumbnailSpeedup float64
+}
+
+func GetDecodeProfileStats() DecodeProfileStats {
+	profileStats.mutex.Lock()
+	defer profileStats.mutex.Unlock()
+
+	stats := DecodeProfileStats{Frames: profileStats.frames}
+	for p := 0; p < decodeProfileCount; p++ {
+		if kb := profileStats.bytes[p] / 1024; kb > 0 {
+			stats.CostPerKB[p] = profileStats.duration[p] / time.Duration(kb)
+		}
+	}
+
+	if full, thumbnail := stats.CostPerKB[DecodeProfileFull], stats.CostPerKB[DecodeProfileThumbnail]; full > 0 && thumbnail > 0 {
+		stats.ThumbnailSpeedup = float64(full) / float64(thumbnail)
+	}
+
+	return stats
+}
@@ -0,0 +1,93 @@
+package gua
+
+/*
+#include "include/ps_codecs.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"sync/atomic"
+)
+
+var duplicateFrames int64
+
+// EnableDuplicateSuppression lets the ps codec fingerprint the slice data
+// of every i frame. An i frame matching the previous one of its stream is
+// not decoded, the last snapshot of the stream is delivered again instead.
+// Streams with a FrameConsumer or batch collector attached, and streams
+// with regions for a RegionConsumer, still decode.
+// Call it after GuaContext.Init.
+func EnableDuplicateSuppression(enable bool) error {
+	var pjEnable C.pj_bool_t
+	if enable {
+		pjEnable = C.PJ_TRUE
+	}
+
+	if ret := C.pjmedia_codec_ps_vid_set_dedup(pjEnable); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("Enable duplicate suppression error: %d", ret))
+	}
+
+	return nil
+}
+
+// GetDuplicateFrames returns how many i frames were answered from the last
+// snapshot of their stream instead of being decoded.
+func GetDuplicateFrames() int64 {
+	return atomic.LoadInt64(&duplicateFrames)
+}
+
+func (ss *streamState) setLastJpeg(data []byte) {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.lastJpeg = data
+}
+
+func (ss *streamState) setLastVariants(variants []SnapshotVariant) {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.lastVariants = variants
+}
+
+// reemitSnapshot delivers the cached snapshot of the callee again, it
+// returns false when the frame has to be decoded after all.
+func reemitSnapshot(calleeId string) bool {
+	if consumer == nil || frameConsumer != nil {
+		return false
+	}
+
+	collectorMutex.RLock()
+	collecting := collector != nil
+	collectorMutex.RUnlock()
+	if collecting {
+		return false
+	}
+
+	ss := getStream(calleeId)
+	ss.mutex.Lock()
+	jpeg, variants := ss.lastJpeg, ss.lastVariants
+	outputs, regions := len(ss.outputs), len(ss.regions)
+	ss.mutex.Unlock()
+
+	// consumers must not modify delivered snapshots, they are shared
+	if vc, ok := consumer.(VariantConsumer); ok && outputs > 0 {
+		if variants == nil {
+			return false
+		}
+		vc.OnVariants(calleeId, variants)
+	} else if _, ok := consumer.(RegionConsumer); ok && regions > 0 {
+		// region jpegs are not kept, cut the regions from a decode
+		return false
+	} else {
+		if jpeg == nil {
+			return false
+		}
+		consumer.OnConsumer(calleeId, jpeg)
+	}
+
+	atomic.AddInt64(&duplicateFrames, 1)
+	return true
+}
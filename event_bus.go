@@ -0,0 +1,259 @@
+package gua
+
+import (
+	"sync"
+	"sync/atomic"
+)
+
+// EventType is the kind of pjsua event published on the event bus.
+type EventType int
+
+const (
+	EventRegStarted EventType = iota
+	EventRegState
+	EventCallState
+	EventCallMediaState
+	EventPager
+	eventTypeCount
+)
+
+// Event is a copy of a pjsua event, handlers may keep it.
+type Event struct {
+	Type EventType
+	// nil when the account is unknown or was not created by gua
+	Account *Account
+	AccId   AccountId
+	// -1 for account events and messages outside of a call
+	CallId int
+
+	// EventRegStarted
+	Renew bool
+	// EventRegState
+	RegInfo *RegInfo
+
+	// EventCallState and EventCallMediaState, pjsip_inv_state and
+	// pjsua_call_media_status values
+	CallState      int
+	MediaStatus    int
+	LastStatus     StatusCode
+	LastStatusText string
+
+	// EventPager
+	From     string
+	To       string
+	MimeType string
+	Body     []byte
+}
+
+// EventHandler receives the events of a subscription on its own goroutine,
+// one event at a time and in order.
+type EventHandler interface {
+	OnEvent(ev *Event)
+}
+
+// OverflowPolicy tells what a full subscriber queue does with a new event.
+type OverflowPolicy int
+
+const (
+	// drop the oldest queued event to make room
+	OverflowDropOldest OverflowPolicy = iota
+	// drop the new event
+	OverflowDropNewest
+	// wait for room, this stalls the event reader and so every other
+	// subscriber and the frame delivery
+	OverflowBlock
+)
+
+/****************************subscriber config*******************************/
+type subscriberConfig struct {
+	queueSize int
+	overflow  OverflowPolicy
+	types     []EventType
+}
+
+func NewSubscriberConfig() *subscriberConfig {
+	return &subscriberConfig{queueSize: 64, overflow: OverflowDropOldest}
+}
+
+func (sc *subscriberConfig) SetQueueSize(queueSize int) *subscriberConfig {
+	sc.queueSize = queueSize
+	return sc
+}
+
+func (sc *subscriberConfig) SetOverflow(overflow OverflowPolicy) *subscriberConfig {
+	sc.overflow = overflow
+	return sc
+}
+
+// SetEventTypes limits the subscription to types, none subscribes to all.
+func (sc *subscriberConfig) SetEventTypes(types ...EventType) *subscriberConfig {
+	sc.types = append([]EventType(nil), types...)
+	return sc
+}
+
+/****************************subscription*******************************/
+
+// Subscription is the queue and goroutine of one event handler.
+type Subscription struct {
+	handler  EventHandler
+	overflow OverflowPolicy
+	types    [eventTypeCount]bool
+	queue    chan *Event
+	done     chan struct{}
+	finished sync.WaitGroup
+	once     sync.Once
+	dropped  uint64
+}
+
+func (s *Subscription) deliver() {
+	defer s.finished.Done()
+
+	for {
+		select {
+		case ev := <-s.queue:
+			s.handler.OnEvent(ev)
+		case <-s.done:
+			// hand over what was queued before the unsubscribe
+			for {
+				select {
+				case ev := <-s.queue:
+					s.handler.OnEvent(ev)
+				default:
+					return
+				}
+			}
+		}
+	}
+}
+
+func (s *Subscription) push(ev *Event) {
+	if !s.types[ev.Type] {
+		return
+	}
+
+	switch s.overflow {
+	case OverflowBlock:
+		select {
+		case s.queue <- ev:
+		case <-s.done:
+		}
+		return
+	case OverflowDropNewest:
+		select {
+		case s.queue <- ev:
+		default:
+			atomic.AddUint64(&s.dropped, 1)
+		}
+		return
+	}
+
+	for {
+		select {
+		case s.queue <- ev:
+			return
+		default:
+		}
+
+		select {
+		case <-s.queue:
+			atomic.AddUint64(&s.dropped, 1)
+		default:
+		}
+	}
+}
+
+// Dropped returns how many events overflowed the queue.
+func (s *Subscription) Dropped() uint64 {
+	return atomic.LoadUint64(&s.dropped)
+}
+
+// Unsubscribe stops the subscription once the queued events are handled.
+// It must not be called from the handler.
+func (s *Subscription) Unsubscribe() {
+	s.once.Do(func() {
+		bus.remove(s)
+		close(s.done)
+		s.finished.Wait()
+	})
+}
+
+/****************************event bus*******************************/
+
+// eventBus fans the events drained from the event ring out to the
+// subscriptions. The list is copied on change, publish does not lock.
+type eventBus struct {
+	mutex sync.Mutex
+	subs  atomic.Value
+}
+
+var bus = newEventBus()
+
+func newEventBus() *eventBus {
+	eb := &eventBus{}
+	eb.subs.Store([]*Subscription(nil))
+	return eb
+}
+
+func (eb *eventBus) add(s *Subscription) {
+	eb.mutex.Lock()
+	defer eb.mutex.Unlock()
+
+	old := eb.subs.Load().([]*Subscription)
+	eb.subs.Store(append(append([]*Subscription(nil), old...), s))
+}
+
+func (eb *eventBus) remove(s *Subscription) {
+	eb.mutex.Lock()
+	defer eb.mutex.Unlock()
+
+	old := eb.subs.Load().([]*Subscription)
+	subs := make([]*Subscription, 0, len(old))
+	for _, o := range old {
+		if o != s {
+			subs = append(subs, o)
+		}
+	}
+	eb.subs.Store(subs)
+}
+
+func (eb *eventBus) publish(ev *Event) {
+	for _, s := range eb.subs.Load().([]*Subscription) {
+		s.push(ev)
+	}
+}
+
+// SubscribeEvents runs handler for the pjsua events on its own goroutine.
+// sc may be nil for the defaults: all events, a queue of 64 dropping the
+// oldest event when full.
+func SubscribeEvents(handler EventHandler, sc *subscriberConfig) *Subscription {
+	if sc == nil {
+		sc = NewSubscriberConfig()
+	}
+
+	queueSize := sc.queueSize
+	if queueSize < 1 {
+		queueSize = 1
+	}
+
+	s := &Subscription{
+		handler:  handler,
+		overflow: sc.overflow,
+		queue:    make(chan *Event, queueSize),
+		done:     make(chan struct{}),
+	}
+
+	for i := range s.types {
+		s.types[i] = len(sc.types) == 0
+	}
+	for _, t := range sc.types {
+		if t >= 0 && t < eventTypeCount {
+			s.types[t] = true
+		}
+	}
+
+	s.finished.Add(1)
+	go s.deliver()
+	bus.add(s)
+
+	return s
+}
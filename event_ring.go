@@ -0,0 +1,103 @@
+package gua
+
+/*
+#include <stdlib.h>
+#include "include/ps_event_ring.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"log"
+	"sync"
+	"unsafe"
+)
+
+const (
+	defaultEventRingSize = 1024
+	eventBatchSize       = 64
+)
+
+// eventRing moves the frames and registration events posted by the media
+// and sip threads into Go, one cgo call drains a whole batch.
+type eventRing struct {
+	ring  *C.ps_event_ring
+	batch *C.ps_event
+	wg    sync.WaitGroup
+}
+
+var (
+	eventsMutex sync.Mutex
+	events      *eventRing
+)
+
+func newEventRing(size int) (*eventRing, error) {
+	er := &eventRing{}
+
+	if ret := C.ps_event_ring_create(C.uint(size), &er.ring); ret != C.PJ_SUCCESS {
+		return nil, errors.New(fmt.Sprintf("Create event ring error: %d", ret))
+	}
+
+	er.batch = (*C.ps_event)(C.calloc(eventBatchSize, C.sizeof_ps_event))
+	if er.batch == nil {
+		C.ps_event_ring_destroy(er.ring)
+		return nil, errors.New("Create event ring error: no memory")
+	}
+
+	er.wg.Add(1)
+	go er.drain()
+
+	return er, nil
+}
+
+func (er *eventRing) drain() {
+	defer er.wg.Done()
+
+	// the reader never calls into pjsua, the events carry what it needs
+	batch := (*[1 << 20]C.ps_event)(unsafe.Pointer(er.batch))[:eventBatchSize:eventBatchSize]
+	for {
+		n := int(C.ps_event_ring_drain(er.ring, er.batch, eventBatchSize))
+		if n == 0 {
+			return
+		}
+
+		for i := 0; i < n; i++ {
+			dispatchEvent(&batch[i])
+		}
+	}
+}
+
+// stop delivers the events left in the ring and frees it.
+func (er *eventRing) stop() {
+	C.ps_event_ring_close(er.ring)
+	er.wg.Wait()
+
+	log.Printf("event ring stopped, dropped events: %d\n", uint64(C.ps_event_ring_dropped(er.ring)))
+
+	C.ps_event_ring_destroy(er.ring)
+	C.free(unsafe.Pointer(er.batch))
+}
+
+// postEvent posts an event of Go behind the pjsua events, it returns false
+// when there is no ring.
+func postEvent(ev *C.ps_event) bool {
+	eventsMutex.Lock()
+	defer eventsMutex.Unlock()
+
+	return events != nil && C.ps_event_ring_post_kept(events.ring, ev) == C.PJ_SUCCESS
+}
+
+// GetDroppedEvents returns how many frames did not fit in the event ring.
+// pjsua events wait beyond the ring in order, they are only lost when out
+// of memory.
+func GetDroppedEvents() uint64 {
+	eventsMutex.Lock()
+	defer eventsMutex.Unlock()
+
+	if events == nil {
+		return 0
+	}
+
+	return uint64(C.ps_event_ring_dropped(events.ring))
+}
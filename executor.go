@@ -0,0 +1,188 @@
+package gua
+
+/*
+#include <stdlib.h>
+#include "include/pjsua.h"
+
+static __thread int on_executor;
+
+// the descriptor is owned by the caller and must outlive the thread
+static pj_status_t register_thread(const char *name, pj_thread_desc *desc) {
+	pj_thread_t *thread;
+
+	if (pj_thread_is_registered()) {
+		return PJ_SUCCESS;
+	}
+
+	pj_bzero(desc, sizeof(pj_thread_desc));
+	return pj_thread_register(name, *desc, &thread);
+}
+
+static void set_on_executor(void) {
+	on_executor = 1;
+}
+
+static int is_on_executor(void) {
+	return on_executor;
+}
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"log"
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+const defaultExecutorWorkers = 4
+
+/****************************pj thread*******************************/
+
+// pjThread is the pjlib registration of a locked OS thread. The goroutine
+// must not unlock the thread: Go ends a thread whose goroutine exits
+// locked. The descriptor is never freed, pjlib points to it as long as the
+// thread lives and Go does not tell when the thread is gone. It is leaked
+// once per executor worker.
+type pjThread struct {
+	name       string
+	desc       *C.pj_thread_desc
+	registered bool
+}
+
+func lockPjThread(name string) *pjThread {
+	runtime.LockOSThread()
+
+	return &pjThread{
+		name: name,
+		desc: (*C.pj_thread_desc)(C.calloc(1, C.sizeof_pj_thread_desc)),
+	}
+}
+
+// register registers the thread once pjlib is up, pjsua_create registers
+// the thread it runs on itself.
+func (pt *pjThread) register() error {
+	if pt.registered || C.pjsua_get_state() == C.PJSUA_STATE_NULL {
+		return nil
+	}
+
+	name := C.CString(pt.name)
+	defer C.free(unsafe.Pointer(name))
+
+	if ret := C.register_thread(name, pt.desc); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("pj_thread_register error: %d", ret))
+	}
+	pt.registered = true
+
+	return nil
+}
+
+/****************************executor*******************************/
+
+type future struct {
+	done chan struct{}
+	err  error
+}
+
+// Wait blocks until the task ran and returns its error.
+func (f *future) Wait() error {
+	<-f.done
+	return f.err
+}
+
+type task struct {
+	fn func() error
+	f  *future
+}
+
+// executor runs pjsua operations on a few OS threads registered with
+// pjlib once, instead of registering whatever thread a goroutine is on.
+type executor struct {
+	mutex  sync.RWMutex
+	closed bool
+	tasks  chan task
+	wg     sync.WaitGroup
+}
+
+func newExecutor(workers int) *executor {
+	if workers < 1 {
+		workers = 1
+	}
+
+	e := &executor{tasks: make(chan task)}
+	for i := 0; i < workers; i++ {
+		e.wg.Add(1)
+		go e.work(i)
+	}
+
+	return e
+}
+
+func (e *executor) work(idx int) {
+	defer e.wg.Done()
+
+	pt := lockPjThread(fmt.Sprintf("gua%d", idx))
+	C.set_on_executor()
+
+	for t := range e.tasks {
+		if err := pt.register(); err != nil {
+			t.f.err = err
+		} else {
+			t.f.err = t.fn()
+		}
+		close(t.f.done)
+	}
+}
+
+// submit queues fn on a worker, the future returns its error.
+func (e *executor) submit(fn func() error) *future {
+	f := &future{done: make(chan struct{})}
+
+	// a task submitted from a worker must not wait for another worker
+	if C.is_on_executor() != 0 {
+		f.err = fn()
+		close(f.done)
+		return f
+	}
+
+	e.mutex.RLock()
+	defer e.mutex.RUnlock()
+
+	if e.closed {
+		f.err = errors.New("executor stopped")
+		close(f.done)
+		return f
+	}
+
+	e.tasks <- task{fn: fn, f: f}
+
+	return f
+}
+
+// run runs fn on a worker and waits for it.
+func (e *executor) run(fn func() error) error {
+	return e.submit(fn).Wait()
+}
+
+func (e *executor) stopped() bool {
+	e.mutex.RLock()
+	defer e.mutex.RUnlock()
+
+	return e.closed
+}
+
+// stop ends the workers and their threads, queued tasks run first.
+func (e *executor) stop() {
+	e.mutex.Lock()
+	if e.closed {
+		e.mutex.Unlock()
+		return
+	}
+	e.closed = true
+	close(e.tasks)
+	e.mutex.Unlock()
+
+	e.wg.Wait()
+	log.Println("executor stopped")
+}
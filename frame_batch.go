@@ -0,0 +1,269 @@
+package gua
+
+/*
+#include "include/ps_yuv.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"log"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// TensorType is the sample type of a batch.
+type TensorType int
+
+const (
+	TensorUint8 TensorType = iota
+	// float32 scaled to 0 - 1
+	TensorFloat32
+)
+
+func (tt TensorType) size() int {
+	if tt == TensorFloat32 {
+		return 4
+	}
+	return 1
+}
+
+// batch buffers are aligned for simd loads of the inference runtime
+const batchAlign = 64
+
+/****************************batch config*******************************/
+type batchConfig struct {
+	batchSize  int
+	width      int
+	height     int
+	tensorType TensorType
+	timeout    time.Duration
+}
+
+func NewBatchConfig() *batchConfig {
+	return &batchConfig{batchSize: 8, width: 640, height: 640, tensorType: TensorUint8, timeout: 100 * time.Millisecond}
+}
+
+func (bc *batchConfig) SetBatchSize(batchSize int) *batchConfig {
+	bc.batchSize = batchSize
+	return bc
+}
+
+// SetInputSize sets the size every frame is resized to, the aspect ratio
+// is not kept.
+func (bc *batchConfig) SetInputSize(width, height int) *batchConfig {
+	bc.width = width
+	bc.height = height
+	return bc
+}
+
+func (bc *batchConfig) SetTensorType(tensorType TensorType) *batchConfig {
+	bc.tensorType = tensorType
+	return bc
+}
+
+// SetTimeout sets how long a batch waits to fill up before it is emitted
+// with the frames it has.
+func (bc *batchConfig) SetTimeout(timeout time.Duration) *batchConfig {
+	bc.timeout = timeout
+	return bc
+}
+
+/****************************frame batch*******************************/
+
+// BatchSlot describes the frame in one slot of a batch.
+type BatchSlot struct {
+	CalleeId  string
+	Timestamp time.Time
+	// size of the decoded picture before resize
+	SrcWidth  int
+	SrcHeight int
+	// false when the frame could not be converted, the slot is garbage
+	Valid bool
+}
+
+// FrameBatch is Count frames in nchw layout: per slot the r, g and b planes
+// of Width x Height samples, slots one after another in Data.
+type FrameBatch struct {
+	Count  int
+	Width  int
+	Height int
+	Type   TensorType
+	Data   []byte
+	Slots  []BatchSlot
+
+	wg sync.WaitGroup
+}
+
+// Float32 returns Data as float32 samples, nil for uint8 batches.
+func (fb *FrameBatch) Float32() []float32 {
+	if fb.Type != TensorFloat32 || len(fb.Data) == 0 {
+		return nil
+	}
+	n := len(fb.Data) / 4
+	return (*[1 << 28]float32)(unsafe.Pointer(&fb.Data[0]))[:n:n]
+}
+
+func (fb *FrameBatch) slotSize() int {
+	return 3 * fb.Width * fb.Height * fb.Type.size()
+}
+
+func newFrameBatch(bc *batchConfig) *FrameBatch {
+	fb := &FrameBatch{Width: bc.width, Height: bc.height, Type: bc.tensorType, Slots: make([]BatchSlot, bc.batchSize)}
+
+	size := fb.slotSize() * bc.batchSize
+	buf := make([]byte, size+batchAlign)
+	off := int(uintptr(batchAlign)-uintptr(unsafe.Pointer(&buf[0]))%batchAlign) % batchAlign
+	fb.Data = buf[off : off+size : off+size]
+
+	return fb
+}
+
+// BatchConsumer receives full or timed out batches, it owns the batch.
+type BatchConsumer interface {
+	OnBatch(batch *FrameBatch)
+}
+
+/****************************batch collector*******************************/
+type batchCollector struct {
+	mutex    sync.Mutex
+	config   batchConfig
+	consumer BatchConsumer
+	cur      *FrameBatch
+	timer    *time.Timer
+}
+
+var (
+	collectorMutex sync.RWMutex
+	collector      *batchCollector
+)
+
+// InitBatchCollector resizes and packs decoded frames of all streams into
+// batches for consumer. A running collector is replaced, its open batch is
+// emitted to its consumer.
+func InitBatchCollector(bc *batchConfig, consumer BatchConsumer) error {
+	if bc == nil {
+		bc = NewBatchConfig()
+	}
+	if bc.batchSize <= 0 || bc.width <= 0 || bc.height <= 0 {
+		return errors.New(fmt.Sprintf("invalid batch config: %d x %dx%d", bc.batchSize, bc.width, bc.height))
+	}
+
+	collectorMutex.Lock()
+	old := collector
+	collector = &batchCollector{config: *bc, consumer: consumer}
+	collectorMutex.Unlock()
+
+	if old != nil {
+		old.flush(nil)
+	}
+
+	return nil
+}
+
+// StopBatchCollector emits the open batch and stops collecting.
+func StopBatchCollector() {
+	collectorMutex.Lock()
+	old := collector
+	collector = nil
+	collectorMutex.Unlock()
+
+	if old != nil {
+		old.flush(nil)
+	}
+}
+
+// reserve takes the next slot of the open batch, the batch is returned as
+// full when the slot was its last one.
+func (c *batchCollector) reserve() (*FrameBatch, int, bool) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+
+	if c.cur == nil {
+		fb := newFrameBatch(&c.config)
+		c.cur = fb
+		c.timer = time.AfterFunc(c.config.timeout, func() { c.flush(fb) })
+	}
+
+	fb := c.cur
+	slot := fb.Count
+	fb.Count++
+	fb.wg.Add(1)
+
+	if fb.Count < len(fb.Slots) {
+		return fb, slot, false
+	}
+
+	c.cur = nil
+	c.timer.Stop()
+	return fb, slot, true
+}
+
+// flush emits the open batch, when it is still fb or for any fb when nil.
+func (c *batchCollector) flush(fb *FrameBatch) {
+	c.mutex.Lock()
+	if c.cur == nil || (fb != nil && c.cur != fb) {
+		c.mutex.Unlock()
+		return
+	}
+	fb = c.cur
+	c.cur = nil
+	c.timer.Stop()
+	c.mutex.Unlock()
+
+	c.emit(fb)
+}
+
+// emit waits for the slots still being converted, then hands over the batch.
+func (c *batchCollector) emit(fb *FrameBatch) {
+	fb.wg.Wait()
+	fb.Slots = fb.Slots[:fb.Count]
+	fb.Data = fb.Data[:fb.Count*fb.slotSize()]
+
+	if c.consumer != nil {
+		c.consumer.OnBatch(fb)
+	}
+}
+
+// add converts the frame straight into its slot, outside the collector lock
+// so decode workers fill one batch in parallel.
+func (c *batchCollector) add(job *decodeJob, frame *gmf.Frame) {
+	fb, slot, full := c.reserve()
+
+	s := &fb.Slots[slot]
+	s.CalleeId, s.Timestamp = job.calleeId, job.enqueued
+	s.SrcWidth, s.SrcHeight = frame.Width(), frame.Height()
+
+	var asFloat C.pj_bool_t
+	if fb.Type == TensorFloat32 {
+		asFloat = C.PJ_TRUE
+	}
+
+	size := fb.slotSize()
+	dst := unsafe.Pointer(&fb.Data[slot*size])
+	if ret := C.ps_yuv_to_planar_rgb(avFrame(frame), C.int(fb.Width), C.int(fb.Height), asFloat, dst); ret != C.PJ_SUCCESS {
+		log.Printf("callee[%s] convert to batch error: %d\n", job.calleeId, ret)
+	} else {
+		s.Valid = true
+	}
+
+	fb.wg.Done()
+
+	if full {
+		c.emit(fb)
+	}
+}
+
+func collectBatch(job *decodeJob, frame *gmf.Frame) {
+	collectorMutex.RLock()
+	c := collector
+	collectorMutex.RUnlock()
+
+	if c != nil {
+		c.add(job, frame)
+	}
+}
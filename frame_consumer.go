@@ -0,0 +1,181 @@
+package gua
+
+/*
+#include "include/ps_yuv.h"
+
+*/
+import "C"
+import (
+	"log"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// FrameFormat is the pixel layout a FrameConsumer receives.
+type FrameFormat int
+
+const (
+	// FrameFormatI420 hands over the decoder planes as they are: y, u, v.
+	FrameFormatI420 FrameFormat = iota
+	// packed rgb in Planes[0], converted with libyuv
+	FrameFormatRGB24
+	FrameFormatBGR24
+	FrameFormatBGRA
+)
+
+func (ff FrameFormat) rgbFormat() RGBFormat {
+	switch ff {
+	case FrameFormatBGR24:
+		return RGBFormatBGR24
+	case FrameFormatBGRA:
+		return RGBFormatBGRA
+	default:
+		return RGBFormatRGB24
+	}
+}
+
+type FrameType int
+
+const (
+	FrameTypeUnknown FrameType = iota
+	FrameTypeI
+	FrameTypeP
+	FrameTypeB
+)
+
+// DecodedFrame is a decoded picture. The frame and its planes are borrowed
+// and only valid during FrameConsumer.OnFrame, call Retain to keep them.
+type DecodedFrame struct {
+	CalleeId  string
+	Width     int
+	Height    int
+	Format    FrameFormat
+	FullRange bool
+	Type      FrameType
+	// when the frame was received from the stream
+	Timestamp time.Time
+	Planes    [3][]byte
+	Strides   [3]int
+	// nil unless analytics are enabled
+	Scores *FrameScores
+}
+
+// Retain returns a copy of the frame which owns its planes.
+func (df *DecodedFrame) Retain() *DecodedFrame {
+	r := *df
+	for i, p := range df.Planes {
+		if p != nil {
+			r.Planes[i] = append([]byte(nil), p...)
+		}
+	}
+	return &r
+}
+
+// FrameConsumer receives the decoded pictures, instead of or next to the
+// jpeg snapshots of DecodedDataConsumer.
+type FrameConsumer interface {
+	OnFrame(frame *DecodedFrame)
+}
+
+var (
+	frameConsumer       FrameConsumer = nil
+	frameConsumerFormat               = FrameFormatI420
+	rgbBufPool          sync.Pool
+	decodedFramePool    = sync.Pool{New: func() interface{} { return new(DecodedFrame) }}
+)
+
+// InitFrameConsumer subscribes fc to the decoded frames in format, nil
+// unsubscribes. InitConsumer(nil) turns the jpeg encode off for consumers
+// which only need pixels.
+func InitFrameConsumer(fc FrameConsumer, format FrameFormat) {
+	frameConsumerFormat = format
+	frameConsumer = fc
+}
+
+// borrowBytes makes a slice over C memory without copying.
+func borrowBytes(p *C.uint8_t, n int) []byte {
+	if p == nil || n <= 0 {
+		return nil
+	}
+	return (*[1 << 30]byte)(unsafe.Pointer(p))[:n:n]
+}
+
+func frameType(f *C.AVFrame) FrameType {
+	switch f.pict_type {
+	case C.AV_PICTURE_TYPE_I:
+		return FrameTypeI
+	case C.AV_PICTURE_TYPE_P:
+		return FrameTypeP
+	case C.AV_PICTURE_TYPE_B:
+		return FrameTypeB
+	default:
+		return FrameTypeUnknown
+	}
+}
+
+// deliverFrame hands the decoded frame to the frame consumer, the planes
+// stay borrowed until it returns.
+func deliverFrame(job *decodeJob, frame *gmf.Frame, scores *FrameScores) {
+	fc := frameConsumer
+	if fc == nil {
+		return
+	}
+
+	af := avFrame(frame)
+	if af.format != C.AV_PIX_FMT_YUV420P && af.format != C.AV_PIX_FMT_YUVJ420P {
+		log.Printf("callee[%s] unsupported frame format: %d\n", job.calleeId, af.format)
+		return
+	}
+
+	df := decodedFramePool.Get().(*DecodedFrame)
+	defer func() {
+		*df = DecodedFrame{}
+		decodedFramePool.Put(df)
+	}()
+
+	*df = DecodedFrame{
+		CalleeId:  job.calleeId,
+		Width:     frame.Width(),
+		Height:    frame.Height(),
+		Format:    frameConsumerFormat,
+		FullRange: C.ps_yuv_is_full_range(af) != C.PJ_FALSE,
+		Type:      frameType(af),
+		Timestamp: job.enqueued,
+		Scores:    scores,
+	}
+
+	if df.Format == FrameFormatI420 {
+		ch := (df.Height + 1) / 2
+		for i, h := range [3]int{df.Height, ch, ch} {
+			df.Strides[i] = int(af.linesize[i])
+			df.Planes[i] = borrowBytes(af.data[i], df.Strides[i]*h)
+		}
+		fc.OnFrame(df)
+		return
+	}
+
+	rf := df.Format.rgbFormat()
+	stride := df.Width * rf.bytesPerPixel()
+	size := stride * df.Height
+
+	var buf []byte
+	if b, ok := rgbBufPool.Get().([]byte); ok && cap(b) >= size {
+		buf = b[:size]
+	} else {
+		buf = make([]byte, size)
+	}
+	defer rgbBufPool.Put(buf)
+
+	if err := frameToRGB(frame, buf, stride, rf); err != nil {
+		log.Printf("callee[%s] %v\n", job.calleeId, err)
+		return
+	}
+
+	df.FullRange = true
+	df.Planes[0] = buf
+	df.Strides[0] = stride
+	fc.OnFrame(df)
+}
@@ -0,0 +1,73 @@
+package gua
+
+/*
+#include "include/ps_yuv.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"unsafe"
+
+	"github.com/peace0phmind/gmf"
+)
+
+type RGBFormat int
+
+const (
+	RGBFormatRGB24 RGBFormat = C.PS_YUV_RGB24
+	RGBFormatBGR24 RGBFormat = C.PS_YUV_BGR24
+	RGBFormatBGRA  RGBFormat = C.PS_YUV_BGRA
+)
+
+func (rf RGBFormat) bytesPerPixel() int {
+	if rf == RGBFormatBGRA {
+		return 4
+	}
+	return 3
+}
+
+// avFrame returns the AVFrame behind a gmf frame.
+func avFrame(f *gmf.Frame) *C.AVFrame {
+	return (*C.AVFrame)(unsafe.Pointer(f.GetRawFrame()))
+}
+
+// scaleFrame scales the i420 src into dst with libyuv, dst keeps its size.
+// With fullRange a limited range src is expanded while writing dst.
+func scaleFrame(src, dst *gmf.Frame, fullRange bool) error {
+	var pjFullRange C.pj_bool_t
+	if fullRange {
+		pjFullRange = C.PJ_TRUE
+	}
+
+	if ret := C.ps_yuv_scale(avFrame(src), avFrame(dst), pjFullRange); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("scale frame error: %d", ret))
+	}
+
+	return nil
+}
+
+// expandRange turns a limited range i420 frame into yuvj420p in place. The
+// frame must not be shared with a decoder which is still in use.
+func expandRange(f *gmf.Frame) error {
+	if ret := C.ps_yuv_expand_range(avFrame(f)); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("expand range error: %d", ret))
+	}
+
+	return nil
+}
+
+// frameToRGB converts an i420 frame to packed rgb in dst, which must hold
+// height rows of stride bytes.
+func frameToRGB(f *gmf.Frame, dst []byte, stride int, format RGBFormat) error {
+	if stride < f.Width()*format.bytesPerPixel() || len(dst) < stride*f.Height() {
+		return errors.New("rgb buffer too small")
+	}
+
+	if ret := C.ps_yuv_to_rgb(avFrame(f), (*C.pj_uint8_t)(unsafe.Pointer(&dst[0])), C.int(stride), C.ps_yuv_rgb_fmt(format)); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("convert to rgb error: %d", ret))
+	}
+
+	return nil
+}
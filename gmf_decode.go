@@ -1,17 +1,23 @@
 package gua
 
 /*
-#include "include/ps_codecs.h"
+#include <stdlib.h>
+#include "include/ps_event_ring.h"
 
 */
 import "C"
 import (
+	"errors"
+	"fmt"
 	"github.com/peace0phmind/gmf"
 	"log"
 	"syscall"
+	"time"
 	"unsafe"
 )
 
+// DecodedDataConsumer receives the jpeg snapshots, see FrameConsumer for
+// the decoded pictures.
 type DecodedDataConsumer interface {
 	OnConsumer(string, []byte)
 }
@@ -52,123 +58,218 @@ func InitConsumer(ddc DecodedDataConsumer) {
 	consumer = ddc
 }
 
-//export on_decode_cb
-func on_decode_cb(ps *C.ps_codec) {
-	if len(ps.callee_id) == 0 {
+// EnableNativeSnapshot moves decode and jpeg encode of i frames into the ps
+// codec, using the decoder it already opened for the stream. Only the
+// finished jpeg crosses into Go. Call it after GuaContext.Init.
+func EnableNativeSnapshot(enable bool) error {
+	var pjEnable C.pj_bool_t
+	if enable {
+		pjEnable = C.PJ_TRUE
+	}
+
+	if ret := C.pjmedia_codec_ps_vid_set_native_snapshot(pjEnable, nil); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("Enable native snapshot error: %d", ret))
+	}
+
+	return nil
+}
+
+// onFrameEvent hands an i frame drained from the event ring over to the
+// decode workers, it owns the frame copy of the event.
+func onFrameEvent(ev *C.ps_event) {
+	calleeId := calleeIdFrom(&ev.callee_id[0])
+	if len(calleeId) == 0 {
 		log.Println("callee id is nil, ignore this data...")
 	}
 
-	calleeId := C.GoString(&ps.callee_id[0])
+	log.Printf("recv decode from callee[%s]. len: %d\n", calleeId, ev.size)
 
-	log.Printf("recv decode from callee[%s]. remain len: %d, idx: %d, expect len: %d, real len: %d\n", calleeId,
-		ps.remain_buf_len, ps.pkt_idx, ps.total_video_pes_len, ps.dec_data_len)
+	lazy := getStream(calleeId).lazyState() != nil
 
-	pkt := gmf.NewPacketWith(unsafe.Pointer(ps.dec_buf), int(ps.dec_data_len))
+	// a lazy stream keeps its previous frame and jpeg for a duplicate
+	if ev.is_duplicate != C.PJ_FALSE && (lazy || reemitSnapshot(calleeId)) {
+		C.free(unsafe.Pointer(ev.buf))
+		return
+	}
 
-	log.Printf("buf: %v, size: %v, pkt: %v\n", ps.dec_buf, ps.dec_data_len, pkt)
+	// hand the frame over to the decode workers, never decode on the drain goroutine
+	job := newDecodeJob(ev, calleeId)
 
-	codec := decoder[int(ps.video_codec_id)]
+	if lazy && keepLazyFrame(calleeId, job) {
+		return
+	}
 
-	if codec == nil {
-		log.Printf("unable to find decoder from ps video codec: %v\n", ps.video_codec_id)
+	submitDecodeJob(job)
+}
+
+//export on_snapshot_cb
+func on_snapshot_cb(ps *C.ps_codec, jpeg *C.pj_uint8_t, size C.uint) {
+	if consumer == nil {
 		return
 	}
 
+	calleeId := calleeIdOf(ps)
+
+	// the jpeg is only valid during the call, lend a pooled copy
+	if sc, ok := consumer.(SnapshotConsumer); ok {
+		sc.OnSnapshot(copySnapshot(calleeId, unsafe.Pointer(jpeg), int(size)))
+		return
+	}
+
+	consumer.OnConsumer(calleeId, C.GoBytes(unsafe.Pointer(jpeg), C.int(size)))
+}
+
+// decodePicture decodes the i frame of job with the params read from its
+// stream, the caller frees the frame.
+func decodePicture(job *decodeJob, dp decodeParams) (*gmf.Frame, error) {
+	pkt := gmf.NewPacketWith(unsafe.Pointer(job.buf), job.size)
+
+	log.Printf("buf: %v, size: %v, pkt: %v\n", job.buf, job.size, pkt)
+
+	codec := decoder[job.codecId]
+
+	if codec == nil {
+		return nil, errors.New(fmt.Sprintf("unable to find decoder from ps video codec: %v", job.codecId))
+	}
+
+	dtc := governor.acquire(dp.class, dp.width, dp.height, false)
+	// released after the context is freed, defers run in reverse
+	defer governor.release(dp.class, dtc)
+
 	var cc *gmf.CodecCtx
 	if cc = gmf.NewCodecCtx(codec); cc == nil {
-		log.Println("unable to create codec context")
-		return
+		return nil, errors.New("unable to create codec context")
 	}
 
 	defer gmf.Release(cc)
 
-	if err := cc.Open(nil); err != nil {
-		log.Printf("open codec ctx err: %v\n", err)
-		return
+	profile := dp.profile
+	start := time.Now()
+
+	// all options are consumed by avcodec_open2, the dictionary is left empty
+	if err := cc.Open(gmf.NewDict(append(dtc.pairs(), profile.pairs(job.codecId)...))); err != nil {
+		return nil, errors.New(fmt.Sprintf("open codec ctx err: %v", err))
 	}
 
 	frame, ret := cc.Decode2(pkt)
 
 	if ret < 0 && gmf.AvErrno(ret) == syscall.EAGAIN {
-		log.Printf("decode err")
-		return
+		return nil, errors.New("decode err")
 	} else if ret == gmf.AVERROR_EOF {
-		log.Printf("EOF in Decode2, handle it\n")
-		return
+		return nil, errors.New("EOF in Decode2")
 	} else if ret < 0 {
-		log.Printf("Unexpected error - %s\n", gmf.AvError(ret))
-		return
+		return nil, errors.New(fmt.Sprintf("Unexpected error - %s", gmf.AvError(ret)))
 	}
 
+	profileStats.add(profile, job.size, time.Since(start))
+
 	log.Printf("%v\n", frame)
 
+	return frame, nil
+}
+
+// encodeSnapshot encodes a full range frame to jpeg with the selected
+// snapshot encoder, mjpeg is the fallback. The frame is not freed.
+func encodeSnapshot(frame *gmf.Frame) ([]byte, error) {
+	if enc, jc := currentSnapshotEncoder(); enc == SnapshotEncoderTurboJpeg {
+		data, err := encodeTurboJpeg(frame, jc)
+		if err == nil {
+			return data, nil
+		}
+		log.Printf("%v, fall back to mjpeg\n", err)
+	}
+
+	return encodeMjpeg(frame)
+}
+
+func encodeMjpeg(frame *gmf.Frame) ([]byte, error) {
 	occ := gmf.NewCodecCtx(encoder)
+	if occ == nil {
+		return nil, errors.New("unable to create encode codec context")
+	}
 	defer gmf.Release(occ)
 
-	occ.SetPixFmt(gmf.AV_PIX_FMT_YUVJ420P).SetWidth(cc.Width()).SetHeight(cc.Height())
+	// the thumbnail profile may decode at reduced resolution
+	occ.SetPixFmt(gmf.AV_PIX_FMT_YUVJ420P).SetWidth(frame.Width()).SetHeight(frame.Height())
 	occ.SetTimeBase(gmf.AVR{Num: 1, Den: 1})
 
 	if err := occ.Open(nil); err != nil {
-		log.Printf("occ open error: %v\n", err)
-		return
+		return nil, errors.New(fmt.Sprintf("occ open error: %v", err))
 	}
 
-	outputCtx, err := gmf.NewOutputCtx("test.jpeg")
+	packets, err := occ.Encode([]*gmf.Frame{frame}, -1)
 	if err != nil {
-		log.Printf("output ctx error: %v\n", err)
-		return
+		return nil, err
+	}
+
+	var data []byte
+	for _, op := range packets {
+		data = op.Data()
+		op.Free()
 	}
-	defer outputCtx.Free()
-	outputCtx.Dump()
-
-	//fg, err := gmf.NewSimpleVideoGraph("crop=w=800:h=600:x=0:y=0", cc, occ)
-	//if err != nil {
-	//	log.Printf("SimpleVideoGraph error: %v\n", err)
-	//	return
-	//}
-	//
-	//var (
-	//	ff    []*gmf.Frame
-	//)
-	//
-	//if frame != nil {
-	//	if err := fg.AddFrame(frame, 0, 1); err != nil {
-	//		log.Fatalf("%s\n", err)
-	//	}
-	//	fg.Dump()
-	//	frame.Free()
-	//}
-	//
-	//if err := fg.AddFrame(frame, 0, 4); err != nil {
-	//	log.Fatalf("%s\n", err)
-	//}
-	//frame.Free()
-	//
-	//if ff, err = fg.GetFrame(); err != nil && len(ff) == 0 {
-	//	log.Printf("GetFrame() returned '%s', continue\n", err)
-	//	return
-	//}
-	//
-	//if len(ff) == 0 {
-	//	log.Println("GetFrame() length zero")
-	//	return
-	//}
-
-	// TODO remove when fix fiter graph issue, use ff
-	result := []*gmf.Frame{frame}
-	packets, err := occ.Encode(result, -1)
+
+	if data == nil {
+		return nil, errors.New("encoder returned no packet")
+	}
+
+	return data, nil
+}
+
+func decodeFrame(job *decodeJob) {
+	calleeId := job.calleeId
+	ss := getStream(calleeId)
+
+	dp := ss.decodeParams()
+	frame, err := decodePicture(job, dp)
 	if err != nil {
-		log.Fatal(err)
+		log.Printf("callee[%s] %v\n", calleeId, err)
+		return
 	}
+	defer frame.Free()
+
+	ss.decoded(dp, frame.Width(), frame.Height())
+
+	scores, still := analyseFrame(ss, frame)
 
-	for _, f := range result {
-		f.Free()
+	deliverFrame(job, frame, scores)
+	collectBatch(job, frame)
+
+	// nobody subscribed to jpeg or nothing moved, skip the encode
+	if consumer == nil || still {
+		return
 	}
 
-	for _, op := range packets {
-		if consumer != nil {
-			consumer.OnConsumer(calleeId, op.Data())
+	if vc, ok := consumer.(VariantConsumer); ok && encodeVariants(ss, frame, vc) {
+		return
+	}
+
+	// the context only ever decodes this frame, so the picture can be
+	// expanded to the full range the jpeg encoder expects in place
+	if err := expandRange(frame); err != nil {
+		log.Printf("callee[%s] %v\n", calleeId, err)
+	}
+
+	if rc, ok := consumer.(RegionConsumer); ok && encodeRegions(ss, frame, rc) {
+		return
+	}
+
+	// borrowed snapshots are not kept for duplicate frames
+	if sc, ok := consumer.(SnapshotConsumer); ok {
+		s, err := encodeBorrowedSnapshot(calleeId, frame)
+		if err != nil {
+			log.Printf("callee[%s] %v\n", calleeId, err)
+			return
 		}
-		op.Free()
+		sc.OnSnapshot(s)
+		return
 	}
+
+	data, err := encodeSnapshot(frame)
+	if err != nil {
+		log.Printf("callee[%s] encode snapshot error: %v\n", calleeId, err)
+		return
+	}
+
+	ss.setLastJpeg(data)
+	consumer.OnConsumer(calleeId, data)
 }
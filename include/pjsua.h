@@ -1825,10 +1825,10 @@ typedef struct pjsua_config
 
     /** 
      * Maximum calls to support (default: 4). The value specified here
-     * must be smaller than the compile time maximum settings 
-     * PJSUA_MAX_CALLS, which by default is 32. To increase this 
-     * limit, the library must be recompiled with new PJSUA_MAX_CALLS
-     * value.
+     * is capped at the compile time maximum settings
+     * PJSUA_MAX_CALLS, which by default is 4096. The call table is
+     * allocated by segments of PJSUA_CALL_SEG_SIZE calls as calls are
+     * made, so a large value costs little until it is used.
      */
     unsigned	    max_calls;
 
@@ -3093,10 +3093,28 @@ PJ_DECL(pj_status_t) pjsua_transport_lis_start( pjsua_transport_id id,
  */
 
 /**
- * Maximum accounts.
+ * Maximum accounts. The account table grows by segments of
+ * PJSUA_ACC_SEG_SIZE accounts as they are added, so this only bounds the
+ * account ids and costs one pointer per segment.
  */
 #ifndef PJSUA_MAX_ACC
-#   define PJSUA_MAX_ACC	    8
+#   define PJSUA_MAX_ACC	    1024
+#endif
+
+/**
+ * Number of accounts of one account table segment.
+ */
+#ifndef PJSUA_ACC_SEG_SIZE
+#   define PJSUA_ACC_SEG_SIZE	    8
+#endif
+
+/**
+ * Number of buckets of the account indexes, a power of two. Incoming
+ * requests find their account by user and domain, outgoing ones by
+ * domain, without walking the accounts.
+ */
+#ifndef PJSUA_ACC_INDEX_SIZE
+#   define PJSUA_ACC_INDEX_SIZE	    256
 #endif
 
 
@@ -4602,10 +4620,19 @@ PJ_DECL(pj_status_t) pjsua_acc_set_transport(pjsua_acc_id acc_id,
  */
 
 /**
- * Maximum simultaneous calls.
+ * Maximum simultaneous calls. The call table grows by segments of
+ * PJSUA_CALL_SEG_SIZE calls up to pjsua_config.max_calls, so this only
+ * bounds the call ids and costs one pointer per segment.
  */
 #ifndef PJSUA_MAX_CALLS
-#   define PJSUA_MAX_CALLS	    32
+#   define PJSUA_MAX_CALLS	    4096
+#endif
+
+/**
+ * Number of calls of one call table segment, a power of two.
+ */
+#ifndef PJSUA_CALL_SEG_SIZE
+#   define PJSUA_CALL_SEG_SIZE	    32
 #endif
 
 /**
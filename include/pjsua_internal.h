@@ -205,6 +205,12 @@ struct pjsua_call
 					    created yet. This temporary 
 					    variable is used to handle such 
 					    case, see ticket #1916.	    */
+    pj_bool_t		 in_setup;  /**< Allocated, the dialog is being
+					    created without PJSUA_LOCK().  */
+
+    /* Kept by reset_call() */
+    pj_bool_t		 in_free_list;/**< Queued in the free call ids.	    */
+    pjsua_call_id	 next_free; /**< Next free call id.		    */
 };
 
 
@@ -223,6 +229,25 @@ struct pjsua_srv_pres
     					 if not present.    		    */
 };
 
+/**
+ * The account indexes, see pjsua_data.acc_index.
+ */
+typedef enum pjsua_acc_index_type
+{
+    PJSUA_ACC_INDEX_URI,	    /**< By user part and domain.	*/
+    PJSUA_ACC_INDEX_DOMAIN,	    /**< By domain.			*/
+    PJSUA_ACC_INDEX_CNT
+} pjsua_acc_index_type;
+
+/**
+ * Link of an account in the bucket of an account index.
+ */
+typedef struct pjsua_acc_link
+{
+    pj_uint32_t	     hash;	    /**< Hash of the key.		*/
+    pjsua_acc_id     next;	    /**< Next account of the bucket.	*/
+} pjsua_acc_link;
+
 /**
  * Account
  */
@@ -296,6 +321,10 @@ typedef struct pjsua_acc
     pjsip_transport_type_e tp_type; /**< Transport type (for local acc or
 				         transport binding)		*/
     pjsua_ip_change_op ip_change_op;/**< IP change process progress.	*/
+
+    pj_bool_t	     indexed;	    /**< Linked in the account indexes.	*/
+    pjsua_acc_link   link[PJSUA_ACC_INDEX_CNT];
+				    /**< Links of the account indexes.	*/
 } pjsua_acc;
 
 
@@ -473,14 +502,29 @@ struct pjsua_data
     /* Account: */
     unsigned		 acc_cnt;	     /**< Number of accounts.	*/
     pjsua_acc_id	 default_acc;	     /**< Default account ID	*/
-    pjsua_acc		 acc[PJSUA_MAX_ACC]; /**< Account array.	*/
+    pjsua_acc		*acc_seg[PJSUA_MAX_ACC / PJSUA_ACC_SEG_SIZE];
+					     /**< Account table segments,
+						  see PJSUA_ACC().	*/
+    unsigned		 acc_slots;	     /**< Account ids backed by
+						  a segment.		*/
     pjsua_acc_id	 acc_ids[PJSUA_MAX_ACC]; /**< Acc sorted by prio*/
+    pjsua_acc_id	 acc_index[PJSUA_ACC_INDEX_CNT][PJSUA_ACC_INDEX_SIZE];
+					     /**< Bucket heads of the
+						  account indexes, the
+						  buckets are sorted by
+						  priority like acc_ids. */
 
     /* Calls: */
     pjsua_config	 ua_cfg;		/**< UA config.		*/
     unsigned		 call_cnt;		/**< Call counter.	*/
-    pjsua_call		 calls[PJSUA_MAX_CALLS];/**< Calls array.	*/
-    pjsua_call_id	 next_call_id;		/**< Next call id to use*/
+    pjsua_call		*call_seg[PJSUA_MAX_CALLS / PJSUA_CALL_SEG_SIZE];
+						/**< Call table segments,
+						     see PJSUA_CALL().	*/
+    unsigned		 call_slots;		/**< Call ids backed by
+						     a segment.		*/
+    pjsua_call_id	 call_free_head;	/**< Free call ids, the
+						     oldest first.	*/
+    pjsua_call_id	 call_free_tail;
 
     /* Buddy; */
     unsigned		 buddy_cnt;		    /**< Buddy count.	*/
@@ -544,6 +588,20 @@ struct pjsua_data
 
 extern struct pjsua_data pjsua_var;
 
+/**
+ * The call of a call id, an lvalue. The id must be below
+ * pjsua_var.call_slots.
+ */
+#define PJSUA_CALL(id)	(pjsua_var.call_seg[(unsigned)(id) / PJSUA_CALL_SEG_SIZE] \
+				   [(unsigned)(id) % PJSUA_CALL_SEG_SIZE])
+
+/**
+ * The account of an account id, an lvalue. The id must be below
+ * pjsua_var.acc_slots.
+ */
+#define PJSUA_ACC(id)	(pjsua_var.acc_seg[(unsigned)(id) / PJSUA_ACC_SEG_SIZE] \
+				  [(unsigned)(id) % PJSUA_ACC_SEG_SIZE])
+
 /**
  * Get the instance of pjsua
  */
@@ -586,6 +644,12 @@ PJ_INLINE(pjsua_im_data*) pjsua_im_data_dup(pj_pool_t *pool,
 }
 
 
+/*
+ * Lock order: the lock of a call is the lock of its dialog, see
+ * acquire_call(), and it is taken before PJSUA_LOCK(). The sip stack calls
+ * back with the dialog locked, so code holding PJSUA_LOCK() only try-locks
+ * a dialog, or locks one no other thread can reach yet.
+ */
 #if 1
 
 PJ_INLINE(void) PJSUA_LOCK()
@@ -648,6 +712,9 @@ pj_bool_t pjsua_media_acc_is_using_stun(pjsua_acc_id acc_id);
 /* acc use IPv6? */
 pj_bool_t pjsua_sip_acc_is_using_ipv6(pjsua_acc_id acc_id);
 
+/* Add one segment to the account table */
+pj_status_t pjsua_acc_grow_table(void);
+
 /* Get local transport address suitable to be used for Via or Contact address
  * to send request to the specified destination URI.
  */
@@ -0,0 +1,55 @@
+/*
+ * Luma analytics for decoded pictures: motion, black frame, blur and
+ * occlusion scores computed on a downscaled grid. This is not a public API.
+ */
+
+#ifndef __PS_ANALYTICS_H__
+#define __PS_ANALYTICS_H__
+
+#include <pj/types.h>
+#include <libavutil/frame.h>
+
+
+PJ_BEGIN_DECL
+
+#define PS_ANALYTICS_HIST_BINS  16
+
+typedef struct ps_analytics_scores {
+    float       mean_luma;      /**< 0 - 255                                */
+    float       dark_ratio;     /**< Part of the grid darker than 32        */
+    float       contrast;       /**< Luma standard deviation                */
+    float       sharpness;      /**< Variance of the laplacian, low is blur */
+    float       motion;         /**< Mean abs difference to previous grid   */
+    float       motion_area;    /**< Part of the grid which changed         */
+    float       dominant_bin;   /**< Part of the grid in the fullest
+                                     histogram bin, high is occlusion      */
+    pj_bool_t   has_previous;   /**< Motion scores are valid               */
+} ps_analytics_scores;
+
+typedef struct ps_analytics_grid ps_analytics_grid;
+
+/**
+ * Create the grid state of one stream. Pictures are box scaled to width,
+ * keeping the aspect ratio.
+ */
+pj_status_t ps_analytics_grid_create(int width, ps_analytics_grid **p_grid);
+
+/**
+ * Score the luma plane of an i420 picture against the previous picture of
+ * the grid, which is replaced by it afterwards.
+ *
+ * @param grid          The stream grid.
+ * @param frame         The picture.
+ * @param motion_thresh Per cell abs difference counted as changed.
+ * @param scores        Receives the scores.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+pj_status_t ps_analytics_run(ps_analytics_grid *grid, const AVFrame *frame,
+                             int motion_thresh, ps_analytics_scores *scores);
+
+void ps_analytics_grid_destroy(ps_analytics_grid *grid);
+
+PJ_END_DECL
+
+#endif	/* __PS_ANALYTICS_H__ */
@@ -6,6 +6,7 @@
 #include <pjmedia/vid_codec.h>
 #include <libavcodec/avcodec.h>
 #include <pjsip/sip_uri.h>
+#include "ps_jpeg.h"
 
 
 PJ_BEGIN_DECL
@@ -37,6 +38,10 @@ typedef struct ps_codec {
     enum AVCodecID     audio_codec_id;
     // cname
     char    callee_id[PJSIP_MAX_URL_SIZE];
+    // fingerprint of i frame slice data, 0 when not computed
+    pj_uint64_t   bitstream_hash;
+    // same fingerprint as the previous i frame of the stream
+    pj_bool_t     is_duplicate;
 } ps_codec;
 
 /**
@@ -65,10 +70,133 @@ typedef struct pjmedia_ps_codec_callback {
      * when whole data ready, decode call this cb
      */
     void (*on_decode_cb)(ps_codec *codec);
+
+    /**
+     * when native snapshot is enabled, the jpeg encoded from i frame is
+     * passed to this cb instead of on_decode_cb. It is called on a decode
+     * worker thread, jpeg is only valid during the call.
+     */
+    void (*on_snapshot_cb)(ps_codec *codec, const pj_uint8_t *jpeg, unsigned len);
+
+    /**
+     * when motion detection is enabled, the motion activity grid of one
+     * picture in interval, grid_w * grid_h cells in row order. called on
+     * a decode worker thread, grid is only valid during the call.
+     */
+    void (*on_motion_cb)(ps_codec *codec, const float *grid, unsigned grid_w,
+                         unsigned grid_h, float activity);
 } pjmedia_ps_codec_callback;
 
 PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_init_cb(pjmedia_ps_codec_callback *cb);
 
+/**
+ * C side consumer of native snapshots. When set, snapshots never leave C.
+ */
+typedef struct pjmedia_ps_snapshot_sink {
+    void (*on_snapshot)(void *user_data, const char *callee_id,
+                        const pj_uint8_t *jpeg, unsigned len);
+    void *user_data;
+} pjmedia_ps_snapshot_sink;
+
+/**
+ * Enable or disable the native snapshot pipeline. When enabled, i frames
+ * are decoded and encoded to jpeg in C on the decode workers, the media
+ * thread only copies them. I frames of a stream whose callee is not known
+ * still go to on_decode_cb.
+ *
+ * @param enable    Enable or disable native snapshot.
+ * @param sink      Optional C sink, specify NULL to pass jpeg to the
+ *                  on_snapshot_cb of the codec callback.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_set_native_snapshot(pj_bool_t enable,
+                                                              const pjmedia_ps_snapshot_sink *sink);
+
+/**
+ * Enable or disable duplicate i frame detection. When enabled, a hash of
+ * the slice data of every i frame is computed, ignoring sei and timing.
+ * An i frame hashing like the previous one of the stream is flagged with
+ * is_duplicate, the native snapshot pipeline re-emits its last jpeg for
+ * it without decoding.
+ *
+ * @param enable    Enable or disable duplicate detection.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_set_dedup(pj_bool_t enable);
+
+/**
+ * Motion detection settings.
+ */
+typedef struct pjmedia_ps_motion_param {
+    unsigned    grid_w;         /**< Activity grid columns                 */
+    unsigned    grid_h;         /**< Activity grid rows                    */
+    float       threshold;      /**< Frame activity which counts as motion */
+    pj_bool_t   gate_snapshot;  /**< Only pass i frames on after motion    */
+    unsigned    interval;       /**< Analyse one picture in interval, 0 or
+                                     1 analyses every picture             */
+} pjmedia_ps_motion_param;
+
+/**
+ * Enable or disable motion detection from the motion vectors of p frames.
+ * Every frame of a stream with a known callee is copied to a decode worker
+ * and fed to a decoder exporting motion vectors with the inverse transform
+ * and loop filter skipped, no picture leaves it. The vectors of one picture
+ * in interval are summed into an activity grid passed to on_motion_cb.
+ *
+ * @param enable    Enable or disable motion detection.
+ * @param param     Settings, specify NULL for 16x9 cells, threshold 1, one
+ *                  picture in 5 and no snapshot gating.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_set_motion(pj_bool_t enable,
+                                                     const pjmedia_ps_motion_param *param);
+
+/**
+ * Continuous decode settings.
+ */
+typedef struct pjmedia_ps_live_param {
+    unsigned    threads;        /**< Decoder threads, 0 is one             */
+    pj_bool_t   frame_threads;  /**< Frame instead of slice threading      */
+} pjmedia_ps_live_param;
+
+/**
+ * Enable or disable continuous decode of a stream. A live stream keeps a
+ * decoder fed with every frame and holds its latest picture, one frame
+ * per stream, so a current snapshot does not wait for the next i frame.
+ * The frames are decoded on worker threads, the media thread only copies
+ * them; when a worker falls behind the stream skips to the next i frame.
+ * Pictures are not encoded until pjmedia_codec_ps_vid_live_snapshot().
+ *
+ * @param callee_id The stream.
+ * @param enable    Enable or disable continuous decode.
+ * @param param     Decoder threading used from the next decoder opened,
+ *                  specify NULL for a single thread.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_set_live(const char *callee_id,
+                                                   pj_bool_t enable,
+                                                   const pjmedia_ps_live_param *param);
+
+/**
+ * Encode the latest picture of a live stream to jpeg.
+ *
+ * @param callee_id The stream.
+ * @param param     Jpeg param, specify NULL for defaults.
+ * @param jpeg      Receives the jpeg, release it with free().
+ * @param len       Receives the jpeg length.
+ *
+ * @return          PJ_SUCCESS on success, PJ_ENOTFOUND when the stream is
+ *                  not live or has no picture yet.
+ */
+PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_live_snapshot(const char *callee_id,
+                                                        const ps_jpeg_param *param,
+                                                        pj_uint8_t **jpeg,
+                                                        unsigned long *len);
+
 /**
  * Unregister ps video codecs factory from the video codec manager and
  * deinitialize the codecs library.
@@ -0,0 +1,150 @@
+/*
+ * Lock free ring the media and sip threads post frames and pjsua events
+ * to. A single reader drains it in batches, so events cross into
+ * Go once per batch instead of once per event. This is not a public API.
+ */
+
+#ifndef __PS_EVENT_RING_H__
+#define __PS_EVENT_RING_H__
+
+#include "pjsua.h"
+#include "ps_codecs.h"
+
+
+PJ_BEGIN_DECL
+
+#define PS_EVENT_REASON_SIZE    64
+#define PS_EVENT_MIME_SIZE      64
+
+typedef enum ps_event_type {
+    PS_EVENT_FRAME,
+    PS_EVENT_REG_STARTED,
+    PS_EVENT_REG_STATE,
+    PS_EVENT_CALL_STATE,
+    PS_EVENT_CALL_MEDIA_STATE,
+    PS_EVENT_PAGER,
+    PS_EVENT_ACC_RELEASED,
+} ps_event_type;
+
+typedef struct ps_event {
+    ps_event_type   type;
+
+    /* PS_EVENT_FRAME */
+    char            callee_id[PJSIP_MAX_URL_SIZE];
+    int             codec_id;
+    pj_bool_t       is_duplicate;
+    pj_uint8_t      *buf;           /**< Padded copy of the i frame or the
+                                         message body, the reader frees
+                                         it with free()                 */
+    unsigned        size;
+
+    /* all but PS_EVENT_FRAME, PJSUA_INVALID_ID when unknown */
+    pjsua_acc_id    acc_id;
+    pjsua_call_id   call_id;
+
+    /* user data of the account, copied when the event is filled since
+     * the account may be gone once the event is read. PS_EVENT_ACC_RELEASED
+     * only carries this.
+     */
+    void            *acc_user_data;
+
+    /* PS_EVENT_REG_STARTED and PS_EVENT_REG_STATE */
+    pj_bool_t       renew;
+    pj_status_t     status;
+    unsigned        expiration;
+
+    /* registration response, or last response of the call */
+    int             code;
+    char            reason[PS_EVENT_REASON_SIZE];
+
+    /* PS_EVENT_CALL_STATE and PS_EVENT_CALL_MEDIA_STATE */
+    int             call_state;
+    int             media_status;
+
+    /* PS_EVENT_PAGER, the body is in buf */
+    char            from[PJSIP_MAX_URL_SIZE];
+    char            to[PJSIP_MAX_URL_SIZE];
+    char            mime_type[PS_EVENT_MIME_SIZE];
+} ps_event;
+
+typedef struct ps_event_ring ps_event_ring;
+
+/**
+ * Create a ring of capacity events, rounded up to a power of two.
+ */
+pj_status_t ps_event_ring_create(unsigned capacity, ps_event_ring **p_ring);
+
+/**
+ * Post an event, any thread may post. Fails with PJ_ETOOMANY when the
+ * ring is full and PJ_EINVALIDOP once it is closed, the event is not
+ * taken then.
+ */
+pj_status_t ps_event_ring_post(ps_event_ring *ring, const ps_event *ev);
+
+/**
+ * Post an event which must not be dropped, any thread may post. Events
+ * posted this way are read in the order they were posted, those which do
+ * not fit in the ring wait in an unbounded spill list. Fails with
+ * PJ_EINVALIDOP once the ring is closed and PJ_ENOMEM when no spill entry
+ * can be allocated, the event is not taken then.
+ */
+pj_status_t ps_event_ring_post_kept(ps_event_ring *ring, const ps_event *ev);
+
+/**
+ * Post the i frame of the codec, the frame is copied.
+ */
+pj_status_t ps_event_post_frame(ps_event_ring *ring, const ps_codec *ps);
+
+/**
+ * Fill a registration event, info may be NULL for PS_EVENT_REG_STARTED.
+ */
+void ps_event_fill_reg(ps_event *ev, ps_event_type type, pjsua_acc_id acc_id,
+                       pj_bool_t renew, const pjsua_reg_info *info);
+
+/**
+ * Fill a call event from the call info.
+ */
+void ps_event_fill_call(ps_event *ev, ps_event_type type, pjsua_call_id call_id);
+
+/**
+ * Fill a PS_EVENT_PAGER event, the body is copied.
+ */
+pj_status_t ps_event_fill_pager(ps_event *ev, pjsua_call_id call_id,
+                                pjsua_acc_id acc_id, const pj_str_t *from,
+                                const pj_str_t *to, const pj_str_t *mime_type,
+                                const pj_str_t *body);
+
+/**
+ * Fill a PS_EVENT_ACC_RELEASED event, posted after the account was deleted
+ * so the reader knows no event of it follows.
+ */
+void ps_event_fill_acc_released(ps_event *ev, void *acc_user_data);
+
+/**
+ * Move up to max events into out, blocking while the ring is empty. Only
+ * one thread may drain.
+ *
+ * @return          The number of events, 0 once the ring is closed and
+ *                  empty.
+ */
+unsigned ps_event_ring_drain(ps_event_ring *ring, ps_event *out, unsigned max);
+
+/**
+ * Frames which were not posted because the ring was full, and kept events
+ * lost for lack of memory.
+ */
+pj_uint64_t ps_event_ring_dropped(ps_event_ring *ring);
+
+/**
+ * Refuse new events and wake the reader, it drains what is left.
+ */
+void ps_event_ring_close(ps_event_ring *ring);
+
+/**
+ * Destroy a closed ring, frames and bodies never drained are freed.
+ */
+void ps_event_ring_destroy(ps_event_ring *ring);
+
+PJ_END_DECL
+
+#endif	/* __PS_EVENT_RING_H__ */
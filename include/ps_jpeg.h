@@ -0,0 +1,49 @@
+/*
+ * Jpeg encoder feeding decoded i420 planes straight into libjpeg-turbo
+ * raw data api. This is not a public API.
+ */
+
+#ifndef __PS_JPEG_H__
+#define __PS_JPEG_H__
+
+#include <pj/types.h>
+#include <libavutil/frame.h>
+
+
+PJ_BEGIN_DECL
+
+typedef enum ps_jpeg_subsamp {
+    PS_JPEG_420,
+    PS_JPEG_422,
+    PS_JPEG_444,
+} ps_jpeg_subsamp;
+
+typedef struct ps_jpeg_param {
+    int                 quality;    /**< 1 - 100                    */
+    ps_jpeg_subsamp     subsamp;    /**< Chroma subsampling of jpeg */
+    pj_bool_t           optimize;   /**< Optimize huffman tables    */
+} ps_jpeg_param;
+
+/**
+ * Init encode param with default values.
+ */
+void ps_jpeg_param_default(ps_jpeg_param *param);
+
+/**
+ * Encode a full range i420 picture to jpeg. The planes are used in place
+ * for 4:2:0 and 4:2:2, only 4:4:4 needs to upsample chroma rows.
+ *
+ * @param src       The picture, rows must be padded to the jpeg mcu
+ *                  width like ffmpeg allocated frames are.
+ * @param param     Encode param.
+ * @param out       Receives the jpeg, release it with free().
+ * @param out_len   Receives the jpeg length.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+pj_status_t ps_jpeg_encode(const AVFrame *src, const ps_jpeg_param *param,
+                           pj_uint8_t **out, unsigned long *out_len);
+
+PJ_END_DECL
+
+#endif	/* __PS_JPEG_H__ */
@@ -0,0 +1,81 @@
+/*
+ * Bulk snapshots of the accounts, calls and media streams of pjsua, filled
+ * into caller arrays in one call. This is not a public API.
+ */
+
+#ifndef __PS_QUERY_H__
+#define __PS_QUERY_H__
+
+#include "pjsua.h"
+
+
+PJ_BEGIN_DECL
+
+#define PS_QUERY_TEXT_SIZE  128
+
+typedef struct ps_acc_entry {
+    pjsua_acc_id    id;
+    pj_bool_t       is_default;
+    pj_bool_t       has_registration;
+    pj_bool_t       online_status;
+    unsigned        expires;
+    int             status;
+    pj_status_t     reg_last_err;
+    char            uri[PJSIP_MAX_URL_SIZE];
+    char            status_text[PS_QUERY_TEXT_SIZE];
+    char            online_status_text[PS_QUERY_TEXT_SIZE];
+} ps_acc_entry;
+
+typedef struct ps_call_entry {
+    pjsua_call_id   id;
+    pjsua_acc_id    acc_id;
+    int             state;
+    int             media_status;
+    int             last_status;
+    unsigned        media_cnt;
+    pj_uint32_t     connect_msec;
+    pj_uint32_t     total_msec;
+    char            remote_info[PJSIP_MAX_URL_SIZE];
+    char            call_id[PS_QUERY_TEXT_SIZE];
+} ps_call_entry;
+
+typedef struct ps_stream_entry {
+    pjsua_call_id   call_id;
+    unsigned        med_idx;
+    int             type;
+    int             dir;
+    int             status;
+    pj_bool_t       has_stat;       /**< The counters below are valid */
+    pj_uint32_t     rx_pkt;
+    pj_uint32_t     rx_bytes;
+    pj_uint32_t     rx_loss;
+    pj_uint32_t     rx_jitter_usec; /**< Mean                         */
+    pj_uint32_t     tx_pkt;
+    pj_uint32_t     tx_bytes;
+} ps_stream_entry;
+
+/**
+ * Fill entries with every account.
+ *
+ * @param entries   The entries.
+ * @param count     On input the capacity of entries, on output the
+ *                  number of accounts filled in.
+ *
+ * @return          PJ_SUCCESS on success, PJ_ETOOSMALL with the number of
+ *                  accounts in count when they do not fit.
+ */
+pj_status_t ps_query_accounts(ps_acc_entry entries[], unsigned *count);
+
+/**
+ * Fill entries with every call, see ps_query_accounts().
+ */
+pj_status_t ps_query_calls(ps_call_entry entries[], unsigned *count);
+
+/**
+ * Fill entries with every media of every call, see ps_query_accounts().
+ */
+pj_status_t ps_query_streams(ps_stream_entry entries[], unsigned *count);
+
+PJ_END_DECL
+
+#endif	/* __PS_QUERY_H__ */
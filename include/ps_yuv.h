@@ -0,0 +1,66 @@
+/*
+ * Frame conversion for decoded pictures, backed by libyuv simd kernels.
+ * This is not a public API.
+ */
+
+#ifndef __PS_YUV_H__
+#define __PS_YUV_H__
+
+#include <pj/types.h>
+#include <libavutil/frame.h>
+
+
+PJ_BEGIN_DECL
+
+typedef enum ps_yuv_rgb_fmt {
+    PS_YUV_RGB24,       /**< r, g, b in memory order        */
+    PS_YUV_BGR24,       /**< b, g, r in memory order        */
+    PS_YUV_BGRA,        /**< b, g, r, a in memory order     */
+} ps_yuv_rgb_fmt;
+
+/**
+ * Check if the picture uses full (jpeg) range.
+ */
+pj_bool_t ps_yuv_is_full_range(const AVFrame *frame);
+
+/**
+ * Scale an i420 picture into dst. dst must be allocated with its target
+ * size. A limited range src is expanded to full range in dst without an
+ * extra pass over src when full_range is set.
+ */
+pj_status_t ps_yuv_scale(const AVFrame *src, AVFrame *dst, pj_bool_t full_range);
+
+/**
+ * Convert an i420 picture to packed rgb.
+ */
+pj_status_t ps_yuv_to_rgb(const AVFrame *src, pj_uint8_t *dst, int dst_stride,
+                          ps_yuv_rgb_fmt fmt);
+
+/**
+ * Scale an i420 picture to width x height and write it as planar r, g, b
+ * (one nchw tensor slot) to dst. Samples are bytes, or floats in 0 - 1
+ * when as_float is set. dst holds 3 * width * height samples.
+ */
+pj_status_t ps_yuv_to_planar_rgb(const AVFrame *src, int width, int height,
+                                 pj_bool_t as_float, void *dst);
+
+/**
+ * Make view a crop of the i420 picture src without copying, its planes
+ * point into the planes of src. x and y are rounded down to even, the
+ * region is clipped to the picture. Only data, linesize, size, format and
+ * range of view are set.
+ *
+ * @return          PJ_SUCCESS, or PJ_EINVAL for an empty region.
+ */
+pj_status_t ps_yuv_crop(const AVFrame *src, AVFrame *view,
+                        int x, int y, int width, int height);
+
+/**
+ * Expand a limited range i420 picture to full range in place, the frame is
+ * marked as yuvj420p afterwards. The frame buffers must be writable.
+ */
+pj_status_t ps_yuv_expand_range(AVFrame *frame);
+
+PJ_END_DECL
+
+#endif	/* __PS_YUV_H__ */
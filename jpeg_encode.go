@@ -0,0 +1,131 @@
+package gua
+
+/*
+#include <stdlib.h>
+#include "include/ps_jpeg.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"sync"
+	"unsafe"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// SnapshotEncoder selects how decoded pictures are turned into jpeg.
+type SnapshotEncoder int
+
+const (
+	// SnapshotEncoderMjpeg encodes through the ffmpeg mjpeg encoder.
+	SnapshotEncoderMjpeg SnapshotEncoder = iota
+	// SnapshotEncoderTurboJpeg feeds the i420 planes straight into the
+	// libjpeg-turbo raw data api, no codec context or packets involved.
+	SnapshotEncoderTurboJpeg
+)
+
+type JpegSubsampling int
+
+const (
+	JpegSubsampling420 JpegSubsampling = C.PS_JPEG_420
+	JpegSubsampling422 JpegSubsampling = C.PS_JPEG_422
+	JpegSubsampling444 JpegSubsampling = C.PS_JPEG_444
+)
+
+/****************************jpeg config*******************************/
+type jpegConfig struct {
+	quality  int
+	subsamp  JpegSubsampling
+	optimize bool
+}
+
+func NewJpegConfig() *jpegConfig {
+	return &jpegConfig{quality: 85, subsamp: JpegSubsampling420}
+}
+
+// SetQuality sets the jpeg quality, 1 (worst) to 100 (best).
+func (jc *jpegConfig) SetQuality(quality int) *jpegConfig {
+	if quality < 1 {
+		quality = 1
+	} else if quality > 100 {
+		quality = 100
+	}
+	jc.quality = quality
+	return jc
+}
+
+func (jc *jpegConfig) SetSubsampling(subsamp JpegSubsampling) *jpegConfig {
+	jc.subsamp = subsamp
+	return jc
+}
+
+// SetOptimizeHuffman builds optimal huffman tables per picture, which saves
+// a few percent of size for an extra pass over the coefficients.
+func (jc *jpegConfig) SetOptimizeHuffman(optimize bool) *jpegConfig {
+	jc.optimize = optimize
+	return jc
+}
+
+/****************************snapshot encoder*******************************/
+var (
+	snapshotEncoderMutex sync.RWMutex
+	snapshotEncoder      = SnapshotEncoderMjpeg
+	snapshotJpegConfig   = *NewJpegConfig()
+)
+
+// SetSnapshotEncoder selects the jpeg encoder of the Go decode path, jc may
+// be nil to keep the current config. Outputs with their own Quality keep it.
+func SetSnapshotEncoder(enc SnapshotEncoder, jc *jpegConfig) {
+	snapshotEncoderMutex.Lock()
+	defer snapshotEncoderMutex.Unlock()
+
+	snapshotEncoder = enc
+	if jc != nil {
+		snapshotJpegConfig = *jc
+	}
+}
+
+func currentSnapshotEncoder() (SnapshotEncoder, jpegConfig) {
+	snapshotEncoderMutex.RLock()
+	defer snapshotEncoderMutex.RUnlock()
+
+	return snapshotEncoder, snapshotJpegConfig
+}
+
+// mjpegQscale maps a 1 - 100 quality to the mjpeg qscale, 2 (best) to 31.
+func mjpegQscale(quality int) int {
+	return 2 + (100-quality)*29/99
+}
+
+// encodeTurboJpeg encodes a full range i420 frame with libjpeg-turbo.
+func encodeTurboJpeg(f *gmf.Frame, jc jpegConfig) ([]byte, error) {
+	return encodeTurboJpegAV(avFrame(f), jc)
+}
+
+func (jc jpegConfig) param() C.ps_jpeg_param {
+	var param C.ps_jpeg_param
+	C.ps_jpeg_param_default(&param)
+
+	param.quality = C.int(jc.quality)
+	param.subsamp = C.ps_jpeg_subsamp(jc.subsamp)
+	if jc.optimize {
+		param.optimize = C.PJ_TRUE
+	}
+
+	return param
+}
+
+func encodeTurboJpegAV(af *C.AVFrame, jc jpegConfig) ([]byte, error) {
+	param := jc.param()
+
+	var out *C.pj_uint8_t
+	var outLen C.ulong
+	if ret := C.ps_jpeg_encode(af, &param, &out, &outLen); ret != C.PJ_SUCCESS {
+		return nil, errors.New(fmt.Sprintf("jpeg encode error: %d", ret))
+	}
+	defer C.free(unsafe.Pointer(out))
+
+	return C.GoBytes(unsafe.Pointer(out), C.int(outLen)), nil
+}
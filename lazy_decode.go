@@ -0,0 +1,150 @@
+package gua
+
+import (
+	"errors"
+	"fmt"
+	"sync"
+)
+
+// lazyState keeps the latest i frame bitstream of a lazy stream and the
+// jpeg made from it, which stays valid until the next i frame.
+type lazyState struct {
+	mutex       sync.Mutex
+	job         *decodeJob
+	version     int
+	jpeg        []byte
+	jpegVersion int
+	// set by free, a detached state keeps no frame
+	closed bool
+}
+
+// SetStreamLazy stops decoding the i frames of a callee as they arrive.
+// The latest i frame, parameter sets included, is kept and only decoded
+// when GetSnapshot asks for it.
+func SetStreamLazy(calleeId string, lazy bool) {
+	ss := getStream(calleeId)
+
+	var detached *lazyState
+
+	ss.mutex.Lock()
+	if lazy && ss.lazy == nil {
+		ss.lazy = &lazyState{jpegVersion: -1}
+	} else if !lazy && ss.lazy != nil {
+		detached, ss.lazy = ss.lazy, nil
+	}
+	ss.mutex.Unlock()
+
+	// the lazy mutex is never taken under the stream mutex, GetSnapshot
+	// takes them the other way around
+	if detached != nil {
+		detached.free()
+	}
+}
+
+func (ls *lazyState) free() {
+	ls.mutex.Lock()
+	defer ls.mutex.Unlock()
+
+	ls.closed = true
+	if ls.job != nil {
+		ls.job.free()
+		ls.job = nil
+	}
+	ls.jpeg = nil
+}
+
+func (ss *streamState) lazyState() *lazyState {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	return ss.lazy
+}
+
+// keepLazyFrame replaces the kept i frame of a lazy stream, it returns
+// false when the stream is decoded eagerly.
+func keepLazyFrame(calleeId string, job *decodeJob) bool {
+	ls := getStream(calleeId).lazyState()
+	if ls == nil {
+		return false
+	}
+
+	ls.mutex.Lock()
+	defer ls.mutex.Unlock()
+
+	// SetStreamLazy(false) detached the state since it was read
+	if ls.closed {
+		return false
+	}
+
+	if ls.job != nil {
+		ls.job.free()
+	}
+	ls.job = job
+	ls.version++
+	ls.jpeg = nil
+
+	return true
+}
+
+// GetSnapshot returns the jpeg of the latest i frame of a lazy callee. The
+// frame is decoded and encoded on the first call after it arrived, later
+// calls get the same jpeg until the next i frame.
+func GetSnapshot(calleeId string) ([]byte, error) {
+	ss := getStream(calleeId)
+	ls := ss.lazyState()
+	if ls == nil {
+		return nil, errors.New(fmt.Sprintf("callee[%s] is not lazy", calleeId))
+	}
+
+	// read before the lazy mutex, the stream mutex is never taken under it
+	dp := ss.decodeParams()
+
+	data, width, height, err := ls.snapshot(calleeId, dp)
+	if err != nil {
+		return nil, err
+	}
+
+	if width > 0 {
+		ss.decoded(dp, width, height)
+		ss.setLastJpeg(data)
+	}
+
+	return data, nil
+}
+
+// snapshot returns the jpeg of the kept i frame, and the size of the
+// picture when it had to be decoded.
+func (ls *lazyState) snapshot(calleeId string, dp decodeParams) ([]byte, int, int, error) {
+	// concurrent requests wait for the one decoding
+	ls.mutex.Lock()
+	defer ls.mutex.Unlock()
+
+	if ls.closed {
+		return nil, 0, 0, errors.New(fmt.Sprintf("callee[%s] is not lazy", calleeId))
+	}
+	if ls.jpeg != nil && ls.jpegVersion == ls.version {
+		return ls.jpeg, 0, 0, nil
+	}
+	if ls.job == nil {
+		return nil, 0, 0, errors.New(fmt.Sprintf("callee[%s] has no i frame yet", calleeId))
+	}
+
+	frame, err := decodePicture(ls.job, dp)
+	if err != nil {
+		return nil, 0, 0, err
+	}
+	defer frame.Free()
+
+	if err = expandRange(frame); err != nil {
+		return nil, 0, 0, err
+	}
+
+	data, err := encodeSnapshot(frame)
+	if err != nil {
+		return nil, 0, 0, err
+	}
+
+	ls.jpeg, ls.jpegVersion = data, ls.version
+
+	return data, frame.Width(), frame.Height(), nil
+}
@@ -0,0 +1,86 @@
+package gua
+
+/*
+#include <stdlib.h>
+#include "include/ps_codecs.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"unsafe"
+)
+
+// SetStreamLive keeps a decoder of the callee fed with every frame, not
+// only i frames, so GetLatestSnapshot serves the current picture. Only
+// the latest picture is held and nothing is encoded until requested. The
+// decoder holds its threads of the decode thread budget while the stream
+// is live, it fails when the budget is exhausted.
+// Call it after GuaContext.Init.
+func SetStreamLive(calleeId string, live bool) error {
+	ss := getStream(calleeId)
+
+	cCalleeId := C.CString(calleeId)
+	defer C.free(unsafe.Pointer(cCalleeId))
+
+	if !live {
+		if ret := C.pjmedia_codec_ps_vid_set_live(cCalleeId, C.PJ_FALSE, nil); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Set stream live error: %d", ret))
+		}
+		ss.setLiveThreads(DecodeClassBackground, nil)
+		return nil
+	}
+
+	dp := ss.decodeParams()
+	dtc, ok := governor.tryAcquire(dp.class, dp.width, dp.height, true)
+	if !ok {
+		return errors.New(fmt.Sprintf("Set stream live error: callee[%s] decode thread budget exhausted", calleeId))
+	}
+
+	var param C.pjmedia_ps_live_param
+	param.threads = C.uint(dtc.threads)
+	if dtc.threadType == "frame" {
+		param.frame_threads = C.PJ_TRUE
+	}
+
+	if ret := C.pjmedia_codec_ps_vid_set_live(cCalleeId, C.PJ_TRUE, &param); ret != C.PJ_SUCCESS {
+		governor.release(dp.class, dtc)
+		return errors.New(fmt.Sprintf("Set stream live error: %d", ret))
+	}
+	ss.setLiveThreads(dp.class, dtc)
+
+	return nil
+}
+
+// setLiveThreads replaces the threads held by the live decoder of the
+// stream, the previous ones go back to the governor.
+func (ss *streamState) setLiveThreads(class DecodeClass, dtc *decodeThreadConfig) {
+	ss.mutex.Lock()
+	oldClass, old := ss.liveClass, ss.liveThreads
+	ss.liveClass, ss.liveThreads = class, dtc
+	ss.mutex.Unlock()
+
+	if old != nil {
+		governor.release(oldClass, old)
+	}
+}
+
+// GetLatestSnapshot encodes the latest decoded picture of a live callee
+// with the jpeg config of SetSnapshotEncoder.
+func GetLatestSnapshot(calleeId string) ([]byte, error) {
+	cCalleeId := C.CString(calleeId)
+	defer C.free(unsafe.Pointer(cCalleeId))
+
+	_, jc := currentSnapshotEncoder()
+	param := jc.param()
+
+	var jpeg *C.pj_uint8_t
+	var jpegLen C.ulong
+	if ret := C.pjmedia_codec_ps_vid_live_snapshot(cCalleeId, &param, &jpeg, &jpegLen); ret != C.PJ_SUCCESS {
+		return nil, errors.New(fmt.Sprintf("Get latest snapshot of callee[%s] error: %d", calleeId, ret))
+	}
+	defer C.free(unsafe.Pointer(jpeg))
+
+	return C.GoBytes(unsafe.Pointer(jpeg), C.int(jpegLen)), nil
+}
@@ -0,0 +1,115 @@
+package gua
+
+/*
+#include "include/ps_codecs.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"sync"
+	"unsafe"
+)
+
+// MotionConsumer receives the motion activity of one picture in interval
+// of every stream, on a decode worker thread. grid is only valid during
+// the call.
+type MotionConsumer interface {
+	OnMotion(calleeId string, grid []float32, gridW, gridH int, activity float32)
+}
+
+/****************************motion config*******************************/
+type motionConfig struct {
+	gridW         int
+	gridH         int
+	threshold     float32
+	gateSnapshots bool
+	interval      int
+}
+
+func NewMotionConfig() *motionConfig {
+	return &motionConfig{gridW: 16, gridH: 9, threshold: 1, interval: 5}
+}
+
+func (mc *motionConfig) SetGrid(gridW, gridH int) *motionConfig {
+	mc.gridW = gridW
+	mc.gridH = gridH
+	return mc
+}
+
+// SetThreshold sets the mean cell activity, in pixels of motion vector
+// length per pixel of cell, which counts as motion.
+func (mc *motionConfig) SetThreshold(threshold float32) *motionConfig {
+	mc.threshold = threshold
+	return mc
+}
+
+// SetGateSnapshots only decodes an i frame to a snapshot when motion was
+// seen since the previous snapshot of the stream.
+func (mc *motionConfig) SetGateSnapshots(gateSnapshots bool) *motionConfig {
+	mc.gateSnapshots = gateSnapshots
+	return mc
+}
+
+// SetInterval analyses one picture in interval, 1 analyses every picture.
+// Every frame is still decoded to follow the references.
+func (mc *motionConfig) SetInterval(interval int) *motionConfig {
+	if interval < 1 {
+		interval = 1
+	}
+	mc.interval = interval
+	return mc
+}
+
+var (
+	motionMutex    sync.RWMutex
+	motionConsumer MotionConsumer
+)
+
+// EnableMotionDetection tracks motion of all streams from the motion
+// vectors of their p frames, nil mc disables it. Call it after
+// GuaContext.Init.
+func EnableMotionDetection(mc *motionConfig, consumer MotionConsumer) error {
+	if mc == nil {
+		if ret := C.pjmedia_codec_ps_vid_set_motion(C.PJ_FALSE, nil); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("Disable motion detection error: %d", ret))
+		}
+		return nil
+	}
+
+	var param C.pjmedia_ps_motion_param
+	param.grid_w = C.uint(mc.gridW)
+	param.grid_h = C.uint(mc.gridH)
+	param.threshold = C.float(mc.threshold)
+	param.interval = C.uint(mc.interval)
+	if mc.gateSnapshots {
+		param.gate_snapshot = C.PJ_TRUE
+	}
+
+	motionMutex.Lock()
+	motionConsumer = consumer
+	motionMutex.Unlock()
+
+	if ret := C.pjmedia_codec_ps_vid_set_motion(C.PJ_TRUE, &param); ret != C.PJ_SUCCESS {
+		return errors.New(fmt.Sprintf("Enable motion detection error: %d", ret))
+	}
+
+	return nil
+}
+
+//export on_motion_cb
+func on_motion_cb(ps *C.ps_codec, grid *C.float, gridW, gridH C.uint, activity C.float) {
+	motionMutex.RLock()
+	mc := motionConsumer
+	motionMutex.RUnlock()
+
+	if mc == nil {
+		return
+	}
+
+	n := int(gridW * gridH)
+	cells := (*[1 << 12]float32)(unsafe.Pointer(grid))[:n:n]
+
+	mc.OnMotion(calleeIdOf(ps), cells, int(gridW), int(gridH), float32(activity))
+}
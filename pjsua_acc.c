@@ -36,6 +36,165 @@ static int get_ip_addr_ver(const pj_str_t *host);
 static void schedule_reregistration(pjsua_acc *acc);
 static void keep_alive_timer_cb(pj_timer_heap_t *th, pj_timer_entry *te);
 
+/* Hash of an account index key, case insensitive. The user part is empty
+ * for the domain index.
+ */
+static pj_uint32_t acc_index_hash(const pj_str_t *user,
+				  const pj_str_t *domain)
+{
+    pj_uint32_t hval = 0;
+    pj_ssize_t i;
+
+    for (i=0; i<user->slen; ++i)
+	hval = hval * 33 + pj_tolower(user->ptr[i]);
+    hval = hval * 33 + '@';
+    for (i=0; i<domain->slen; ++i)
+	hval = hval * 33 + pj_tolower(domain->ptr[i]);
+
+    return hval;
+}
+
+static pjsua_acc_id *acc_index_bucket(pjsua_acc_index_type type,
+				      pj_uint32_t hash)
+{
+    return &pjsua_var.acc_index[type][hash & (PJSUA_ACC_INDEX_SIZE - 1)];
+}
+
+/* Link the account in the indexes after the accounts of the same or a
+ * higher priority, so the buckets keep the order of acc_ids.
+ */
+static void acc_index_add(pjsua_acc *acc)
+{
+    const pj_str_t no_user = { "", 0 };
+    unsigned t;
+
+    if (acc->indexed)
+	return;
+
+    acc->link[PJSUA_ACC_INDEX_URI].hash =
+	acc_index_hash(&acc->user_part, &acc->srv_domain);
+    acc->link[PJSUA_ACC_INDEX_DOMAIN].hash =
+	acc_index_hash(&no_user, &acc->srv_domain);
+
+    for (t=0; t<PJSUA_ACC_INDEX_CNT; ++t) {
+	pjsua_acc_id *p = acc_index_bucket(t, acc->link[t].hash);
+
+	while (*p != PJSUA_INVALID_ID &&
+	       PJSUA_ACC(*p).cfg.priority >= acc->cfg.priority)
+	{
+	    p = &PJSUA_ACC(*p).link[t].next;
+	}
+	acc->link[t].next = *p;
+	*p = acc->index;
+    }
+
+    acc->indexed = PJ_TRUE;
+}
+
+static void acc_index_remove(pjsua_acc *acc)
+{
+    unsigned t;
+
+    if (!acc->indexed)
+	return;
+
+    for (t=0; t<PJSUA_ACC_INDEX_CNT; ++t) {
+	pjsua_acc_id *p = acc_index_bucket(t, acc->link[t].hash);
+
+	while (*p != PJSUA_INVALID_ID && *p != acc->index)
+	    p = &PJSUA_ACC(*p).link[t].next;
+	pj_assert(*p == acc->index);
+	if (*p == acc->index)
+	    *p = acc->link[t].next;
+    }
+
+    acc->indexed = PJ_FALSE;
+}
+
+/* The first account, in priority order, of the user and domain which
+ * takes the transport. No account scores more for an incoming request.
+ */
+static pjsua_acc_id acc_index_find_uri(const pjsip_sip_uri *sip_uri,
+				       int tp_type)
+{
+    pj_uint32_t hash = acc_index_hash(&sip_uri->user, &sip_uri->host);
+    pjsua_acc_id id = *acc_index_bucket(PJSUA_ACC_INDEX_URI, hash);
+
+    for (; id != PJSUA_INVALID_ID;
+	 id = PJSUA_ACC(id).link[PJSUA_ACC_INDEX_URI].next)
+    {
+	pjsua_acc *acc = &PJSUA_ACC(id);
+
+	if (acc->link[PJSUA_ACC_INDEX_URI].hash != hash || !acc->valid)
+	    continue;
+
+	if ((acc->tp_type == tp_type ||
+	     acc->tp_type == PJSIP_TRANSPORT_UNSPECIFIED) &&
+	    pj_stricmp(&acc->srv_domain, &sip_uri->host)==0 &&
+	    pj_stricmp(&acc->user_part, &sip_uri->user)==0)
+	{
+	    return id;
+	}
+    }
+
+    return PJSUA_INVALID_ID;
+}
+
+/* The first account, in priority order, of the domain and port, else of
+ * the domain only.
+ */
+static pjsua_acc_id acc_index_find_domain(const pj_str_t *domain, int port)
+{
+    const pj_str_t no_user = { "", 0 };
+    pj_uint32_t hash = acc_index_hash(&no_user, domain);
+    pjsua_acc_id id = *acc_index_bucket(PJSUA_ACC_INDEX_DOMAIN, hash);
+    pjsua_acc_id found = PJSUA_INVALID_ID;
+
+    for (; id != PJSUA_INVALID_ID;
+	 id = PJSUA_ACC(id).link[PJSUA_ACC_INDEX_DOMAIN].next)
+    {
+	pjsua_acc *acc = &PJSUA_ACC(id);
+
+	if (acc->link[PJSUA_ACC_INDEX_DOMAIN].hash != hash || !acc->valid ||
+	    pj_stricmp(&acc->srv_domain, domain) != 0)
+	{
+	    continue;
+	}
+
+	if (acc->srv_port == port)
+	    return id;
+	if (found == PJSUA_INVALID_ID)
+	    found = id;
+    }
+
+    return found;
+}
+
+/*
+ * Add one segment to the account table.
+ */
+pj_status_t pjsua_acc_grow_table(void)
+{
+    unsigned seg = pjsua_var.acc_slots / PJSUA_ACC_SEG_SIZE;
+    unsigned i;
+
+    if (seg >= PJ_ARRAY_SIZE(pjsua_var.acc_seg))
+	return PJ_ETOOMANY;
+
+    pjsua_var.acc_seg[seg] = (pjsua_acc*)
+			     pj_pool_calloc(pjsua_var.pool,
+					    PJSUA_ACC_SEG_SIZE,
+					    sizeof(pjsua_acc));
+    if (pjsua_var.acc_seg[seg] == NULL)
+	return PJ_ENOMEM;
+
+    for (i=0; i<PJSUA_ACC_SEG_SIZE; ++i)
+	PJSUA_ACC(pjsua_var.acc_slots + i).index = pjsua_var.acc_slots + i;
+    pjsua_var.acc_slots += PJSUA_ACC_SEG_SIZE;
+
+    return PJ_SUCCESS;
+}
+
 /*
  * Get number of current accounts.
  */
@@ -50,8 +209,8 @@ PJ_DEF(unsigned) pjsua_acc_get_count(void)
  */
 PJ_DEF(pj_bool_t) pjsua_acc_is_valid(pjsua_acc_id acc_id)
 {
-    return acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc) &&
-	   pjsua_var.acc[acc_id].valid;
+    return acc_id>=0 && acc_id<(int)pjsua_var.acc_slots &&
+	   PJSUA_ACC(acc_id).valid;
 }
 
 
@@ -221,8 +380,8 @@ static void init_outbound_setting(pjsua_acc *acc)
  */
 static pj_status_t initialize_acc(unsigned acc_id)
 {
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(acc_id).cfg;
+    pjsua_acc *acc = &PJSUA_ACC(acc_id);
     pjsip_name_addr *name_addr;
     pjsip_sip_uri *sip_reg_uri;
     pj_status_t status;
@@ -398,18 +557,19 @@ static pj_status_t initialize_acc(unsigned acc_id)
     }
 
     /* Mark account as valid */
-    pjsua_var.acc[acc_id].valid = PJ_TRUE;
+    PJSUA_ACC(acc_id).valid = PJ_TRUE;
 
     /* Insert account ID into account ID array, sorted by priority */
     for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	if ( pjsua_var.acc[pjsua_var.acc_ids[i]].cfg.priority <
-	     pjsua_var.acc[acc_id].cfg.priority)
+	if ( PJSUA_ACC(pjsua_var.acc_ids[i]).cfg.priority <
+	     PJSUA_ACC(acc_id).cfg.priority)
 	{
 	    break;
 	}
     }
     pj_array_insert(pjsua_var.acc_ids, sizeof(pjsua_var.acc_ids[0]),
 		    pjsua_var.acc_cnt, i, &acc_id);
+    acc_index_add(acc);
 
     if (acc_cfg->transport_id != PJSUA_INVALID_ID)
 	acc->tp_type = pjsua_var.tpdata[acc_cfg->transport_id].type;
@@ -432,8 +592,7 @@ PJ_DEF(pj_status_t) pjsua_acc_add(pjsua_acc_config *cfg,
     pj_status_t status = PJ_SUCCESS;
 
     PJ_ASSERT_RETURN(cfg, PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc_cnt < PJ_ARRAY_SIZE(pjsua_var.acc),
-		     PJ_ETOOMANY);
+    PJ_ASSERT_RETURN(pjsua_var.acc_cnt < PJSUA_MAX_ACC, PJ_ETOOMANY);
 
     /* Must have a transport */
     PJ_ASSERT_RETURN(pjsua_var.tpdata[0].data.ptr != NULL, PJ_EINVALIDOP);
@@ -444,17 +603,25 @@ PJ_DEF(pj_status_t) pjsua_acc_add(pjsua_acc_config *cfg,
 
     PJSUA_LOCK();
 
-    /* Find empty account id. */
-    for (id=0; id < PJ_ARRAY_SIZE(pjsua_var.acc); ++id) {
-	if (pjsua_var.acc[id].valid == PJ_FALSE)
+    /* Find empty account id, the table grows when it is full. */
+    for (id=0; id < pjsua_var.acc_slots; ++id) {
+	if (PJSUA_ACC(id).valid == PJ_FALSE)
 	    break;
     }
+    if (id == pjsua_var.acc_slots) {
+	status = pjsua_acc_grow_table();
+	if (status != PJ_SUCCESS) {
+	    PJSUA_UNLOCK();
+	    pj_log_pop_indent();
+	    return status;
+	}
+    }
 
     /* Expect to find a slot */
-    PJ_ASSERT_ON_FAIL(	id < PJ_ARRAY_SIZE(pjsua_var.acc), 
+    PJ_ASSERT_ON_FAIL(	id < pjsua_var.acc_slots, 
 			{PJSUA_UNLOCK(); return PJ_EBUG;});
 
-    acc = &pjsua_var.acc[id];
+    acc = &PJSUA_ACC(id);
 
     /* Create pool for this account. */
     if (acc->pool)
@@ -463,15 +630,15 @@ PJ_DEF(pj_status_t) pjsua_acc_add(pjsua_acc_config *cfg,
 	acc->pool = pjsua_pool_create("acc%p", 512, 256);
 
     /* Copy config */
-    pjsua_acc_config_dup(acc->pool, &pjsua_var.acc[id].cfg, cfg);
+    pjsua_acc_config_dup(acc->pool, &PJSUA_ACC(id).cfg, cfg);
     
     /* Normalize registration timeout and refresh delay */
-    if (pjsua_var.acc[id].cfg.reg_uri.slen) {
-        if (pjsua_var.acc[id].cfg.reg_timeout == 0) {
-            pjsua_var.acc[id].cfg.reg_timeout = PJSUA_REG_INTERVAL;
+    if (PJSUA_ACC(id).cfg.reg_uri.slen) {
+        if (PJSUA_ACC(id).cfg.reg_timeout == 0) {
+            PJSUA_ACC(id).cfg.reg_timeout = PJSUA_REG_INTERVAL;
         }
-        if (pjsua_var.acc[id].cfg.reg_delay_before_refresh == 0) {
-            pjsua_var.acc[id].cfg.reg_delay_before_refresh =
+        if (PJSUA_ACC(id).cfg.reg_delay_before_refresh == 0) {
+            PJSUA_ACC(id).cfg.reg_delay_before_refresh =
                 PJSIP_REGISTER_CLIENT_DELAY_BEFORE_REFRESH;
         }
     }
@@ -517,12 +684,12 @@ PJ_DEF(pj_status_t) pjsua_acc_add(pjsua_acc_config *cfg,
 	      (int)cfg->id.slen, cfg->id.ptr, id));
 
     /* If accounts has registration enabled, start registration */
-    if (pjsua_var.acc[id].cfg.reg_uri.slen) {
-	if (pjsua_var.acc[id].cfg.register_on_acc_add)
+    if (PJSUA_ACC(id).cfg.reg_uri.slen) {
+	if (PJSUA_ACC(id).cfg.register_on_acc_add)
             pjsua_acc_set_registration(id, PJ_TRUE);
     } else {
 	/* Otherwise subscribe to MWI, if it's enabled */
-	if (pjsua_var.acc[id].cfg.mwi_enabled)
+	if (PJSUA_ACC(id).cfg.mwi_enabled)
 	    pjsua_start_mwi(id, PJ_TRUE);
 
 	/* Start publish too */
@@ -583,7 +750,7 @@ PJ_DEF(pj_status_t) pjsua_acc_add_local( pjsua_transport_id tid,
     
     status = pjsua_acc_add(&cfg, is_default, &acc_id);
     if (status == PJ_SUCCESS) {
-	pjsua_var.acc[acc_id].tp_type = t->type;
+	PJSUA_ACC(acc_id).tp_type = t->type;
 	if (p_acc_id)
 	    *p_acc_id = acc_id;
     }
@@ -598,13 +765,13 @@ PJ_DEF(pj_status_t) pjsua_acc_add_local( pjsua_transport_id tid,
 PJ_DEF(pj_status_t) pjsua_acc_set_user_data(pjsua_acc_id acc_id,
 					    void *user_data)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, PJ_EINVALIDOP);
 
     PJSUA_LOCK();
 
-    pjsua_var.acc[acc_id].cfg.user_data = user_data;
+    PJSUA_ACC(acc_id).cfg.user_data = user_data;
 
     PJSUA_UNLOCK();
 
@@ -617,11 +784,11 @@ PJ_DEF(pj_status_t) pjsua_acc_set_user_data(pjsua_acc_id acc_id,
  */
 PJ_DEF(void*) pjsua_acc_get_user_data(pjsua_acc_id acc_id)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     NULL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, NULL);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, NULL);
 
-    return pjsua_var.acc[acc_id].cfg.user_data;
+    return PJSUA_ACC(acc_id).cfg.user_data;
 }
 
 
@@ -633,16 +800,16 @@ PJ_DEF(pj_status_t) pjsua_acc_del(pjsua_acc_id acc_id)
     pjsua_acc *acc;
     unsigned i;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Deleting account %d..", acc_id));
     pj_log_push_indent();
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     /* Cancel keep-alive timer, if any */
     if (acc->ka_timer.id) {
@@ -685,6 +852,7 @@ PJ_DEF(pj_status_t) pjsua_acc_del(pjsua_acc_id acc_id)
     }
 
     /* Invalidate */
+    acc_index_remove(acc);
     acc->valid = PJ_FALSE;
     acc->contact.slen = 0;
     acc->reg_mapped_addr.slen = 0;
@@ -731,11 +899,11 @@ PJ_DEF(pj_status_t) pjsua_acc_get_config(pjsua_acc_id acc_id,
                                          pj_pool_t *pool,
                                          pjsua_acc_config *acc_cfg)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc)
-                     && pjsua_var.acc[acc_id].valid, PJ_EINVAL);
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots
+                     && PJSUA_ACC(acc_id).valid, PJ_EINVAL);
     //this now would not work due to corrupt header list
-    //pj_memcpy(acc_cfg, &pjsua_var.acc[acc_id].cfg, sizeof(*acc_cfg));
-    pjsua_acc_config_dup(pool, acc_cfg, &pjsua_var.acc[acc_id].cfg);
+    //pj_memcpy(acc_cfg, &PJSUA_ACC(acc_id).cfg, sizeof(*acc_cfg));
+    pjsua_acc_config_dup(pool, acc_cfg, &PJSUA_ACC(acc_id).cfg);
     return PJ_SUCCESS;
 }
 
@@ -821,7 +989,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
     pj_bool_t update_mwi = PJ_FALSE;
     pj_status_t status = PJ_SUCCESS;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Modifying account %d", acc_id));
@@ -829,7 +997,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
     if (!acc->valid) {
 	status = PJ_EINVAL;
 	goto on_return;
@@ -949,12 +1117,14 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 
     /* Account ID. */
     if (id_name_addr && id_sip_uri) {
+	acc_index_remove(acc);
 	pj_strdup_with_null(acc->pool, &acc->cfg.id, &cfg->id);
 	pj_strdup_with_null(acc->pool, &acc->display, &id_name_addr->display);
 	pj_strdup_with_null(acc->pool, &acc->user_part, &id_sip_uri->user);
 	pj_strdup_with_null(acc->pool, &acc->srv_domain, &id_sip_uri->host);
 	acc->srv_port = 0;
 	acc->is_sips = PJSIP_URI_SCHEME_IS_SIPS(id_name_addr);
+	acc_index_add(acc);
 	update_reg = PJ_TRUE;
 	unreg_first = PJ_TRUE;
     }
@@ -966,6 +1136,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
     if (acc->cfg.priority != cfg->priority) {
 	unsigned i;
 
+	acc_index_remove(acc);
 	acc->cfg.priority = cfg->priority;
 	
 	/* Resort accounts priority */
@@ -977,7 +1148,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 	pj_array_erase(pjsua_var.acc_ids, sizeof(acc_id),
 		       pjsua_var.acc_cnt, i);
 	for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	    if (pjsua_var.acc[pjsua_var.acc_ids[i]].cfg.priority <
+	    if (PJSUA_ACC(pjsua_var.acc_ids[i]).cfg.priority <
 		acc->cfg.priority)
 	    {
 		break;
@@ -985,6 +1156,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 	}
 	pj_array_insert(pjsua_var.acc_ids, sizeof(acc_id),
 			pjsua_var.acc_cnt, i, &acc_id);
+	acc_index_add(acc);
     }
 
     /* MWI */
@@ -1483,16 +1655,16 @@ on_return:
 PJ_DEF(pj_status_t) pjsua_acc_set_online_status( pjsua_acc_id acc_id,
 						 pj_bool_t is_online)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: setting online status to %d..",
 	      acc_id, is_online));
     pj_log_push_indent();
 
-    pjsua_var.acc[acc_id].online_status = is_online;
-    pj_bzero(&pjsua_var.acc[acc_id].rpid, sizeof(pjrpid_element));
+    PJSUA_ACC(acc_id).online_status = is_online;
+    pj_bzero(&PJSUA_ACC(acc_id).rpid, sizeof(pjrpid_element));
     pjsua_pres_update_acc(acc_id, PJ_FALSE);
 
     pj_log_pop_indent();
@@ -1507,17 +1679,17 @@ PJ_DEF(pj_status_t) pjsua_acc_set_online_status2( pjsua_acc_id acc_id,
 						  pj_bool_t is_online,
 						  const pjrpid_element *pr)
 {
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: setting online status to %d..",
     	      acc_id, is_online));
     pj_log_push_indent();
 
     PJSUA_LOCK();
-    pjsua_var.acc[acc_id].online_status = is_online;
-    pjrpid_element_dup(pjsua_var.acc[acc_id].pool, &pjsua_var.acc[acc_id].rpid, pr);
+    PJSUA_ACC(acc_id).online_status = is_online;
+    pjrpid_element_dup(PJSUA_ACC(acc_id).pool, &PJSUA_ACC(acc_id).rpid, pr);
     PJSUA_UNLOCK();
 
     pjsua_pres_update_acc(acc_id, PJ_TRUE);
@@ -2332,7 +2504,7 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
 	    update_keep_alive(acc, PJ_FALSE, NULL);
 
 	    PJ_LOG(3,(THIS_FILE, "%s: unregistration success",
-		      pjsua_var.acc[acc->index].cfg.id.ptr));
+		      PJSUA_ACC(acc->index).cfg.id.ptr));
 
 	} else {	    
 	    /* Check and update SIP outbound status first, since the result
@@ -2359,7 +2531,7 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
 	    PJ_LOG(3, (THIS_FILE, 
 		       "%s: registration success, status=%d (%.*s), "
 		       "will re-register in %d seconds", 
-		       pjsua_var.acc[acc->index].cfg.id.ptr,
+		       PJSUA_ACC(acc->index).cfg.id.ptr,
 		       param->code,
 		       (int)param->reason.slen, param->reason.ptr,
 		       param->expiration));
@@ -2439,8 +2611,8 @@ static void regc_cb(struct pjsip_regc_cbparam *param)
 		pj_status_t status;
 		/* Send re-register. */
 		PJ_LOG(3, (THIS_FILE, "%.*s: send registration triggered by IP"
-			   " change", pjsua_var.acc[acc->index].cfg.id.slen,
-			   pjsua_var.acc[acc->index].cfg.id.ptr));
+			   " change", PJSUA_ACC(acc->index).cfg.id.slen,
+			   PJSUA_ACC(acc->index).cfg.id.ptr));
 
 		status = pjsua_acc_set_registration(acc->index, PJ_TRUE);
 		if ((status != PJ_SUCCESS) &&
@@ -2483,7 +2655,7 @@ static pj_status_t pjsua_regc_init(int acc_id)
     pj_status_t status;
 
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     if (acc->cfg.reg_uri.slen == 0) {
 	PJ_LOG(3,(THIS_FILE, "Registrar URI is not specified"));
@@ -2556,10 +2728,10 @@ static pj_status_t pjsua_regc_init(int acc_id)
     /* If account is locked to specific transport, then set transport to
      * the client registration.
      */
-    if (pjsua_var.acc[acc_id].cfg.transport_id != PJSUA_INVALID_ID) {
+    if (PJSUA_ACC(acc_id).cfg.transport_id != PJSUA_INVALID_ID) {
 	pjsip_tpselector tp_sel;
 
-	pjsua_init_tpselector(pjsua_var.acc[acc_id].cfg.transport_id, &tp_sel);
+	pjsua_init_tpselector(PJSUA_ACC(acc_id).cfg.transport_id, &tp_sel);
 	pjsip_regc_set_transport(acc->regc, &tp_sel);
     }
 
@@ -2654,14 +2826,14 @@ static pj_status_t pjsua_regc_init(int acc_id)
 
 pj_bool_t pjsua_sip_acc_is_using_ipv6(pjsua_acc_id acc_id)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(acc_id);
 
     return (acc->tp_type & PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_IPV6;
 }
 
 pj_bool_t pjsua_sip_acc_is_using_stun(pjsua_acc_id acc_id)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(acc_id);
 
     return acc->cfg.sip_stun_use != PJSUA_STUN_USE_DISABLED &&
 	   pjsua_var.ua_cfg.stun_srv_cnt != 0;
@@ -2669,7 +2841,7 @@ pj_bool_t pjsua_sip_acc_is_using_stun(pjsua_acc_id acc_id)
 
 pj_bool_t pjsua_media_acc_is_using_stun(pjsua_acc_id acc_id)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(acc_id);
 
     return acc->cfg.media_stun_use != PJSUA_STUN_USE_DISABLED &&
 	   pjsua_var.ua_cfg.stun_srv_cnt != 0;
@@ -2685,9 +2857,9 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
     pj_status_t status = 0;
     pjsip_tx_data *tdata = 0;
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, PJ_EINVALIDOP);
 
     PJ_LOG(4,(THIS_FILE, "Acc %d: setting %sregistration..",
 	      acc_id, (renew? "" : "un")));
@@ -2695,12 +2867,12 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     /* Cancel any re-registration timer */
-    if (pjsua_var.acc[acc_id].auto_rereg.timer.id) {
-	pjsua_var.acc[acc_id].auto_rereg.timer.id = PJ_FALSE;
-	pjsua_cancel_timer(&pjsua_var.acc[acc_id].auto_rereg.timer);
+    if (PJSUA_ACC(acc_id).auto_rereg.timer.id) {
+	PJSUA_ACC(acc_id).auto_rereg.timer.id = PJ_FALSE;
+	pjsua_cancel_timer(&PJSUA_ACC(acc_id).auto_rereg.timer);
     }
 
     /* Reset pointer to registration transport */
@@ -2708,10 +2880,10 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
     // on progress, this registration will fail but transport pointer will
     // become NULL which will prevent transport to be destroyed immediately
     // after disconnected (which may cause iOS app getting killed (see #1482).
-    //pjsua_var.acc[acc_id].auto_rereg.reg_tp = NULL;
+    //PJSUA_ACC(acc_id).auto_rereg.reg_tp = NULL;
 
     if (renew) {
-	if (pjsua_var.acc[acc_id].regc == NULL) {
+	if (PJSUA_ACC(acc_id).regc == NULL) {
 	    status = pjsua_regc_init(acc_id);
 	    if (status != PJ_SUCCESS) {
 		pjsua_perror(THIS_FILE, "Unable to create registration", 
@@ -2719,15 +2891,15 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 		goto on_return;
 	    }
 	}
-	if (!pjsua_var.acc[acc_id].regc) {
+	if (!PJSUA_ACC(acc_id).regc) {
 	    status = PJ_EINVALIDOP;
 	    goto on_return;
 	}
 
-	status = pjsip_regc_register(pjsua_var.acc[acc_id].regc, 1, 
+	status = pjsip_regc_register(PJSUA_ACC(acc_id).regc, 1, 
 				     &tdata);
 
-	if (0 && status == PJ_SUCCESS && pjsua_var.acc[acc_id].cred_cnt) {
+	if (0 && status == PJ_SUCCESS && PJSUA_ACC(acc_id).cred_cnt) {
 	    pjsip_authorization_hdr *h;
 	    char *uri;
 	    int d;
@@ -2749,26 +2921,26 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 	}
 
     } else {
-	if (pjsua_var.acc[acc_id].regc == NULL) {
+	if (PJSUA_ACC(acc_id).regc == NULL) {
 	    PJ_LOG(3,(THIS_FILE, "Currently not registered"));
 	    status = PJ_EINVALIDOP;
 	    goto on_return;
 	}
 
-	pjsua_pres_unpublish(&pjsua_var.acc[acc_id], 0);
+	pjsua_pres_unpublish(&PJSUA_ACC(acc_id), 0);
 
-	status = pjsip_regc_unregister(pjsua_var.acc[acc_id].regc, &tdata);
+	status = pjsip_regc_unregister(PJSUA_ACC(acc_id).regc, &tdata);
     }
 
     if (status == PJ_SUCCESS) {
-        pjsip_regc *regc = pjsua_var.acc[acc_id].regc;
+        pjsip_regc *regc = PJSUA_ACC(acc_id).regc;
 
-        if (pjsua_var.acc[acc_id].cfg.allow_via_rewrite &&
-            pjsua_var.acc[acc_id].via_addr.host.slen > 0)
+        if (PJSUA_ACC(acc_id).cfg.allow_via_rewrite &&
+            PJSUA_ACC(acc_id).via_addr.host.slen > 0)
         {
-            pjsip_regc_set_via_sent_by(pjsua_var.acc[acc_id].regc,
-                                       &pjsua_var.acc[acc_id].via_addr,
-                                       pjsua_var.acc[acc_id].via_tp);
+            pjsip_regc_set_via_sent_by(PJSUA_ACC(acc_id).regc,
+                                       &PJSUA_ACC(acc_id).via_addr,
+                                       PJSUA_ACC(acc_id).via_tp);
         } else if (!pjsua_sip_acc_is_using_stun(acc_id)) {
             /* Choose local interface to use in Via if acc is not using
              * STUN
@@ -2805,8 +2977,8 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
          */
 	//pjsip_regc_info reg_info;
 
-	//pjsip_regc_get_info(pjsua_var.acc[acc_id].regc, &reg_info);
-	//pjsua_var.acc[acc_id].auto_rereg.reg_tp = reg_info.transport;
+	//pjsip_regc_get_info(PJSUA_ACC(acc_id).regc, &reg_info);
+	//PJSUA_ACC(acc_id).auto_rereg.reg_tp = reg_info.transport;
 
         if (pjsua_var.ua_cfg.cb.on_reg_started) {
             (*pjsua_var.ua_cfg.cb.on_reg_started)(acc_id, renew);
@@ -2815,7 +2987,7 @@ PJ_DEF(pj_status_t) pjsua_acc_set_registration( pjsua_acc_id acc_id,
 	    pjsua_reg_info rinfo;
 
 	    rinfo.cbparam = NULL;
-	    rinfo.regc = pjsua_var.acc[acc_id].regc;
+	    rinfo.regc = PJSUA_ACC(acc_id).regc;
 	    rinfo.renew = renew;
             (*pjsua_var.ua_cfg.cb.on_reg_started2)(acc_id, &rinfo);
         }
@@ -2842,21 +3014,24 @@ on_return:
 PJ_DEF(pj_status_t) pjsua_acc_get_info( pjsua_acc_id acc_id,
 					pjsua_acc_info *info)
 {
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[acc_id].cfg;
+    pjsua_acc *acc;
+    pjsua_acc_config *acc_cfg;
 
     PJ_ASSERT_RETURN(info != NULL, PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
+
+    acc = &PJSUA_ACC(acc_id);
+    acc_cfg = &acc->cfg;
     
     pj_bzero(info, sizeof(pjsua_acc_info));
 
-    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc), 
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots, 
 		     PJ_EINVAL);
-    PJ_ASSERT_RETURN(pjsua_var.acc[acc_id].valid, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(PJSUA_ACC(acc_id).valid, PJ_EINVALIDOP);
 
     PJSUA_LOCK();
     
-    if (pjsua_var.acc[acc_id].valid == PJ_FALSE) {
+    if (PJSUA_ACC(acc_id).valid == PJ_FALSE) {
 	PJSUA_UNLOCK();
 	return PJ_EINVALIDOP;
     }
@@ -2919,8 +3094,8 @@ PJ_DEF(pj_status_t) pjsua_enum_accs(pjsua_acc_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	if (!pjsua_var.acc[i].valid)
+    for (i=0, c=0; c<*count && i<pjsua_var.acc_slots; ++i) {
+	if (!PJSUA_ACC(i).valid)
 	    continue;
 	ids[c] = i;
 	++c;
@@ -2946,8 +3121,8 @@ PJ_DEF(pj_status_t) pjsua_acc_enum_info( pjsua_acc_info info[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	if (!pjsua_var.acc[i].valid)
+    for (i=0, c=0; c<*count && i<pjsua_var.acc_slots; ++i) {
+	if (!PJSUA_ACC(i).valid)
 	    continue;
 
 	pjsua_acc_get_info(i, &info[c]);
@@ -2972,6 +3147,7 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
     pjsip_uri *uri;
     pjsip_sip_uri *sip_uri;
     pj_pool_t *tmp_pool;
+    pjsua_acc_id acc_id;
     unsigned i;
 
     PJSUA_LOCK();
@@ -2991,14 +3167,14 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
 	!PJSIP_URI_SCHEME_IS_SIPS(uri)) 
     {
 	/* Return the first account with proxy */
-	for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<pjsua_var.acc_slots; ++i) {
+	    if (!PJSUA_ACC(i).valid)
 		continue;
-	    if (!pj_list_empty(&pjsua_var.acc[i].route_set))
+	    if (!pj_list_empty(&PJSUA_ACC(i).route_set))
 		break;
 	}
 
-	if (i != PJ_ARRAY_SIZE(pjsua_var.acc)) {
+	if (i != pjsua_var.acc_slots) {
 	    /* Found rather matching account */
 	    pj_pool_release(tmp_pool);
 	    PJSUA_UNLOCK();
@@ -3013,27 +3189,14 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_outgoing(const pj_str_t *url)
 
     sip_uri = (pjsip_sip_uri*) pjsip_uri_get_uri(uri);
 
-    /* Find matching domain AND port */
-    for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	if (pj_stricmp(&pjsua_var.acc[acc_id].srv_domain, &sip_uri->host)==0 &&
-	    pjsua_var.acc[acc_id].srv_port == sip_uri->port)
-	{
-	    pj_pool_release(tmp_pool);
-	    PJSUA_UNLOCK();
-	    return acc_id;
-	}
-    }
-
-    /* If no match, try to match the domain part only */
-    for (i=0; i<pjsua_var.acc_cnt; ++i) {
-	unsigned acc_id = pjsua_var.acc_ids[i];
-	if (pj_stricmp(&pjsua_var.acc[acc_id].srv_domain, &sip_uri->host)==0)
-	{
-	    pj_pool_release(tmp_pool);
-	    PJSUA_UNLOCK();
-	    return acc_id;
-	}
+    /* Find matching domain AND port, if no match, try to match the
+     * domain part only
+     */
+    acc_id = acc_index_find_domain(&sip_uri->host, sip_uri->port);
+    if (acc_id != PJSUA_INVALID_ID) {
+	pj_pool_release(tmp_pool);
+	PJSUA_UNLOCK();
+	return acc_id;
     }
 
 
@@ -3086,6 +3249,13 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_incoming(pjsip_rx_data *rdata)
 
     sip_uri = (pjsip_sip_uri*)pjsip_uri_get_uri(uri);
 
+    /* An account of the user and domain taking the transport has the
+     * best score, the index finds it without walking the accounts.
+     */
+    id = acc_index_find_uri(sip_uri, rdata->tp_info.transport->key.type);
+    if (id != PJSUA_INVALID_ID)
+	goto on_return;
+
     /* Select account by weighted score. Matching priority order is:
      * transport type (matched or not set), domain part, and user part.
      * Note that the transport type has higher priority as unmatched
@@ -3094,7 +3264,7 @@ PJ_DEF(pjsua_acc_id) pjsua_acc_find_for_incoming(pjsip_rx_data *rdata)
     max_score = 0;
     for (i=0; i < pjsua_var.acc_cnt; ++i) {
 	unsigned acc_id = pjsua_var.acc_ids[i];
-	pjsua_acc *acc = &pjsua_var.acc[acc_id];
+	pjsua_acc *acc = &PJSUA_ACC(acc_id);
 	int score = 0;
 
 	if (!acc->valid)
@@ -3158,7 +3328,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_request(pjsua_acc_id acc_id,
     PJ_ASSERT_RETURN(method && target && p_tdata, PJ_EINVAL);
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     status = pjsip_endpt_create_request(pjsua_var.endpt, method, target, 
 					&acc->cfg.id, target,
@@ -3179,7 +3349,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_request(pjsua_acc_id acc_id,
     /* If account is locked to specific transport, then set that transport to
      * the transmit data.
      */
-    if (pjsua_var.acc[acc_id].cfg.transport_id != PJSUA_INVALID_ID) {
+    if (PJSUA_ACC(acc_id).cfg.transport_id != PJSUA_INVALID_ID) {
 	pjsip_tpselector tp_sel;
 
 	pjsua_init_tpselector(acc->cfg.transport_id, &tp_sel);
@@ -3187,11 +3357,11 @@ PJ_DEF(pj_status_t) pjsua_acc_create_request(pjsua_acc_id acc_id,
     }
 
     /* If via_addr is set, use this address for the Via header. */
-    if (pjsua_var.acc[acc_id].cfg.allow_via_rewrite &&
-        pjsua_var.acc[acc_id].via_addr.host.slen > 0)
+    if (PJSUA_ACC(acc_id).cfg.allow_via_rewrite &&
+        PJSUA_ACC(acc_id).via_addr.host.slen > 0)
     {
-        tdata->via_addr = pjsua_var.acc[acc_id].via_addr;
-        tdata->via_tp = pjsua_var.acc[acc_id].via_tp;
+        tdata->via_addr = PJSUA_ACC(acc_id).via_addr;
+        tdata->via_tp = PJSUA_ACC(acc_id).via_tp;
     } else if (!pjsua_sip_acc_is_using_stun(acc_id)) {
         /* Choose local interface to use in Via if acc is not using
          * STUN
@@ -3252,7 +3422,7 @@ pj_status_t pjsua_acc_get_uac_addr(pjsua_acc_id acc_id,
     pj_bool_t update_addr = PJ_TRUE;
 
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     /* If route-set is configured for the account, then URI is the
      * first entry of the route-set.
@@ -3504,7 +3674,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_uac_contact( pj_pool_t *pool,
 
     
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     /* If force_contact is configured, then use use it */
     if (acc->cfg.force_contact.slen) {
@@ -3593,7 +3763,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_uas_contact( pj_pool_t *pool,
     char transport_param[32];
     
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     /* If force_contact is configured, then use use it */
     if (acc->cfg.force_contact.slen) {
@@ -3676,7 +3846,7 @@ PJ_DEF(pj_status_t) pjsua_acc_create_uas_contact( pj_pool_t *pool,
     secure = (flag & PJSIP_TRANSPORT_SECURE) != 0;
 
     /* Init transport selector. */
-    pjsua_init_tpselector(pjsua_var.acc[acc_id].cfg.transport_id, &tp_sel);
+    pjsua_init_tpselector(PJSUA_ACC(acc_id).cfg.transport_id, &tp_sel);
 
     /* Get local address suitable to send request from */
     pjsip_tpmgr_fla2_param_default(&tfla2_prm);
@@ -3748,7 +3918,7 @@ PJ_DEF(pj_status_t) pjsua_acc_set_transport( pjsua_acc_id acc_id,
     pjsua_acc *acc;
 
     PJ_ASSERT_RETURN(pjsua_acc_is_valid(acc_id), PJ_EINVAL);
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
 
     PJ_ASSERT_RETURN(tp_id >= 0 && tp_id < (int)PJ_ARRAY_SIZE(pjsua_var.tpdata),
 		     PJ_EINVAL);
@@ -3815,8 +3985,8 @@ static void schedule_reregistration(pjsua_acc *acc)
     {
 	unsigned i, cnt;
 
-	for (i = 0, cnt = 0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-	    if (pjsua_var.calls[i].acc_id == acc->index) {
+	for (i = 0, cnt = 0; i < pjsua_var.call_slots; ++i) {
+	    if (PJSUA_CALL(i).acc_id == acc->index) {
 		pjsua_call_hangup(i, 0, NULL, NULL);
 		++cnt;
 	    }
@@ -3898,8 +4068,8 @@ void pjsua_acc_on_tp_state_changed(pjsip_transport *tp,
     /* Enumerate accounts using this transport and perform actions
      * based on the transport state.
      */
-    for (i = 0; i < PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	pjsua_acc *acc = &pjsua_var.acc[i];
+    for (i = 0; i < pjsua_var.acc_slots; ++i) {
+	pjsua_acc *acc = &PJSUA_ACC(i);
 
 	/* Skip if this account is not valid. */
 	if (!acc->valid)
@@ -3921,9 +4091,9 @@ void pjsua_acc_on_tp_state_changed(pjsip_transport *tp,
 	    if (reg_info.transport != tp)
 	        continue;
 
-	    pjsip_regc_release_transport(pjsua_var.acc[i].regc);
+	    pjsip_regc_release_transport(PJSUA_ACC(i).regc);
 
-	    if (pjsua_var.acc[i].ip_change_op ==
+	    if (PJSUA_ACC(i).ip_change_op ==
 					    PJSUA_IP_CHANGE_OP_ACC_SHUTDOWN_TP)
 	    {
 		/* Before progressing to next step, report here. */
@@ -4007,11 +4177,11 @@ pj_status_t pjsua_acc_handle_call_on_ip_change(pjsua_acc *acc)
     if (acc->cfg.ip_change_cfg.hangup_calls ||
 	acc->cfg.ip_change_cfg.reinvite_flags)
     {
-	for (i = 0; i < (int)pjsua_var.ua_cfg.max_calls; ++i) {
+	for (i = 0; i < (int)pjsua_var.call_slots; ++i) {
 	    pjsua_call_info call_info;
 	    pjsua_call_get_info(i, &call_info);
 
-	    if (pjsua_var.calls[i].acc_id != acc->index)
+	    if (PJSUA_CALL(i).acc_id != acc->index)
 	    {
 		continue;
 	    }
@@ -4090,9 +4260,9 @@ void pjsua_acc_end_ip_change(pjsua_acc *acc)
 		   "completed", acc->index));
 	acc->ip_change_op = PJSUA_IP_CHANGE_OP_COMPLETED;
 	if (pjsua_var.acc_cnt) {
-	    for (; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-		if (pjsua_var.acc[i].valid &&
-		    pjsua_var.acc[i].ip_change_op !=
+	    for (; i < (int)pjsua_var.acc_slots; ++i) {
+		if (PJSUA_ACC(i).valid &&
+		    PJSUA_ACC(i).ip_change_op !=
 						  PJSUA_IP_CHANGE_OP_COMPLETED)
 		{
 		    all_done = PJ_FALSE;
@@ -50,9 +50,10 @@ static pj_status_t create_aud_param(pjmedia_aud_param *param,
  */
 PJ_DEF(pj_bool_t) pjsua_call_has_media(pjsua_call_id call_id)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    pjsua_call *call;
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
+    call = &PJSUA_CALL(call_id);
     return call->audio_idx >= 0 && call->media[call->audio_idx].strm.a.stream;
 }
 
@@ -65,7 +66,7 @@ PJ_DEF(pjsua_conf_port_id) pjsua_call_get_conf_port(pjsua_call_id call_id)
     pjsua_call *call;
     pjsua_conf_port_id port_id = PJSUA_INVALID_ID;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     /* Use PJSUA_LOCK() instead of acquire_call():
@@ -76,7 +77,7 @@ PJ_DEF(pjsua_conf_port_id) pjsua_call_get_conf_port(pjsua_call_id call_id)
     if (!pjsua_call_is_active(call_id))
 	goto on_return;
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
     if (call->audio_idx >= 0)
 	port_id = call->media[call->audio_idx].strm.a.conf_slot;
 
@@ -98,13 +99,13 @@ PJ_DEF(pj_status_t) pjsua_call_get_stream_info( pjsua_call_id call_id,
     pjsua_call_media *call_med;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(psi, PJ_EINVAL);
 
     PJSUA_LOCK();
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
 
     if (med_idx >= call->med_cnt) {
 	PJSUA_UNLOCK();
@@ -145,13 +146,13 @@ PJ_DEF(pj_status_t) pjsua_call_get_stream_stat( pjsua_call_id call_id,
     pjsua_call_media *call_med;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(stat, PJ_EINVAL);
 
     PJSUA_LOCK();
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
 
     if (med_idx >= call->med_cnt) {
 	PJSUA_UNLOCK();
@@ -195,7 +196,7 @@ PJ_DEF(pj_status_t) pjsua_call_dial_dtmf( pjsua_call_id call_id,
     pjsip_dialog *dlg = NULL;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Call %d dialing DTMF %.*s",
@@ -630,7 +631,7 @@ pj_status_t pjsua_aud_channel_update(pjsua_call_media *call_med,
 
 #if defined(PJMEDIA_STREAM_ENABLE_KA) && PJMEDIA_STREAM_ENABLE_KA!=0
 	/* Enable/disable stream keep-alive and NAT hole punch. */
-	si->use_ka = pjsua_var.acc[call->acc_id].cfg.use_stream_ka;
+	si->use_ka = PJSUA_ACC(call->acc_id).cfg.use_stream_ka;
 #endif
 
 	/* Create session based on session info. */
@@ -136,7 +136,9 @@ static pj_status_t process_pending_reinvite(pjsua_call *call);
  */
 static void reset_call(pjsua_call_id id)
 {
-    pjsua_call *call = &pjsua_var.calls[id];
+    pjsua_call *call = &PJSUA_CALL(id);
+    pj_bool_t in_free_list = call->in_free_list;
+    pjsua_call_id next_free = call->next_free;
     unsigned i;
 
     if (call->incoming_data) {
@@ -145,6 +147,8 @@ static void reset_call(pjsua_call_id id)
     }
     pj_bzero(call, sizeof(*call));
     call->index = id;
+    call->in_free_list = in_free_list;
+    call->next_free = next_free;
     call->last_text.ptr = call->last_text_buf_;
     call->cname.ptr = call->cname_buf;
     call->cname.slen = sizeof(call->cname_buf);
@@ -187,9 +191,10 @@ pj_status_t pjsua_call_subsys_init(const pjsua_config *cfg)
     const pj_str_t str_norefersub = { "norefersub", 10 };
     pj_status_t status;
 
-    /* Init calls array. */
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.calls); ++i)
-	reset_call(i);
+    /* Init calls table, the segments are allocated by alloc_call_id(). */
+    pjsua_var.call_slots = 0;
+    pjsua_var.call_free_head = PJSUA_INVALID_ID;
+    pjsua_var.call_free_tail = PJSUA_INVALID_ID;
 
     /* Copy config */
     pjsua_config_dup(pjsua_var.pool, &pjsua_var.ua_cfg, cfg);
@@ -276,8 +281,8 @@ PJ_DEF(pj_status_t) pjsua_enum_calls( pjsua_call_id ids[],
 
     PJSUA_LOCK();
 
-    for (i=0, c=0; c<*count && i<pjsua_var.ua_cfg.max_calls; ++i) {
-	if (!pjsua_var.calls[i].inv)
+    for (i=0, c=0; c<*count && i<pjsua_var.call_slots; ++i) {
+	if (!PJSUA_CALL(i).inv)
 	    continue;
 	ids[c] = i;
 	++c;
@@ -291,48 +296,115 @@ PJ_DEF(pj_status_t) pjsua_enum_calls( pjsua_call_id ids[],
 }
 
 
+/* Queue a free call id, it is handed out again after the older ones. */
+static void push_free_call_id(pjsua_call_id cid)
+{
+    pjsua_call *call = &PJSUA_CALL(cid);
+
+    if (call->in_free_list)
+	return;
+
+    call->in_free_list = PJ_TRUE;
+    call->next_free = PJSUA_INVALID_ID;
+    if (pjsua_var.call_free_tail == PJSUA_INVALID_ID)
+	pjsua_var.call_free_head = cid;
+    else
+	PJSUA_CALL(pjsua_var.call_free_tail).next_free = cid;
+    pjsua_var.call_free_tail = cid;
+}
+
+static pjsua_call_id pop_free_call_id(void)
+{
+    pjsua_call_id cid = pjsua_var.call_free_head;
+    pjsua_call *call;
+
+    if (cid == PJSUA_INVALID_ID)
+	return PJSUA_INVALID_ID;
+
+    call = &PJSUA_CALL(cid);
+    pjsua_var.call_free_head = call->next_free;
+    if (pjsua_var.call_free_head == PJSUA_INVALID_ID)
+	pjsua_var.call_free_tail = PJSUA_INVALID_ID;
+    call->in_free_list = PJ_FALSE;
+    call->next_free = PJSUA_INVALID_ID;
+
+    return cid;
+}
+
+/* Add one segment to the calls table, up to max_calls. */
+static pj_status_t grow_call_table(void)
+{
+    unsigned seg = pjsua_var.call_slots / PJSUA_CALL_SEG_SIZE;
+    unsigned i;
+
+    if (pjsua_var.call_slots >= pjsua_var.ua_cfg.max_calls ||
+	seg >= PJ_ARRAY_SIZE(pjsua_var.call_seg))
+    {
+	return PJ_ETOOMANY;
+    }
+
+    pjsua_var.call_seg[seg] = (pjsua_call*)
+			      pj_pool_calloc(pjsua_var.pool,
+					     PJSUA_CALL_SEG_SIZE,
+					     sizeof(pjsua_call));
+    if (pjsua_var.call_seg[seg] == NULL)
+	return PJ_ENOMEM;
+
+    for (i=0; i<PJSUA_CALL_SEG_SIZE; ++i) {
+	pjsua_call_id cid = (pjsua_call_id)(pjsua_var.call_slots + i);
+
+	reset_call(cid);
+	/* Ids past max_calls are backed but never handed out */
+	if ((unsigned)cid < pjsua_var.ua_cfg.max_calls)
+	    push_free_call_id(cid);
+    }
+    pjsua_var.call_slots += PJSUA_CALL_SEG_SIZE;
+
+    return PJ_SUCCESS;
+}
+
+/* Reset a call and give its id back. */
+static void free_call(pjsua_call_id cid)
+{
+    reset_call(cid);
+    push_free_call_id(cid);
+}
+
 /* Allocate one call id */
 static pjsua_call_id alloc_call_id(void)
 {
     pjsua_call_id cid;
 
-#if 1
-    /* New algorithm: round-robin */
-    if (pjsua_var.next_call_id >= (int)pjsua_var.ua_cfg.max_calls ||
-	pjsua_var.next_call_id < 0)
+    /* The free ids are handed out the oldest first, like the round-robin
+     * this replaces, so a late message of an ended call does not hit a
+     * new one.
+     */
+    while ((cid = pop_free_call_id()) != PJSUA_INVALID_ID ||
+	   grow_call_table() == PJ_SUCCESS)
     {
-	pjsua_var.next_call_id = 0;
-    }
+	if (cid == PJSUA_INVALID_ID)
+	    continue;
 
-    for (cid=pjsua_var.next_call_id;
-	 cid<(int)pjsua_var.ua_cfg.max_calls;
-	 ++cid)
-    {
-	if (pjsua_var.calls[cid].inv == NULL &&
-            pjsua_var.calls[cid].async_call.dlg == NULL)
+	if (PJSUA_CALL(cid).inv == NULL &&
+            PJSUA_CALL(cid).async_call.dlg == NULL &&
+	    !PJSUA_CALL(cid).in_setup)
         {
-	    ++pjsua_var.next_call_id;
 	    return cid;
 	}
     }
 
-    for (cid=0; cid < pjsua_var.next_call_id; ++cid) {
-	if (pjsua_var.calls[cid].inv == NULL &&
-            pjsua_var.calls[cid].async_call.dlg == NULL)
+    /* A slot released without free_call() is only found by a scan */
+    for (cid=0; cid<(int)pjsua_var.call_slots &&
+		cid<(int)pjsua_var.ua_cfg.max_calls; ++cid)
+    {
+	if (PJSUA_CALL(cid).inv == NULL &&
+            PJSUA_CALL(cid).async_call.dlg == NULL &&
+	    !PJSUA_CALL(cid).in_setup)
         {
-	    ++pjsua_var.next_call_id;
 	    return cid;
 	}
     }
 
-#else
-    /* Old algorithm */
-    for (cid=0; cid<(int)pjsua_var.ua_cfg.max_calls; ++cid) {
-	if (pjsua_var.calls[cid].inv == NULL)
-	    return cid;
-    }
-#endif
-
     return PJSUA_INVALID_ID;
 }
 
@@ -346,7 +418,7 @@ static int get_secure_level(pjsua_acc_id acc_id, const pj_str_t *dst_uri)
 {
     const pj_str_t tls = pj_str(";transport=tls");
     const pj_str_t sips = pj_str("sips:");
-    pjsua_acc *acc = &pjsua_var.acc[acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(acc_id);
 
     if (pj_stristr(dst_uri, &sips))
 	return 2;
@@ -448,8 +520,8 @@ on_make_call_med_tp_complete2(pjsua_call_id call_id,
 {
     pjmedia_sdp_session *offer = NULL;
     pjsip_inv_session *inv = NULL;
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
+    pjsua_acc *acc = &PJSUA_ACC(call->acc_id);
     pjsip_dialog *dlg = call->async_call.dlg;
     unsigned options = 0;
     pjsip_tx_data *tdata;
@@ -623,7 +695,7 @@ on_error:
 
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
-	reset_call(call_id);
+	free_call(call_id);
     }
 
     call->med_ch_cb = NULL;
@@ -791,7 +863,7 @@ static pj_status_t dlg_set_target(pjsip_dialog *dlg, const pj_str_t *target)
 void call_update_contact(pjsua_call *call, pj_str_t **new_contact)
 {
     pjsip_tpselector tp_sel;
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(call->acc_id);
 
     if (acc->cfg.force_contact.slen)
 	*new_contact = &acc->cfg.force_contact;
@@ -846,7 +918,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
     pj_status_t status;
 
     /* Check that account is valid */
-    PJ_ASSERT_RETURN(acc_id>=0 || acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
 
     /* Check arguments */
@@ -859,7 +931,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
 
     PJSUA_LOCK();
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
     if (!acc->valid) {
 	pjsua_perror(THIS_FILE, "Unable to make call because account "
 		     "is not valid", PJ_EINVALIDOP);
@@ -879,7 +951,7 @@ PJ_DEF(pj_status_t) pjsua_call_make_call(pjsua_acc_id acc_id,
     /* Clear call descriptor */
     reset_call(call_id);
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
 
     /* Associate session with account */
     call->acc_id = acc_id;
@@ -1031,7 +1103,7 @@ on_error:
 
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
-	reset_call(call_id);
+	free_call(call_id);
     }
 
     pjsua_check_snd_dev_idle();
@@ -1059,11 +1131,13 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
     pjsua_acc *acc;
     pjsua_call *call;
     int call_id = -1;
+    pj_str_t acc_uri;
     pj_str_t contact;
+    pj_bool_t has_pjsua_lock = PJ_FALSE;
     pj_status_t status;
 
     /* Check that account is valid */
-    PJ_ASSERT_RETURN(acc_id>=0 || acc_id<(int)PJ_ARRAY_SIZE(pjsua_var.acc),
+    PJ_ASSERT_RETURN(acc_id>=0 && acc_id<(int)pjsua_var.acc_slots,
 		     PJ_EINVAL);
 
     /* Check arguments */
@@ -1074,29 +1148,58 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
 
     pj_log_push_indent();
 
+    /* Create temporary pool */
+    tmp_pool = pjsua_pool_create("tmpcall10", 512, 256);
+
+    /* Verify that destination URI is valid before calling
+     * pjsua_acc_create_uac_contact, or otherwise there
+     * a misleading "Invalid Contact URI" error will be printed
+     * when pjsua_acc_create_uac_contact() fails.
+     */
+    if (1) {
+	pjsip_uri *uri;
+	pj_str_t dup;
+
+	pj_strdup_with_null(tmp_pool, &dup, dest_uri);
+	uri = pjsip_parse_uri(tmp_pool, dup.ptr, dup.slen, 0);
+
+	if (uri == NULL) {
+	    pjsua_perror(THIS_FILE, "Unable to make call",
+			 PJSIP_EINVALIDREQURI);
+	    status = PJSIP_EINVALIDREQURI;
+	    goto on_error;
+	}
+    }
+
+    /* Plays are started by the hundred, so the pjsua lock is only held to
+     * take a call slot and to read the account. The dialog and the media
+     * are set up under the lock of the call, which is its dialog lock.
+     */
     PJSUA_LOCK();
+    has_pjsua_lock = PJ_TRUE;
 
-    acc = &pjsua_var.acc[acc_id];
+    acc = &PJSUA_ACC(acc_id);
     if (!acc->valid) {
-		pjsua_perror(THIS_FILE, "Unable to make play because account "
-				"is not valid", PJ_EINVALIDOP);
-		status = PJ_EINVALIDOP;
-		goto on_error;
+	pjsua_perror(THIS_FILE, "Unable to make play because account "
+		     "is not valid", PJ_EINVALIDOP);
+	status = PJ_EINVALIDOP;
+	goto on_error;
     }
 
     /* Find free call slot. */
     call_id = alloc_call_id();
 
     if (call_id == PJSUA_INVALID_ID) {
-		pjsua_perror(THIS_FILE, "Error making call", PJ_ETOOMANY);
-		status = PJ_ETOOMANY;
-		goto on_error;
+	pjsua_perror(THIS_FILE, "Error making call", PJ_ETOOMANY);
+	status = PJ_ETOOMANY;
+	goto on_error;
     }
 
-    /* Clear call descriptor */
+    /* Clear call descriptor, and keep the slot until the dialog is set */
     reset_call(call_id);
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
+    call->in_setup = PJ_TRUE;
 
     /* Associate session with account */
     call->acc_id = acc_id;
@@ -1108,8 +1211,8 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
     /* Apply call setting */
     status = apply_call_setting(call, opt, NULL);
     if (status != PJ_SUCCESS) {
-		pjsua_perror(THIS_FILE, "Failed to apply call setting", status);
-		goto on_error;
+	pjsua_perror(THIS_FILE, "Failed to apply call setting", status);
+	goto on_error;
     }
     
     /* Create sound port if none is instantiated, to check if sound device
@@ -1120,32 +1223,9 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
     if (!pjsua_var.is_mswitch && pjsua_var.snd_port==NULL &&
 	pjsua_var.null_snd==NULL && !pjsua_var.no_snd && call->opt.aud_cnt > 0)
     {
-		status = pjsua_set_snd_dev(pjsua_var.cap_dev, pjsua_var.play_dev);
-		if (status != PJ_SUCCESS)
-			goto on_error;
-    }
-
-    /* Create temporary pool */
-    tmp_pool = pjsua_pool_create("tmpcall10", 512, 256);
-
-    /* Verify that destination URI is valid before calling
-     * pjsua_acc_create_uac_contact, or otherwise there
-     * a misleading "Invalid Contact URI" error will be printed
-     * when pjsua_acc_create_uac_contact() fails.
-     */
-    if (1) {
-		pjsip_uri *uri;
-		pj_str_t dup;
-
-		pj_strdup_with_null(tmp_pool, &dup, dest_uri);
-		uri = pjsip_parse_uri(tmp_pool, dup.ptr, dup.slen, 0);
-
-		if (uri == NULL) {
-			pjsua_perror(THIS_FILE, "Unable to make call",
-				PJSIP_EINVALIDREQURI);
-			status = PJSIP_EINVALIDREQURI;
-			goto on_error;
-		}
+	status = pjsua_set_snd_dev(pjsua_var.cap_dev, pjsua_var.play_dev);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
     }
 
     /* Mark call start time. */
@@ -1154,54 +1234,71 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
     /* Reset first response time */
     call->res_time.sec = 0;
 
-    /* Create suitable Contact header unless a Contact header has been
-     * set in the account.
+    /* Copy the account URI and create suitable Contact header unless a
+     * Contact header has been set in the account, the account may change
+     * once the lock is released.
      */
+    pj_strdup_with_null(tmp_pool, &acc_uri, &acc->cfg.id);
     if (acc->contact.slen) {
-		contact = acc->contact;
+	pj_strdup_with_null(tmp_pool, &contact, &acc->contact);
     } else {
-		status = pjsua_acc_create_uac_contact(tmp_pool, &contact,
-							acc_id, dest_uri);
-		if (status != PJ_SUCCESS) {
-			pjsua_perror(THIS_FILE, "Unable to generate Contact header",
-				status);
-			goto on_error;
-		}
+	status = pjsua_acc_create_uac_contact(tmp_pool, &contact,
+					      acc_id, dest_uri);
+	if (status != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Unable to generate Contact header",
+			 status);
+	    goto on_error;
+	}
     }
 
+    /* Calculate call's secure level */
+    call->secure_level = get_secure_level(acc_id, dest_uri);
+
+    /* Attach user data */
+    call->user_data = user_data;
+
+    PJSUA_UNLOCK();
+    has_pjsua_lock = PJ_FALSE;
+
     /* Create outgoing dialog: */
     status = pjsip_dlg_create_uac( pjsip_ua_instance(),
-				   &acc->cfg.id, &contact,
+				   &acc_uri, &contact,
 				   dest_uri,
                                    (msg_data && msg_data->target_uri.slen?
                                     &msg_data->target_uri: dest_uri),
                                    &dlg);
     if (status != PJ_SUCCESS) {
-		pjsua_perror(THIS_FILE, "Dialog creation failed", status);
-		goto on_error;
+	pjsua_perror(THIS_FILE, "Dialog creation failed", status);
+	goto on_error;
     }
 
     /* Increment the dialog's lock otherwise when invite session creation
-     * fails the dialog will be destroyed prematurely.
+     * fails the dialog will be destroyed prematurely. It is the lock of
+     * the call from here on.
      */
     pjsip_dlg_inc_lock(dlg);
 
-    dlg_set_via(dlg, acc);
-
-    /* Calculate call's secure level */
-    call->secure_level = get_secure_level(acc_id, dest_uri);
-
-    /* Attach user data */
-    call->user_data = user_data;
-
     /* Store variables required for the callback after the async
      * media transport creation is completed.
      */
     if (msg_data) {
-		call->async_call.call_var.out_call.msg_data = pjsua_msg_data_clone(
-															dlg->pool, msg_data);
+	call->async_call.call_var.out_call.msg_data = pjsua_msg_data_clone(
+							dlg->pool, msg_data);
     }
+
+    /* Hand the dialog to the call, acquire_call() finds it from now on */
+    PJSUA_LOCK();
+    if (!acc->valid) {
+	PJSUA_UNLOCK();
+	pjsua_perror(THIS_FILE, "Unable to make play because account "
+		     "has been deleted", PJ_EINVALIDOP);
+	status = PJ_EINVALIDOP;
+	goto on_error;
+    }
+    dlg_set_via(dlg, acc);
     call->async_call.dlg = dlg;
+    call->in_setup = PJ_FALSE;
+    PJSUA_UNLOCK();
 
     /* Temporarily increment dialog session. Without this, dialog will be
      * prematurely destroyed if dec_lock() is called on the dialog before
@@ -1210,7 +1307,9 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
     pjsip_dlg_inc_session(dlg, &pjsua_var.mod);
 
     if ((call->opt.flag & PJSUA_CALL_NO_SDP_OFFER) == 0) {
-        /* Init media channel */
+        /* Init media channel, the rtp ports of the account are taken
+         * under the pjsua lock by reserve_rtp_port().
+         */
         status = pjsua_media_channel_init(call->index, PJSIP_ROLE_UAC,
                                           call->secure_level, dlg->pool,
                                           NULL, NULL, PJ_TRUE,
@@ -1218,23 +1317,24 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
     }
     if (status == PJ_SUCCESS) {
         status = on_make_call_med_tp_complete2(call->index, NULL, &GB_PLAY);
-        if (status != PJ_SUCCESS)
+        if (status != PJ_SUCCESS) {
+	    /* The call has been released, its id may be taken again */
+	    call_id = -1;
 	    goto on_error;
+	}
     } else if (status != PJ_EPENDING) {
-		pjsua_perror(THIS_FILE, "Error initializing media channel", status);
-		pjsip_dlg_dec_session(dlg, &pjsua_var.mod);
-		goto on_error;
+	pjsua_perror(THIS_FILE, "Error initializing media channel", status);
+	pjsip_dlg_dec_session(dlg, &pjsua_var.mod);
+	goto on_error;
     }
 
     /* Done. */
 
-    if (p_call_id) {
-		*p_call_id = call_id;
-	}
+    if (p_call_id)
+	*p_call_id = call_id;
 
     pjsip_dlg_dec_lock(dlg);
     pj_pool_release(tmp_pool);
-    PJSUA_UNLOCK();
 
     pj_log_pop_indent();
 
@@ -1242,6 +1342,10 @@ PJ_DEF(pj_status_t) pjsua_call_make_play(pjsua_acc_id acc_id,
 
 
 on_error:
+    /* Release the call before the dialog can go away under it */
+    if (!has_pjsua_lock)
+	PJSUA_LOCK();
+
     if (dlg) {
 	/* This may destroy the dialog */
 	pjsip_dlg_dec_lock(dlg);
@@ -1249,14 +1353,15 @@ on_error:
 
     if (call_id != -1) {
 	pjsua_media_channel_deinit(call_id);
-	reset_call(call_id);
+	free_call(call_id);
     }
 
     pjsua_check_snd_dev_idle();
 
+    PJSUA_UNLOCK();
+
     if (tmp_pool)
 	pj_pool_release(tmp_pool);
-    PJSUA_UNLOCK();
 
     pj_log_pop_indent();
     return status;
@@ -1553,7 +1658,7 @@ on_incoming_call_med_tp_complete2(pjsua_call_id call_id,
 				  int *sip_err_code,
 				  pjsip_tx_data **tdata)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     pjsip_dialog *dlg = call->async_call.dlg;    
     pj_status_t status = (info? info->status: PJ_SUCCESS);
     int err_code = (info? info->sip_err_code: 0);
@@ -1706,7 +1811,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     /* Clear call descriptor */
     reset_call(call_id);
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
 
     /* Generate per-session RTCP CNAME, according to RFC 7022. */
     pj_create_random_string(call->cname_buf, call->cname.slen);
@@ -1809,7 +1914,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
 	goto on_return;
     }
-    call->call_hold_type = pjsua_var.acc[acc_id].cfg.call_hold_type;
+    call->call_hold_type = PJSUA_ACC(acc_id).cfg.call_hold_type;
 
     /* Get call's secure level */
     if (PJSIP_URI_SCHEME_IS_SIPS(rdata->msg_info.msg->line.req.uri))
@@ -1895,13 +2000,13 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     /* Verify that we can handle the request. */
     options |= PJSIP_INV_SUPPORT_100REL;
     options |= PJSIP_INV_SUPPORT_TIMER;
-    if (pjsua_var.acc[acc_id].cfg.require_100rel == PJSUA_100REL_MANDATORY)
+    if (PJSUA_ACC(acc_id).cfg.require_100rel == PJSUA_100REL_MANDATORY)
 	options |= PJSIP_INV_REQUIRE_100REL;
-    if (pjsua_var.acc[acc_id].cfg.ice_cfg.enable_ice)
+    if (PJSUA_ACC(acc_id).cfg.ice_cfg.enable_ice)
 	options |= PJSIP_INV_SUPPORT_ICE;
-    if (pjsua_var.acc[acc_id].cfg.use_timer == PJSUA_SIP_TIMER_REQUIRED)
+    if (PJSUA_ACC(acc_id).cfg.use_timer == PJSUA_SIP_TIMER_REQUIRED)
 	options |= PJSIP_INV_REQUIRE_TIMER;
-    else if (pjsua_var.acc[acc_id].cfg.use_timer == PJSUA_SIP_TIMER_ALWAYS)
+    else if (PJSUA_ACC(acc_id).cfg.use_timer == PJSUA_SIP_TIMER_ALWAYS)
 	options |= PJSIP_INV_ALWAYS_USE_TIMER;
 
     status = pjsip_inv_verify_request2(rdata, &options, offer, NULL, NULL,
@@ -1928,8 +2033,8 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     }
 
     /* Get suitable Contact header */
-    if (pjsua_var.acc[acc_id].contact.slen) {
-	contact = pjsua_var.acc[acc_id].contact;
+    if (PJSUA_ACC(acc_id).contact.slen) {
+	contact = PJSUA_ACC(acc_id).contact;
     } else {
 	status = pjsua_acc_create_uas_contact(rdata->tp_info.pool, &contact,
 					      acc_id, rdata);
@@ -1951,11 +2056,11 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 	goto on_return;
     }
 
-    if (pjsua_var.acc[acc_id].cfg.allow_via_rewrite &&
-        pjsua_var.acc[acc_id].via_addr.host.slen > 0)
+    if (PJSUA_ACC(acc_id).cfg.allow_via_rewrite &&
+        PJSUA_ACC(acc_id).via_addr.host.slen > 0)
     {
-        pjsip_dlg_set_via_sent_by(dlg, &pjsua_var.acc[acc_id].via_addr,
-                                  pjsua_var.acc[acc_id].via_tp);
+        pjsip_dlg_set_via_sent_by(dlg, &PJSUA_ACC(acc_id).via_addr,
+                                  PJSUA_ACC(acc_id).via_tp);
     } else if (!pjsua_sip_acc_is_using_stun(acc_id)) {
 	/* Choose local interface to use in Via if acc is not using
 	 * STUN. See https://trac.pjsip.org/repos/ticket/1804
@@ -1981,20 +2086,20 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     }
 
     /* Set credentials */
-    if (pjsua_var.acc[acc_id].cred_cnt) {
+    if (PJSUA_ACC(acc_id).cred_cnt) {
 	pjsip_auth_clt_set_credentials(&dlg->auth_sess,
-				       pjsua_var.acc[acc_id].cred_cnt,
-				       pjsua_var.acc[acc_id].cred);
+				       PJSUA_ACC(acc_id).cred_cnt,
+				       PJSUA_ACC(acc_id).cred);
     }
 
     /* Set preference */
     pjsip_auth_clt_set_prefs(&dlg->auth_sess,
-			     &pjsua_var.acc[acc_id].cfg.auth_pref);
+			     &PJSUA_ACC(acc_id).cfg.auth_pref);
 
     /* Disable Session Timers if not prefered and the incoming INVITE request
      * did not require it.
      */
-    if (pjsua_var.acc[acc_id].cfg.use_timer == PJSUA_SIP_TIMER_INACTIVE &&
+    if (PJSUA_ACC(acc_id).cfg.use_timer == PJSUA_SIP_TIMER_INACTIVE &&
 	(options & PJSIP_INV_REQUIRE_TIMER) == 0)
     {
 	options &= ~(PJSIP_INV_SUPPORT_TIMER);
@@ -2002,7 +2107,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
     /* If 100rel is optional and UAC supports it, use it. */
     if ((options & PJSIP_INV_REQUIRE_100REL)==0 &&
-	pjsua_var.acc[acc_id].cfg.require_100rel == PJSUA_100REL_OPTIONAL)
+	PJSUA_ACC(acc_id).cfg.require_100rel == PJSUA_100REL_OPTIONAL)
     {
 	const pj_str_t token = { "100rel", 6};
 	pjsip_dialog_cap_status cap_status;
@@ -2036,10 +2141,10 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     /* If account is locked to specific transport, then lock dialog
      * to this transport too.
      */
-    if (pjsua_var.acc[acc_id].cfg.transport_id != PJSUA_INVALID_ID) {
+    if (PJSUA_ACC(acc_id).cfg.transport_id != PJSUA_INVALID_ID) {
 	pjsip_tpselector tp_sel;
 
-	pjsua_init_tpselector(pjsua_var.acc[acc_id].cfg.transport_id, &tp_sel);
+	pjsua_init_tpselector(PJSUA_ACC(acc_id).cfg.transport_id, &tp_sel);
 	pjsip_dlg_set_transport(dlg, &tp_sel);
     }
 
@@ -2162,7 +2267,7 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
 
     /* Init Session Timers */
     status = pjsip_timer_init_session(inv,
-				    &pjsua_var.acc[acc_id].cfg.timer_setting);
+				    &PJSUA_ACC(acc_id).cfg.timer_setting);
     if (status != PJ_SUCCESS) {
 	pjsua_perror(THIS_FILE, "Session Timer init failed", status);
         pjsip_dlg_respond(dlg, rdata, PJSIP_SC_INTERNAL_SERVER_ERROR, NULL, NULL, NULL);
@@ -2292,6 +2397,10 @@ on_return:
 	pjsip_rx_data_free_cloned(call->incoming_data);
 	call->incoming_data = NULL;
     }
+
+    /* The call was refused before it got an invite session */
+    if (call && call->inv == NULL && call->async_call.dlg == NULL)
+	push_free_call_id(call->index);
     
     pj_log_pop_indent();
     PJSUA_UNLOCK();
@@ -2306,10 +2415,10 @@ on_return:
  */
 PJ_DEF(pj_bool_t) pjsua_call_is_active(pjsua_call_id call_id)
 {
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
-    return pjsua_var.calls[call_id].inv != NULL &&
-	   pjsua_var.calls[call_id].inv->state != PJSIP_INV_STATE_DISCONNECTED;
+    return PJSUA_CALL(call_id).inv != NULL &&
+	   PJSUA_CALL(call_id).inv->state != PJSIP_INV_STATE_DISCONNECTED;
 }
 
 
@@ -2351,7 +2460,7 @@ pj_status_t acquire_call(const char *title,
 	}
 
 	has_pjsua_lock = PJ_TRUE;
-	call = &pjsua_var.calls[call_id];
+	call = &PJSUA_CALL(call_id);
         if (call->inv)
             dlg = call->inv->dlg;
         else
@@ -2404,7 +2513,7 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
     pjsip_dialog *dlg;
     unsigned mi;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     pj_bzero(info, sizeof(*info));
@@ -2414,7 +2523,7 @@ PJ_DEF(pj_status_t) pjsua_call_get_info( pjsua_call_id call_id,
      */
     PJSUA_LOCK();
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
     dlg = (call->inv ? call->inv->dlg : call->async_call.dlg);
     if (!dlg) {
 	PJSUA_UNLOCK();
@@ -2639,9 +2748,9 @@ PJ_DEF(pjsip_dialog_cap_status) pjsua_call_remote_has_cap(
 PJ_DEF(pj_status_t) pjsua_call_set_user_data( pjsua_call_id call_id,
 					      void *user_data)
 {
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
-    pjsua_var.calls[call_id].user_data = user_data;
+    PJSUA_CALL(call_id).user_data = user_data;
 
     return PJ_SUCCESS;
 }
@@ -2652,9 +2761,9 @@ PJ_DEF(pj_status_t) pjsua_call_set_user_data( pjsua_call_id call_id,
  */
 PJ_DEF(void*) pjsua_call_get_user_data(pjsua_call_id call_id)
 {
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     NULL);
-    return pjsua_var.calls[call_id].user_data;
+    return PJSUA_CALL(call_id).user_data;
 }
 
 
@@ -2664,11 +2773,11 @@ PJ_DEF(void*) pjsua_call_get_user_data(pjsua_call_id call_id)
 PJ_DEF(pj_status_t) pjsua_call_get_rem_nat_type(pjsua_call_id call_id,
 						pj_stun_nat_type *p_type)
 {
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(p_type != NULL, PJ_EINVAL);
 
-    *p_type = pjsua_var.calls[call_id].rem_nat_type;
+    *p_type = PJSUA_CALL(call_id).rem_nat_type;
     return PJ_SUCCESS;
 }
 
@@ -2685,13 +2794,13 @@ pjsua_call_get_med_transport_info(pjsua_call_id call_id,
     pjsua_call_media *call_med;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(t, PJ_EINVAL);
 
     PJSUA_LOCK();
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
 
     if (med_idx >= call->med_cnt) {
 	PJSUA_UNLOCK();
@@ -2713,7 +2822,7 @@ static pj_status_t
 on_answer_call_med_tp_complete(pjsua_call_id call_id,
                                const pjsua_med_tp_state_info *info)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     pjmedia_sdp_session *sdp;
     int sip_err_code = (info? info->sip_err_code: 0);
     pj_status_t status = (info? info->status: PJ_SUCCESS);
@@ -2812,7 +2921,7 @@ PJ_DEF(pj_status_t) pjsua_call_answer2(pjsua_call_id call_id,
     pjsip_tx_data *tdata;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Answering call %d: code=%d", call_id, code));
@@ -2964,7 +3073,7 @@ pjsua_call_answer_with_sdp(pjsua_call_id call_id,
     pjsip_dialog *dlg = NULL;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     status = acquire_call("pjsua_call_answer_with_sdp()",
@@ -2998,12 +3107,12 @@ PJ_DEF(pj_status_t) pjsua_call_hangup(pjsua_call_id call_id,
     pjsip_tx_data *tdata;
 
 
-    if (call_id<0 || call_id>=(int)pjsua_var.ua_cfg.max_calls) {
+    if (call_id<0 || call_id>=(int)pjsua_var.call_slots) {
 	PJ_LOG(1,(THIS_FILE, "pjsua_call_hangup(): invalid call id %d",
 			     call_id));
     }
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Call %d hanging up: code=%d..", call_id, code));
@@ -3102,7 +3211,7 @@ PJ_DEF(pj_status_t) pjsua_call_process_redirect( pjsua_call_id call_id,
     pjsip_dialog *dlg;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     status = acquire_call("pjsua_call_process_redirect()", call_id,
@@ -3138,7 +3247,7 @@ PJ_DEF(pj_status_t) pjsua_call_set_hold2(pjsua_call_id call_id,
     pj_str_t *new_contact = NULL;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Putting call %d on hold", call_id));
@@ -3174,7 +3283,7 @@ PJ_DEF(pj_status_t) pjsua_call_set_hold2(pjsua_call_id call_id,
     if ((options & PJSUA_CALL_UPDATE_VIA) &&
 	pjsua_acc_is_valid(call->acc_id))
     {
-    	dlg_set_via(call->inv->dlg, &pjsua_var.acc[call->acc_id]);
+    	dlg_set_via(call->inv->dlg, &PJSUA_ACC(call->acc_id));
     }
 
     if ((call->opt.flag & PJSUA_CALL_UPDATE_TARGET) &&
@@ -3262,7 +3371,7 @@ PJ_DEF(pj_status_t) pjsua_call_reinvite2(pjsua_call_id call_id,
     pj_status_t status;
 
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Sending re-INVITE on call %d", call_id));
@@ -3313,7 +3422,7 @@ PJ_DEF(pj_status_t) pjsua_call_reinvite2(pjsua_call_id call_id,
     if ((call->opt.flag & PJSUA_CALL_UPDATE_VIA) &&
 	pjsua_acc_is_valid(call->acc_id))
     {
-    	dlg_set_via(call->inv->dlg, &pjsua_var.acc[call->acc_id]);
+    	dlg_set_via(call->inv->dlg, &PJSUA_ACC(call->acc_id));
     }
 
     if ((call->opt.flag & PJSUA_CALL_UPDATE_TARGET) &&
@@ -3396,7 +3505,7 @@ PJ_DEF(pj_status_t) pjsua_call_update2(pjsua_call_id call_id,
     pjsip_dialog *dlg = NULL;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Sending UPDATE on call %d", call_id));
@@ -3445,7 +3554,7 @@ PJ_DEF(pj_status_t) pjsua_call_update2(pjsua_call_id call_id,
     if ((call->opt.flag & PJSUA_CALL_UPDATE_VIA) &&
 	pjsua_acc_is_valid(call->acc_id))
     {
-	dlg_set_via(call->inv->dlg, &pjsua_var.acc[call->acc_id]);
+	dlg_set_via(call->inv->dlg, &PJSUA_ACC(call->acc_id));
     }
 
     if ((call->opt.flag & PJSUA_CALL_UPDATE_TARGET) &&
@@ -3505,7 +3614,7 @@ PJ_DEF(pj_status_t) pjsua_call_xfer( pjsua_call_id call_id,
     pj_status_t status;
 
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls &&
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots &&
                      dest, PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Transferring call %d to %.*s", call_id,
@@ -3586,10 +3695,10 @@ PJ_DEF(pj_status_t) pjsua_call_xfer_replaces( pjsua_call_id call_id,
     const pjsip_parser_const_t *pconst;
 
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
     PJ_ASSERT_RETURN(dest_call_id>=0 &&
-		      dest_call_id<(int)pjsua_var.ua_cfg.max_calls,
+		      dest_call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Transferring call %d replacing with call %d",
@@ -3688,7 +3797,7 @@ PJ_DEF(pj_status_t) pjsua_call_send_dtmf(pjsua_call_id call_id,
 {
     pj_status_t status = PJ_EINVAL;    
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls &&
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots &&
 		     param, PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Call %d sending DTMF %.*s using %s method",
@@ -3738,7 +3847,7 @@ PJ_DEF(pj_status_t) pjsua_call_send_im( pjsua_call_id call_id,
     pjsip_tx_data *tdata;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Call %d sending %d bytes MESSAGE..",
@@ -3817,7 +3926,7 @@ PJ_DEF(pj_status_t) pjsua_call_send_typing_ind( pjsua_call_id call_id,
     pjsip_tx_data *tdata;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Call %d sending typing indication..",
@@ -3870,7 +3979,7 @@ PJ_DEF(pj_status_t) pjsua_call_send_request(pjsua_call_id call_id,
     pjsip_tx_data *tdata;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     PJ_LOG(4,(THIS_FILE, "Call %d sending %.*s request..",
@@ -3921,8 +4030,8 @@ PJ_DEF(void) pjsua_call_hangup_all(void)
     // This may deadlock, see https://trac.pjsip.org/repos/ticket/1305
     //PJSUA_LOCK();
 
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	if (pjsua_var.calls[i].inv)
+    for (i=0; i<pjsua_var.call_slots; ++i) {
+	if (PJSUA_CALL(i).inv)
 	    pjsua_call_hangup(i, 0, NULL, NULL);
     }
 
@@ -3941,7 +4050,7 @@ static void reinv_timer_cb(pj_timer_heap_t *th, pj_timer_entry *entry)
 
     PJ_UNUSED_ARG(th);
 
-    pjsua_var.calls[call_id].reinv_timer.id = PJ_FALSE;
+    PJSUA_CALL(call_id).reinv_timer.id = PJ_FALSE;
 
     pj_log_push_indent();
 
@@ -4024,7 +4133,7 @@ static pj_bool_t check_lock_codec(pjsua_call *call)
     pj_status_t status;
 
     /* Check if lock codec is disabled */
-    if (!pjsua_var.acc[call->acc_id].cfg.lock_codec)
+    if (!PJSUA_ACC(call->acc_id).cfg.lock_codec)
 	return PJ_FALSE;
 
     /* Check lock codec retry count */
@@ -4123,7 +4232,7 @@ static pj_bool_t check_ice_complete(pjsua_call *call, pj_bool_t *need_reinv)
 	    ice_info->sess_state == PJ_ICE_STRANS_STATE_RUNNING &&
 	    ice_info->role == PJ_ICE_SESS_ROLE_CONTROLLING)
 	{
-	    pjsua_ice_config *cfg=&pjsua_var.acc[call->acc_id].cfg.ice_cfg;
+	    pjsua_ice_config *cfg=&PJSUA_ACC(call->acc_id).cfg.ice_cfg;
 	    if ((cfg->ice_always_update && !call->reinv_ice_sent) ||
 		pj_sockaddr_cmp(&tpinfo.sock_info.rtp_addr_name,
 				&call_med->rtp_addr))
@@ -4575,8 +4684,8 @@ static void pjsua_call_on_state_changed(pjsip_inv_session *inv,
 	pj_assert(pjsua_var.call_cnt > 0);
 	--pjsua_var.call_cnt;
 
-	/* Reset call */
-	reset_call(call->index);
+	/* Reset call and give its id back */
+	free_call(call->index);
 
 	pjsua_check_snd_dev_idle();
 
@@ -5601,11 +5710,11 @@ static void on_call_transferred( pjsip_inv_session *inv,
 	 * Subsequent state changed in pjsua_inv_on_state_changed() will be
 	 * reported back to the server subscription.
 	 */
-	pjsua_var.calls[new_call].xfer_sub = sub;
+	PJSUA_CALL(new_call).xfer_sub = sub;
 
 	/* Put the invite_data in the subscription. */
 	pjsip_evsub_set_mod_data(sub, pjsua_var.mod.id,
-				 &pjsua_var.calls[new_call]);
+				 &PJSUA_CALL(new_call));
     }
 
 on_return:
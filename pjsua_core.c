@@ -57,8 +57,11 @@ static void init_data()
 
     pj_bzero(&pjsua_var, sizeof(pjsua_var));
 
-    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc); ++i)
-	pjsua_var.acc[i].index = i;
+    /* The account table segments are allocated by pjsua_acc_add() */
+    for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.acc_index[0]); ++i) {
+	pjsua_var.acc_index[PJSUA_ACC_INDEX_URI][i] = PJSUA_INVALID_ID;
+	pjsua_var.acc_index[PJSUA_ACC_INDEX_DOMAIN][i] = PJSUA_INVALID_ID;
+    }
     
     for (i=0; i<PJ_ARRAY_SIZE(pjsua_var.tpdata); ++i)
 	pjsua_var.tpdata[i].index = i;
@@ -592,12 +595,12 @@ static pj_bool_t options_on_rx_request(pjsip_rx_data *rdata)
 
     /* Get media socket info, make sure transport is ready */
 #if DISABLED_FOR_TICKET_1185
-    if (pjsua_var.calls[0].med_tp) {
+    if (PJSUA_CALL(0).med_tp) {
 	pjmedia_transport_info tpinfo;
 	pjmedia_sdp_session *sdp;
 
 	pjmedia_transport_info_init(&tpinfo);
-	pjmedia_transport_get_info(pjsua_var.calls[0].med_tp, &tpinfo);
+	pjmedia_transport_get_info(PJSUA_CALL(0).med_tp, &tpinfo);
 
 	/* Add SDP body, using call0's RTP address */
 	status = pjmedia_endpt_create_sdp(pjsua_var.med_endpt, tdata->pool, 1,
@@ -945,6 +948,15 @@ PJ_DEF(pj_status_t) pjsua_create(void)
 	pj_shutdown();
 	return status;
     }
+
+    /* The first accounts are always there, like the default account */
+    status = pjsua_acc_grow_table();
+    if (status != PJ_SUCCESS) {
+	pj_log_pop_indent();
+	pjsua_perror(THIS_FILE, "Unable to create account table", status);
+	pjsua_destroy();
+	return status;
+    }
     
     /* Create mutex */
     status = pj_mutex_create_recursive(pjsua_var.pool, "pjsua", 
@@ -1877,7 +1889,7 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Deinit media channel of all calls (see #1717) */
-	for (i=0; i<(int)pjsua_var.ua_cfg.max_calls; ++i) {
+	for (i=0; i<(int)pjsua_var.call_slots; ++i) {
 	    /* TODO: check if we're not allowed to send to network in the
 	     *       "flags", and if so do not do TURN allocation...
 	     */
@@ -1885,11 +1897,11 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Set all accounts to offline */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_slots; ++i) {
+	    if (!PJSUA_ACC(i).valid)
 		continue;
-	    pjsua_var.acc[i].online_status = PJ_FALSE;
-	    pj_bzero(&pjsua_var.acc[i].rpid, sizeof(pjrpid_element));
+	    PJSUA_ACC(i).online_status = PJ_FALSE;
+	    pj_bzero(&PJSUA_ACC(i).rpid, sizeof(pjrpid_element));
 	}
 
 	/* Terminate all presence subscriptions. */
@@ -1900,11 +1912,11 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	 */
 	/* First stage, get the maximum wait time */
 	max_wait = 100;
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_slots; ++i) {
+	    if (!PJSUA_ACC(i).valid)
 		continue;
-	    if (pjsua_var.acc[i].cfg.unpublish_max_wait_time_msec > max_wait)
-		max_wait = pjsua_var.acc[i].cfg.unpublish_max_wait_time_msec;
+	    if (PJSUA_ACC(i).cfg.unpublish_max_wait_time_msec > max_wait)
+		max_wait = PJSUA_ACC(i).cfg.unpublish_max_wait_time_msec;
 	}
 	
 	/* No waiting if RX is disabled */
@@ -1915,50 +1927,50 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	/* Second stage, wait for unpublications to complete */
 	for (i=0; i<(int)(max_wait/50); ++i) {
 	    unsigned j;
-	    for (j=0; j<PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
-		if (!pjsua_var.acc[j].valid)
+	    for (j=0; j<pjsua_var.acc_slots; ++j) {
+		if (!PJSUA_ACC(j).valid)
 		    continue;
 
-		if (pjsua_var.acc[j].publish_sess)
+		if (PJSUA_ACC(j).publish_sess)
 		    break;
 	    }
-	    if (j != PJ_ARRAY_SIZE(pjsua_var.acc))
+	    if (j != pjsua_var.acc_slots)
 		busy_sleep(50);
 	    else
 		break;
 	}
 
 	/* Third stage, forcefully destroy unfinished unpublications */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (pjsua_var.acc[i].publish_sess) {
-		pjsip_publishc_destroy(pjsua_var.acc[i].publish_sess);
-		pjsua_var.acc[i].publish_sess = NULL;
+	for (i=0; i<(int)pjsua_var.acc_slots; ++i) {
+	    if (PJSUA_ACC(i).publish_sess) {
+		pjsip_publishc_destroy(PJSUA_ACC(i).publish_sess);
+		PJSUA_ACC(i).publish_sess = NULL;
 	    }
 	}
 
 	/* Unregister all accounts */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_slots; ++i) {
+	    if (!PJSUA_ACC(i).valid)
 		continue;
 
-	    if (pjsua_var.acc[i].regc && (flags & PJSUA_DESTROY_NO_TX_MSG)==0)
+	    if (PJSUA_ACC(i).regc && (flags & PJSUA_DESTROY_NO_TX_MSG)==0)
 	    {
 		pjsua_acc_set_registration(i, PJ_FALSE);
 	    }
 #if PJ_HAS_SSL_SOCK
 	    pj_turn_sock_tls_cfg_wipe_keys(
-			      &pjsua_var.acc[i].cfg.turn_cfg.turn_tls_setting);
+			      &PJSUA_ACC(i).cfg.turn_cfg.turn_tls_setting);
 #endif
 	}
 
 	/* Wait until all unregistrations are done (ticket #364) */
 	/* First stage, get the maximum wait time */
 	max_wait = 100;
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (!pjsua_var.acc[i].valid)
+	for (i=0; i<(int)pjsua_var.acc_slots; ++i) {
+	    if (!PJSUA_ACC(i).valid)
 		continue;
-	    if (pjsua_var.acc[i].cfg.unreg_timeout > max_wait)
-		max_wait = pjsua_var.acc[i].cfg.unreg_timeout;
+	    if (PJSUA_ACC(i).cfg.unreg_timeout > max_wait)
+		max_wait = PJSUA_ACC(i).cfg.unreg_timeout;
 	}
 	
 	/* No waiting if RX is disabled */
@@ -1969,14 +1981,14 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	/* Second stage, wait for unregistrations to complete */
 	for (i=0; i<(int)(max_wait/50); ++i) {
 	    unsigned j;
-	    for (j=0; j<PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
-		if (!pjsua_var.acc[j].valid)
+	    for (j=0; j<pjsua_var.acc_slots; ++j) {
+		if (!PJSUA_ACC(j).valid)
 		    continue;
 
-		if (pjsua_var.acc[j].regc)
+		if (PJSUA_ACC(j).regc)
 		    break;
 	    }
-	    if (j != PJ_ARRAY_SIZE(pjsua_var.acc))
+	    if (j != pjsua_var.acc_slots)
 		busy_sleep(50);
 	    else
 		break;
@@ -2022,10 +2034,10 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
 	}
 
 	/* Destroy accounts */
-	for (i=0; i<(int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	    if (pjsua_var.acc[i].pool) {
-		pj_pool_release(pjsua_var.acc[i].pool);
-		pjsua_var.acc[i].pool = NULL;
+	for (i=0; i<(int)pjsua_var.acc_slots; ++i) {
+	    if (PJSUA_ACC(i).pool) {
+		pj_pool_release(PJSUA_ACC(i).pool);
+		PJSUA_ACC(i).pool = NULL;
 	    }
 	}
     }
@@ -3451,8 +3463,8 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
     pjmedia_endpt_dump(pjsua_get_pjmedia_endpt());
 
     PJ_LOG(3,(THIS_FILE, "Dumping media transports:"));
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-	pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_slots; ++i) {
+	pjsua_call *call = &PJSUA_CALL(i);
 	pjsua_acc_config *acc_cfg;
 	pjmedia_transport *tp[PJSUA_MAX_CALL_MEDIA*2];
 	unsigned tp_cnt = 0;
@@ -3479,7 +3491,7 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
 	    }
 	}
 
-	acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+	acc_cfg = &PJSUA_ACC(call->acc_id).cfg;
 
 	/* Dump the media transports in this call */
 	for (j = 0; j < tp_cnt; ++j) {
@@ -3512,7 +3524,7 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
     } else {
 	unsigned i;
 
-	for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
+	for (i=0; i<pjsua_var.call_slots; ++i) {
 	    if (pjsua_call_is_active(i)) {
 		/* Tricky logging, since call states log string tends to be 
 		 * longer than PJ_LOG_MAX_SIZE.
@@ -3568,7 +3580,9 @@ static pj_status_t handle_ip_change_on_acc()
 {
     int i = 0;
     pj_status_t status = PJ_SUCCESS;
-    pj_bool_t acc_done[PJSUA_MAX_ACC];
+    pj_pool_t *tmp_pool;
+    pj_bool_t *acc_done;
+    pjsua_acc_id *shut_acc_ids;
 
     PJSUA_LOCK();
 
@@ -3580,19 +3594,26 @@ static pj_status_t handle_ip_change_on_acc()
 	return status;
     }
 
+    /* Sized by the account table, it grows up to PJSUA_MAX_ACC */
+    tmp_pool = pjsua_pool_create("tmpipchg%p", 512, 512);
+    acc_done = (pj_bool_t*)pj_pool_calloc(tmp_pool, pjsua_var.acc_slots,
+					  sizeof(pj_bool_t));
+    shut_acc_ids = (pjsua_acc_id*)pj_pool_calloc(tmp_pool,
+						 pjsua_var.acc_slots,
+						 sizeof(pjsua_acc_id));
+
     /* Reset ip_change_active flag. */
-    for (; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	pjsua_var.acc[i].ip_change_op = PJSUA_IP_CHANGE_OP_NULL;
+    for (; i < (int)pjsua_var.acc_slots; ++i) {
+	PJSUA_ACC(i).ip_change_op = PJSUA_IP_CHANGE_OP_NULL;
 	acc_done[i] = PJ_FALSE;
     }
 
-    for (i = 0; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
+    for (i = 0; i < (int)pjsua_var.acc_slots; ++i) {
 	pj_bool_t shutdown_transport = PJ_FALSE;
 	pjsip_regc_info regc_info;
-	char acc_id[PJSUA_MAX_ACC * 4];
-	pjsua_acc *acc = &pjsua_var.acc[i];
+	char acc_id[128];
+	pjsua_acc *acc = &PJSUA_ACC(i);
 	pjsip_transport *transport = NULL;
-	pjsua_acc_id shut_acc_ids[PJSUA_MAX_ACC];
 	unsigned shut_acc_cnt = 0;
 
 	if (!acc->valid || (acc_done[i]))
@@ -3663,9 +3684,9 @@ static pj_status_t handle_ip_change_on_acc()
 	    unsigned j = i + 1;
 
 	    /* Find other account that uses the same transport. */
-	    for (; j < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++j) {
+	    for (; j < (int)pjsua_var.acc_slots; ++j) {
 		pjsip_regc_info tmp_regc_info;
-		pjsua_acc *next_acc = &pjsua_var.acc[j];
+		pjsua_acc *next_acc = &PJSUA_ACC(j);
 
 		if (!next_acc->valid || !next_acc->regc ||
 		    (next_acc->ip_change_op > PJSUA_IP_CHANGE_OP_NULL))
@@ -3675,7 +3696,7 @@ static pj_status_t handle_ip_change_on_acc()
 
 		pjsip_regc_get_info(next_acc->regc, &tmp_regc_info);
 		if (transport == tmp_regc_info.transport) {
-                    char tmp_buf[4];
+                    char tmp_buf[12];
 
                     pj_ansi_snprintf(tmp_buf, sizeof(tmp_buf), " #%d", j);
                     if (pj_ansi_strlen(acc_id) + pj_ansi_strlen(tmp_buf) <
@@ -3700,7 +3721,7 @@ static pj_status_t handle_ip_change_on_acc()
 		       "triggered by IP change", transport->obj_name, acc_id));
 
 	    for (j = 0; j < shut_acc_cnt; ++j) {
-		pjsua_acc *tmp_acc = &pjsua_var.acc[shut_acc_ids[j]];
+		pjsua_acc *tmp_acc = &PJSUA_ACC(shut_acc_ids[j]);
 		tmp_acc->ip_change_op = PJSUA_IP_CHANGE_OP_ACC_SHUTDOWN_TP;
 		acc_done[shut_acc_ids[j]] = PJ_TRUE;
 	    }
@@ -3715,6 +3736,7 @@ static pj_status_t handle_ip_change_on_acc()
 	    }
 	}
     }
+    pj_pool_release(tmp_pool);
     PJSUA_UNLOCK();
     return status;
 }
@@ -3825,10 +3847,10 @@ PJ_DEF(pj_status_t) pjsua_handle_ip_change(const pjsua_ip_change_param *param)
 
     PJ_ASSERT_RETURN(param, PJ_EINVAL);
 
-    for (; i < (int)PJ_ARRAY_SIZE(pjsua_var.acc); ++i) {
-	if (pjsua_var.acc[i].valid &&
-	    pjsua_var.acc[i].ip_change_op != PJSUA_IP_CHANGE_OP_NULL &&
-	    pjsua_var.acc[i].ip_change_op != PJSUA_IP_CHANGE_OP_COMPLETED)
+    for (; i < (int)pjsua_var.acc_slots; ++i) {
+	if (PJSUA_ACC(i).valid &&
+	    PJSUA_ACC(i).ip_change_op != PJSUA_IP_CHANGE_OP_NULL &&
+	    PJSUA_ACC(i).ip_change_op != PJSUA_IP_CHANGE_OP_COMPLETED)
 	{
 	    PJ_LOG(2, (THIS_FILE,
 		     "Previous IP address change handling still in progress"));
@@ -907,13 +907,13 @@ void print_call(const char *title,
 	        char *buf, pj_size_t size)
 {
     int len;
-    pjsip_inv_session *inv = pjsua_var.calls[call_id].inv;
+    pjsip_inv_session *inv = PJSUA_CALL(call_id).inv;
     pjsip_dialog *dlg;
     char userinfo[PJSIP_MAX_URL_SIZE];
 
     /* Dump invite sesion info. */
 
-    dlg = (inv? inv->dlg: pjsua_var.calls[call_id].async_call.dlg);
+    dlg = (inv? inv->dlg: PJSUA_CALL(call_id).async_call.dlg);
     len = pjsip_hdr_print_on(dlg->remote.info, userinfo, sizeof(userinfo));
     if (len < 0)
 	pj_ansi_strcpy(userinfo, "<--uri too long-->");
@@ -950,7 +950,7 @@ PJ_DEF(pj_status_t) pjsua_call_dump( pjsua_call_id call_id,
     pj_status_t status;
     int len;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
 		     PJ_EINVAL);
 
     status = acquire_call("pjsua_call_dump()", call_id, &call, &dlg);
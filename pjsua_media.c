@@ -145,7 +145,7 @@ pj_status_t pjsua_media_subsys_start(void)
 
 #if DISABLED_FOR_TICKET_1185
     /* Create media for calls, if none is specified */
-    if (pjsua_var.calls[0].media[0].tp == NULL) {
+    if (PJSUA_CALL(0).media[0].tp == NULL) {
     pjsua_transport_config transport_cfg;
 
     /* Create default transport config */
@@ -212,7 +212,7 @@ pj_status_t pjsua_media_subsys_destroy(unsigned flags)
 #if 0
     // This part has been moved out to pjsua_destroy() (see also #1717).
     /* Close media transports */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
+    for (i=0; i<pjsua_var.call_slots; ++i) {
         /* TODO: check if we're not allowed to send to network in the
          *       "flags", and if so do not do TURN allocation...
          */
@@ -249,6 +249,36 @@ pj_status_t pjsua_media_subsys_destroy(unsigned flags)
  * Create RTP and RTCP socket pair, and possibly resolve their public
  * address via STUN.
  */
+/* Reserve the next RTP/RTCP port pair of the account, 0 for a random
+ * port. Calls of one account are set up concurrently, so the cursor is
+ * only moved under the pjsua lock, the sockets are bound outside it.
+ */
+static pj_uint16_t reserve_rtp_port(pjsua_acc *acc,
+                                    const pjsua_transport_config *cfg)
+{
+    pj_uint16_t port;
+
+    PJSUA_LOCK();
+
+    if (acc->next_rtp_port == 0 || cfg->port == 0)
+    acc->next_rtp_port = (pj_uint16_t)cfg->port;
+
+    if (cfg->port > 0 && cfg->port_range > 0 &&
+        (acc->next_rtp_port > cfg->port + cfg->port_range ||
+         acc->next_rtp_port < cfg->port))
+    {
+        acc->next_rtp_port = (pj_uint16_t)cfg->port;
+    }
+
+    port = acc->next_rtp_port;
+    if (port != 0)
+    acc->next_rtp_port += 2;
+
+    PJSUA_UNLOCK();
+
+    return port;
+}
+
 static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
                     const pjsua_transport_config *cfg,
                     pjmedia_sock_info *skinfo)
@@ -263,8 +293,9 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
     pj_sockaddr mapped_addr[2];
     pj_status_t status = PJ_SUCCESS;
     char addr_buf[PJ_INET6_ADDRSTRLEN+10];
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(call_med->call->acc_id);
     pj_sock_t sock[2];
+    pj_uint16_t rtp_port = 0;
 
     use_ipv6 = (acc->cfg.ipv6_media_use != PJSUA_IPV6_DISABLED);
     use_nat64 = (acc->cfg.nat64_opt != PJSUA_NAT64_DISABLED);
@@ -285,9 +316,6 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
     }
     }
 
-    if (acc->next_rtp_port == 0 || cfg->port == 0)
-    acc->next_rtp_port = (pj_uint16_t)cfg->port;
-
     for (i=0; i<2; ++i)
     sock[i] = PJ_INVALID_SOCKET;
 
@@ -302,14 +330,9 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
     }
 
     /* Loop retry to bind RTP and RTCP sockets. */
-    for (i=0; i<RTP_RETRY; ++i, acc->next_rtp_port += 2) {
+    for (i=0; i<RTP_RETRY; ++i) {
 
-        if (cfg->port > 0 && cfg->port_range > 0 &&
-            (acc->next_rtp_port > cfg->port + cfg->port_range ||
-             acc->next_rtp_port < cfg->port))
-        {
-            acc->next_rtp_port = (pj_uint16_t)cfg->port;
-        }
+        rtp_port = reserve_rtp_port(acc, cfg);
 
     /* Create RTP socket. */
     status = pj_sock_socket(af, pj_SOCK_DGRAM(), 0, &sock[0]);
@@ -328,7 +351,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
         status = pj_sock_setsockopt_params(sock[0], &cfg->sockopt_params);
 
     /* Bind RTP socket */
-    pj_sockaddr_set_port(&bound_addr, acc->next_rtp_port);
+    pj_sockaddr_set_port(&bound_addr, rtp_port);
     status=pj_sock_bind(sock[0], &bound_addr,
                         pj_sockaddr_get_len(&bound_addr));
     if (status != PJ_SUCCESS) {
@@ -338,7 +361,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
     }
     
     /* If bound to random port, find out the port number. */
-    if (acc->next_rtp_port == 0) {
+    if (rtp_port == 0) {
         pj_sockaddr sock_addr;
         int addr_len = sizeof(pj_sockaddr);
 
@@ -348,7 +371,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
             pj_sock_close(sock[0]);
             return status;
         }
-        acc->next_rtp_port = pj_sockaddr_get_port(&sock_addr);
+        rtp_port = pj_sockaddr_get_port(&sock_addr);
     }
 
     /* Create RTCP socket. */
@@ -369,7 +392,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
         status = pj_sock_setsockopt_params(sock[1], &cfg->sockopt_params);
 
     /* Bind RTCP socket */
-    pj_sockaddr_set_port(&bound_addr, (pj_uint16_t)(acc->next_rtp_port+1));
+    pj_sockaddr_set_port(&bound_addr, (pj_uint16_t)(rtp_port+1));
     status=pj_sock_bind(sock[1], &bound_addr,
                         pj_sockaddr_get_len(&bound_addr));
     if (status != PJ_SUCCESS) {
@@ -499,7 +522,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
             pj_sockaddr_init(af, &mapped_addr[i], NULL, 0);
             pj_sockaddr_copy_addr(&mapped_addr[i], &bound_addr);
             pj_sockaddr_set_port(&mapped_addr[i],
-                     (pj_uint16_t)(acc->next_rtp_port+i));
+                     (pj_uint16_t)(rtp_port+i));
         }
         break;
         }
@@ -537,12 +560,12 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
     } else if (cfg->public_addr.slen) {
 
         status = pj_sockaddr_init(af, &mapped_addr[0], &cfg->public_addr,
-                      (pj_uint16_t)acc->next_rtp_port);
+                      (pj_uint16_t)rtp_port);
         if (status != PJ_SUCCESS)
         goto on_error;
 
         status = pj_sockaddr_init(af, &mapped_addr[1], &cfg->public_addr,
-                      (pj_uint16_t)(acc->next_rtp_port+1));
+                      (pj_uint16_t)(rtp_port+1));
         if (status != PJ_SUCCESS)
         goto on_error;
 
@@ -578,7 +601,7 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
         pj_sockaddr_init(af, &mapped_addr[i], NULL, 0);
         pj_sockaddr_copy_addr(&mapped_addr[i], &bound_addr);
         pj_sockaddr_set_port(&mapped_addr[i],
-                             (pj_uint16_t)(acc->next_rtp_port+i));
+                             (pj_uint16_t)(rtp_port+i));
         }
 
         break;
@@ -606,7 +629,6 @@ static pj_status_t create_rtp_rtcp_sock(pjsua_call_media *call_med,
           pj_sockaddr_print(&skinfo->rtcp_addr_name, addr_buf,
                 sizeof(addr_buf), 3)));
 
-    acc->next_rtp_port += 2;
     return PJ_SUCCESS;
 
 on_error:
@@ -665,7 +687,7 @@ static pj_status_t create_loop_media_transport(
     pjmedia_loop_tp_setting opt;
     pj_bool_t use_ipv6, use_nat64;
     int af;
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(call_med->call->acc_id);
 
     use_ipv6 = (acc->cfg.ipv6_media_use != PJSUA_IPV6_DISABLED);
     use_nat64 = (acc->cfg.nat64_opt != PJSUA_NAT64_DISABLED);
@@ -676,7 +698,7 @@ static pj_status_t create_loop_media_transport(
     if (cfg->bound_addr.slen)
         opt.addr = cfg->bound_addr;
     opt.port = cfg->port;
-    opt.disable_rx=!pjsua_var.acc[call_med->call->acc_id].cfg.enable_loopback;
+    opt.disable_rx=!PJSUA_ACC(call_med->call->acc_id).cfg.enable_loopback;
     status = pjmedia_transport_loop_create2(pjsua_var.med_endpt, &opt,
                             &call_med->tp);
     if (status != PJ_SUCCESS) {
@@ -709,8 +731,8 @@ static pj_status_t create_udp_media_transports(pjsua_transport_config *cfg)
     unsigned i;
     pj_status_t status;
 
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -725,8 +747,8 @@ static pj_status_t create_udp_media_transports(pjsua_transport_config *cfg)
     return PJ_SUCCESS;
 
 on_error:
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -906,7 +928,7 @@ static pj_status_t create_ice_media_transport(
     pj_status_t status;
     pj_bool_t use_ipv6, use_nat64;
 
-    acc_cfg = &pjsua_var.acc[call_med->call->acc_id].cfg;
+    acc_cfg = &PJSUA_ACC(call_med->call->acc_id).cfg;
     use_ipv6 = (acc_cfg->ipv6_media_use != PJSUA_IPV6_DISABLED);
     use_nat64 = (acc_cfg->nat64_opt != PJSUA_NAT64_DISABLED);
 
@@ -1175,8 +1197,8 @@ static pj_status_t create_ice_media_transports(pjsua_transport_config *cfg)
     unsigned i;
     pj_status_t status;
 
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1191,8 +1213,8 @@ static pj_status_t create_ice_media_transports(pjsua_transport_config *cfg)
     return PJ_SUCCESS;
 
 on_error:
-    for (i=0; i < pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i < pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1227,8 +1249,8 @@ PJ_DEF(pj_status_t) pjsua_media_transports_create(
     PJSUA_LOCK();
 
     /* Delete existing media transports */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1253,8 +1275,8 @@ PJ_DEF(pj_status_t) pjsua_media_transports_create(
     }
 
     /* Set media transport auto_delete to True */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1281,8 +1303,8 @@ PJ_DEF(pj_status_t) pjsua_media_transports_attach(pjsua_media_transport tp[],
     PJ_ASSERT_RETURN(tp && count==pjsua_var.ua_cfg.max_calls, PJ_EINVAL);
 
     /* Assign the media transports */
-    for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
-    pjsua_call *call = &pjsua_var.calls[i];
+    for (i=0; i<pjsua_var.call_slots; ++i) {
+    pjsua_call *call = &PJSUA_CALL(i);
     unsigned strm_idx;
 
     for (strm_idx=0; strm_idx < call->med_cnt; ++strm_idx) {
@@ -1683,7 +1705,7 @@ static pj_status_t call_media_init_cb(pjsua_call_media *call_med,
                                       int security_level,
                                       int *sip_err_code)
 {
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(call_med->call->acc_id);
     pjmedia_transport_info tpinfo;
     int err_code = 0;
 
@@ -1868,7 +1890,7 @@ pj_status_t pjsua_call_media_init(pjsua_call_media *call_med,
      *   the unused transport of a disabled media.
      */
     if (call_med->tp == NULL) {
-        pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+        pjsua_acc *acc = &PJSUA_ACC(call_med->call->acc_id);
 
         /* Initializations. If media transport creation completes immediately, 
          * we don't need to call the callbacks.
@@ -1930,7 +1952,7 @@ pj_status_t pjsua_call_media_init(pjsua_call_media *call_med,
 static pj_status_t media_channel_init_cb(pjsua_call_id call_id,
                                          const pjsua_med_tp_state_info *info)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     pj_status_t status = (info? info->status : PJ_SUCCESS);
     unsigned mi;
 
@@ -2046,7 +2068,7 @@ on_return:
  */
 void pjsua_media_prov_clean_up(pjsua_call_id call_id)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     unsigned i;
 
     if (call->med_prov_cnt > call->med_cnt) {
@@ -2096,8 +2118,8 @@ pj_status_t pjsua_media_channel_init(pjsua_call_id call_id,
 {
     const pj_str_t STR_AUDIO = { "audio", 5 };
     const pj_str_t STR_VIDEO = { "video", 5 };
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
+    pjsua_acc *acc = &PJSUA_ACC(call->acc_id);
     pj_uint8_t maudidx[PJSUA_MAX_CALL_MEDIA];
     unsigned maudcnt = PJ_ARRAY_SIZE(maudidx);
     unsigned mtotaudcnt = PJ_ARRAY_SIZE(maudidx);
@@ -2462,8 +2484,8 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
     enum { MAX_MEDIA = PJSUA_MAX_CALL_MEDIA };
     pjmedia_sdp_session *sdp;
     pj_sockaddr origin;
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
+    pjsua_acc *acc = &PJSUA_ACC(call->acc_id);
     pjmedia_sdp_neg_state sdp_neg_state = PJMEDIA_SDP_NEG_STATE_NULL;
     unsigned mi;
     unsigned tot_bandw_tias = 0;
@@ -2619,9 +2641,9 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
         pj_bool_t use_ipv6;
         pj_bool_t use_nat64;
 
-        use_ipv6 = (pjsua_var.acc[call->acc_id].cfg.ipv6_media_use !=
+        use_ipv6 = (PJSUA_ACC(call->acc_id).cfg.ipv6_media_use !=
                 PJSUA_IPV6_DISABLED);
-        use_nat64 = (pjsua_var.acc[call->acc_id].cfg.nat64_opt !=
+        use_nat64 = (PJSUA_ACC(call->acc_id).cfg.nat64_opt !=
                  PJSUA_NAT64_DISABLED);
 
         m->conn = PJ_POOL_ZALLOC_T(pool, pjmedia_sdp_conn);
@@ -2830,8 +2852,8 @@ pj_status_t pjsua_media_channel_create_sdp(pjsua_call_id call_id,
      * media, i.e: secured and unsecured version, in the SDP offer.
      */
     if (!rem_sdp &&
-    pjsua_var.acc[call->acc_id].cfg.use_srtp == PJMEDIA_SRTP_OPTIONAL &&
-    pjsua_var.acc[call->acc_id].cfg.srtp_optional_dup_offer)
+    PJSUA_ACC(call->acc_id).cfg.use_srtp == PJMEDIA_SRTP_OPTIONAL &&
+    PJSUA_ACC(call->acc_id).cfg.srtp_optional_dup_offer)
     {
     unsigned i;
 
@@ -2962,7 +2984,7 @@ static void stop_media_stream(pjsua_call *call, unsigned med_idx)
 
 static void stop_media_session(pjsua_call_id call_id)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     unsigned mi;
 
     for (mi=0; mi<call->med_cnt; ++mi) {
@@ -2972,7 +2994,7 @@ static void stop_media_session(pjsua_call_id call_id)
 
 pj_status_t pjsua_media_channel_deinit(pjsua_call_id call_id)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     unsigned mi;
 
     for (mi=0; mi<call->med_cnt; ++mi) {
@@ -3216,8 +3238,8 @@ pj_status_t pjsua_media_channel_update(pjsua_call_id call_id,
                        const pjmedia_sdp_session *local_sdp,
                        const pjmedia_sdp_session *remote_sdp)
 {
-    pjsua_call *call = &pjsua_var.calls[call_id];
-    pjsua_acc *acc = &pjsua_var.acc[call->acc_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
+    pjsua_acc *acc = &PJSUA_ACC(call->acc_id);
     pj_pool_t *tmp_pool = call->inv->pool_prov;
     unsigned mi;
     pj_bool_t got_media = PJ_FALSE;
@@ -3877,7 +3899,7 @@ pj_status_t pjsua_media_apply_xml_control(pjsua_call_id call_id,
                       const pj_str_t *xml_st)
 {
 #if PJMEDIA_HAS_VIDEO
-    pjsua_call *call = &pjsua_var.calls[call_id];
+    pjsua_call *call = &PJSUA_CALL(call_id);
     const pj_str_t PICT_FAST_UPDATE = {"picture_fast_update", 19};
 
     if (pj_strstr(xml_st, &PICT_FAST_UPDATE)) {
@@ -911,7 +911,7 @@ static void dec_vid_win(pjsua_vid_win_id wid)
 /* Initialize video call media */
 pj_status_t pjsua_vid_channel_init(pjsua_call_media *call_med)
 {
-    pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc = &PJSUA_ACC(call_med->call->acc_id);
 
     call_med->strm.v.rdr_dev = acc->cfg.vid_rend_dev;
     call_med->strm.v.cap_dev = acc->cfg.vid_cap_dev;
@@ -933,7 +933,7 @@ pj_status_t pjsua_vid_channel_init(pjsua_call_media *call_med)
 
 static pj_status_t setup_vid_capture(pjsua_call_media *call_med)
 {
-    pjsua_acc *acc_enc = &pjsua_var.acc[call_med->call->acc_id];
+    pjsua_acc *acc_enc = &PJSUA_ACC(call_med->call->acc_id);
     pjmedia_port *media_port;
     pjsua_vid_win *w;
     pjsua_vid_win_id wid;
@@ -1017,7 +1017,7 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
                      const pjmedia_sdp_session *remote_sdp)
 {
     pjsua_call *call = call_med->call;
-    pjsua_acc  *acc  = &pjsua_var.acc[call->acc_id];
+    pjsua_acc  *acc  = &PJSUA_ACC(call->acc_id);
     pjmedia_port *media_port;
     pj_status_t status;
  
@@ -1061,7 +1061,7 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
 
 #if defined(PJMEDIA_STREAM_ENABLE_KA) && PJMEDIA_STREAM_ENABLE_KA!=0
     /* Enable/disable stream keep-alive and NAT hole punch. */
-    si->use_ka = pjsua_var.acc[call->acc_id].cfg.use_stream_ka;
+    si->use_ka = PJSUA_ACC(call->acc_id).cfg.use_stream_ka;
 #endif
 
     /* Try to get shared format ID between the capture device and 
@@ -1132,7 +1132,17 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
         goto on_error;
         }
 
-        /* Create stream video window */
+        /* Create stream video window. Only the window table needs the
+         * pjsua lock, the window is owned by the stream once its id is
+         * set and is released by pjsua_vid_stop_stream(), which also
+         * cleans up a half done setup.
+         *
+         * The lock is recursive: when the SDP is negotiated on an answer,
+         * pjsua_call_on_incoming() and pjsua_call_answer2() already hold
+         * it and the rest of the setup stays under it. Only plays, whose
+         * answer is negotiated on the endpoint thread without the lock,
+         * run the conference and renderer setup unlocked.
+         */
         PJSUA_LOCK();
         status = create_vid_win(PJSUA_WND_TYPE_STREAM,
                     &media_port->info.fmt,
@@ -1149,7 +1159,10 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
         goto on_error;
         }
 
+        inc_vid_win(wid);
+        call_med->strm.v.rdr_win_id = wid;
         w = &pjsua_var.win[wid];
+        PJSUA_UNLOCK();
 
 #if ENABLE_EVENT
         /* Register to video events */
@@ -1164,11 +1177,11 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
 
         /* Register stream decoding to conf, using tmp_pool should be fine
          * as bridge will create its own pool (using tmp_pool factory).
+         * The video conference has its own mutex.
          */
         status = pjsua_vid_conf_add_port(tmp_pool, media_port, NULL,
                          &call_med->strm.v.strm_dec_slot);
         if (status != PJ_SUCCESS) {
-            PJSUA_UNLOCK();
         pj_log_pop_indent();
         goto on_error;
         }
@@ -1177,7 +1190,6 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
         status = pjsua_vid_conf_connect(call_med->strm.v.strm_dec_slot,
                         w->rend_slot, NULL);
         if (status != PJ_SUCCESS) {
-        PJSUA_UNLOCK();
         pj_log_pop_indent();
         goto on_error;
         }
@@ -1185,15 +1197,11 @@ pj_status_t pjsua_vid_channel_update(pjsua_call_media *call_med,
         /* Start renderer */
         status = pjmedia_vid_port_start(w->vp_rend);
         if (status != PJ_SUCCESS) {
-            PJSUA_UNLOCK();
         pj_log_pop_indent();
         goto on_error;
         }
 
         /* Done */
-        inc_vid_win(wid);
-        call_med->strm.v.rdr_win_id = wid;
-        PJSUA_UNLOCK();
         pj_log_pop_indent();
     }
 
@@ -1865,7 +1873,7 @@ static pj_status_t call_add_video(pjsua_call *call,
                   pjmedia_dir dir)
 {
     pj_pool_t *pool = call->inv->pool_prov;
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(call->acc_id).cfg;
     pjsua_call_media *call_med;
     const pjmedia_sdp_session *current_sdp;
     pjmedia_sdp_session *sdp;
@@ -2034,7 +2042,7 @@ static pj_status_t call_modify_video(pjsua_call *call,
     pj_assert(med_idx < (int)sdp->media_count);
 
     if (!remove) {
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(call->acc_id).cfg;
     pj_pool_t *pool = call->inv->pool_prov;
     pjmedia_sdp_media *sdp_m;
 
@@ -2241,7 +2249,7 @@ static pj_status_t call_change_cap_dev(pjsua_call *call,
      */
     new_wid = vid_preview_get_win(cap_dev, PJ_FALSE);
     if (new_wid == PJSUA_INVALID_ID) {
-        pjsua_acc *acc = &pjsua_var.acc[call_med->call->acc_id];
+        pjsua_acc *acc = &PJSUA_ACC(call_med->call->acc_id);
 
     /* Create preview video window */
     status = create_vid_win(PJSUA_WND_TYPE_PREVIEW,
@@ -2440,7 +2448,7 @@ PJ_DEF(pj_status_t) pjsua_call_set_vid_strm (
     pjsua_call_vid_strm_op_param param_;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
              PJ_EINVAL);
     PJ_ASSERT_RETURN(op != PJSUA_CALL_VID_STRM_NO_OP, PJ_EINVAL);
 
@@ -2462,7 +2470,7 @@ PJ_DEF(pj_status_t) pjsua_call_set_vid_strm (
      * account default video capture device.
      */
     if (param_.cap_dev == PJMEDIA_VID_DEFAULT_CAPTURE_DEV) {
-    pjsua_acc_config *acc_cfg = &pjsua_var.acc[call->acc_id].cfg;
+    pjsua_acc_config *acc_cfg = &PJSUA_ACC(call->acc_id).cfg;
     param_.cap_dev = acc_cfg->vid_cap_dev;
     
     /* If the account default video capture device is
@@ -2520,11 +2528,11 @@ PJ_DEF(int) pjsua_call_get_vid_stream_idx(pjsua_call_id call_id)
     pjsua_call *call;
     int first_active, first_inactive;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
              PJ_EINVAL);
 
     PJSUA_LOCK();
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
     call_get_vid_strm_info(call, &first_active, &first_inactive, NULL, NULL);
     PJSUA_UNLOCK();
 
@@ -2546,7 +2554,7 @@ PJ_DEF(pj_bool_t) pjsua_call_vid_stream_is_running( pjsua_call_id call_id,
     pjsua_call *call;
     pjsua_call_media *call_med;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
              PJ_EINVAL);
 
     /* Verify and normalize media index */
@@ -2554,7 +2562,7 @@ PJ_DEF(pj_bool_t) pjsua_call_vid_stream_is_running( pjsua_call_id call_id,
     med_idx = pjsua_call_get_vid_stream_idx(call_id);
     }
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
     PJ_ASSERT_RETURN(med_idx >= 0 && med_idx < (int)call->med_cnt, PJ_EINVAL);
 
     call_med = &call->media[med_idx];
@@ -2695,7 +2703,7 @@ PJ_DEF(pjsua_vid_win_id) pjsua_call_get_vid_win(pjsua_call_id call_id)
     pjsua_vid_win_id wid = PJSUA_INVALID_ID;
     unsigned i;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
              PJ_EINVAL);
 
     /* Use PJSUA_LOCK() instead of acquire_call():
@@ -2706,7 +2714,7 @@ PJ_DEF(pjsua_vid_win_id) pjsua_call_get_vid_win(pjsua_call_id call_id)
     if (!pjsua_call_is_active(call_id))
     goto on_return;
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
     for (i = 0; i < call->med_cnt; ++i) {
     if (call->media[i].type == PJMEDIA_TYPE_VIDEO &&
         (call->media[i].dir & PJMEDIA_DIR_DECODING))
@@ -2734,7 +2742,7 @@ PJ_DEF(pjsua_conf_port_id) pjsua_call_get_vid_conf_port(
     pjsua_conf_port_id port_id = PJSUA_INVALID_ID;
     unsigned i;
 
-    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.ua_cfg.max_calls,
+    PJ_ASSERT_RETURN(call_id>=0 && call_id<(int)pjsua_var.call_slots,
              PJ_EINVAL);
     PJ_ASSERT_RETURN(dir==PJMEDIA_DIR_ENCODING || dir==PJMEDIA_DIR_DECODING,
              PJ_EINVAL);
@@ -2747,7 +2755,7 @@ PJ_DEF(pjsua_conf_port_id) pjsua_call_get_vid_conf_port(
     if (!pjsua_call_is_active(call_id))
     goto on_return;
 
-    call = &pjsua_var.calls[call_id];
+    call = &PJSUA_CALL(call_id);
     for (i = 0; i < call->med_cnt; ++i) {
     if (call->media[i].type == PJMEDIA_TYPE_VIDEO &&
         (call->media[i].dir & dir))
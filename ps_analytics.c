@@ -0,0 +1,303 @@
+#include "include/ps_analytics.h"
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/string.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <libyuv.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+#define THIS_FILE   "ps_analytics.c"
+
+#define DARK_LUMA       32
+
+struct ps_analytics_grid {
+    int         width;
+    int         height;
+    pj_uint8_t  *cur;
+    pj_uint8_t  *prev;
+    pj_bool_t   has_prev;
+};
+
+pj_status_t ps_analytics_grid_create(int width, ps_analytics_grid **p_grid)
+{
+    ps_analytics_grid *grid;
+
+    /* row sums of the kernels are 32 bits */
+    PJ_ASSERT_RETURN(width >= 8 && width <= 1024 && p_grid, PJ_EINVAL);
+
+    grid = (ps_analytics_grid*)calloc(1, sizeof(*grid));
+    if (grid == NULL) {
+        return PJ_ENOMEM;
+    }
+    grid->width = width;
+
+    *p_grid = grid;
+
+    return PJ_SUCCESS;
+}
+
+void ps_analytics_grid_destroy(ps_analytics_grid *grid)
+{
+    if (grid) {
+        free(grid->cur);
+        free(grid->prev);
+        free(grid);
+    }
+}
+
+/* The package is built with -Og, which does not vectorize, so the row
+ * kernels use sse2 directly with a scalar tail.
+ */
+#if defined(__SSE2__)
+/* Sum of the four 32 bit lanes */
+static pj_uint32_t hsum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return (pj_uint32_t)_mm_cvtsi128_si32(v);
+}
+
+/* Sum of the two 64 bit lanes of _mm_sad_epu8 */
+static pj_uint32_t hsum_sad(__m128i v)
+{
+    return (pj_uint32_t)_mm_cvtsi128_si32(_mm_add_epi32(v, _mm_srli_si128(v, 8)));
+}
+#endif
+
+/* Sum of abs differences, counting the cells above thresh */
+static pj_uint32_t sad_row(const pj_uint8_t *a, const pj_uint8_t *b,
+                           int n, int thresh, pj_uint32_t *changed)
+{
+    pj_uint32_t sad = 0, cnt = 0;
+    int x = 0;
+
+#if defined(__SSE2__)
+    if (thresh >= 0 && thresh <= 255) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i t = _mm_set1_epi8((char)thresh);
+        __m128i sad_acc = zero, cnt_acc = zero;
+
+        for (; x + 16 <= n; x += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            /* d > thresh where d - thresh does not saturate to 0 */
+            __m128i le = _mm_cmpeq_epi8(_mm_subs_epu8(d, t), zero);
+
+            sad_acc = _mm_add_epi64(sad_acc, _mm_sad_epu8(va, vb));
+            cnt_acc = _mm_add_epi64(cnt_acc, _mm_sad_epu8(_mm_andnot_si128(le, one), zero));
+        }
+        sad = hsum_sad(sad_acc);
+        cnt = hsum_sad(cnt_acc);
+    }
+#endif
+
+    for (; x < n; ++x) {
+        int d = a[x] - b[x];
+        d = d < 0 ? -d : d;
+        sad += d;
+        cnt += d > thresh;
+    }
+    *changed += cnt;
+
+    return sad;
+}
+
+/* Sum and sum of squares of a row */
+static void moments_row(const pj_uint8_t *a, int n,
+                        pj_uint64_t *sum, pj_uint64_t *sum_sq,
+                        pj_uint32_t *dark)
+{
+    pj_uint32_t s = 0, sq = 0, dk = 0;
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i dark_max = _mm_set1_epi8(DARK_LUMA - 1);
+    __m128i s_acc = zero, sq_acc = zero, dk_acc = zero;
+
+    for (; x + 16 <= n; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(a + x));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        /* v < DARK_LUMA where v is its own minimum with DARK_LUMA - 1 */
+        __m128i is_dark = _mm_cmpeq_epi8(_mm_min_epu8(v, dark_max), v);
+
+        s_acc = _mm_add_epi64(s_acc, _mm_sad_epu8(v, zero));
+        sq_acc = _mm_add_epi32(sq_acc, _mm_madd_epi16(lo, lo));
+        sq_acc = _mm_add_epi32(sq_acc, _mm_madd_epi16(hi, hi));
+        dk_acc = _mm_add_epi64(dk_acc, _mm_sad_epu8(_mm_and_si128(is_dark, one), zero));
+    }
+    s = hsum_sad(s_acc);
+    sq = hsum_epi32(sq_acc);
+    dk = hsum_sad(dk_acc);
+#endif
+
+    for (; x < n; ++x) {
+        pj_uint32_t v = a[x];
+        s += v;
+        sq += v * v;
+        dk += v < DARK_LUMA;
+    }
+    *sum += s;
+    *sum_sq += sq;
+    *dark += dk;
+}
+
+/* 4 neighbour laplacian of the inner cells of row y */
+static void laplacian_row(const pj_uint8_t *up, const pj_uint8_t *mid,
+                          const pj_uint8_t *down, int n,
+                          pj_int64_t *sum, pj_uint64_t *sum_sq)
+{
+    pj_int32_t s = 0;
+    pj_uint32_t sq = 0;
+    int x = 1;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i s_acc = zero, sq_acc = zero;
+
+#define LOAD8(p)    _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), zero)
+
+    /* 8 cells at a time, the laplacian fits 16 bits */
+    for (; x + 8 <= n - 1; x += 8) {
+        __m128i l = _mm_slli_epi16(LOAD8(mid + x), 2);
+
+        l = _mm_sub_epi16(l, LOAD8(mid + x - 1));
+        l = _mm_sub_epi16(l, LOAD8(mid + x + 1));
+        l = _mm_sub_epi16(l, LOAD8(up + x));
+        l = _mm_sub_epi16(l, LOAD8(down + x));
+
+        s_acc = _mm_add_epi32(s_acc, _mm_madd_epi16(l, ones));
+        sq_acc = _mm_add_epi32(sq_acc, _mm_madd_epi16(l, l));
+    }
+
+#undef LOAD8
+
+    s = (pj_int32_t)hsum_epi32(s_acc);
+    sq = hsum_epi32(sq_acc);
+#endif
+
+    for (; x < n - 1; ++x) {
+        pj_int32_t l = 4 * mid[x] - mid[x - 1] - mid[x + 1] - up[x] - down[x];
+        s += l;
+        sq += (pj_uint32_t)(l * l);
+    }
+    *sum += s;
+    *sum_sq += sq;
+}
+
+static void histogram(const pj_uint8_t *a, int n,
+                      pj_uint32_t hist[PS_ANALYTICS_HIST_BINS])
+{
+    int x;
+
+    for (x = 0; x < n; ++x) {
+        hist[a[x] * PS_ANALYTICS_HIST_BINS / 256]++;
+    }
+}
+
+static pj_status_t grid_resize(ps_analytics_grid *grid, int height)
+{
+    free(grid->cur);
+    free(grid->prev);
+    grid->cur = (pj_uint8_t*)malloc(grid->width * height);
+    grid->prev = (pj_uint8_t*)malloc(grid->width * height);
+    grid->has_prev = PJ_FALSE;
+
+    if (grid->cur == NULL || grid->prev == NULL) {
+        free(grid->cur);
+        free(grid->prev);
+        grid->cur = grid->prev = NULL;
+        grid->height = 0;
+        return PJ_ENOMEM;
+    }
+    grid->height = height;
+
+    return PJ_SUCCESS;
+}
+
+pj_status_t ps_analytics_run(ps_analytics_grid *grid, const AVFrame *frame,
+                             int motion_thresh, ps_analytics_scores *scores)
+{
+    pj_uint32_t hist[PS_ANALYTICS_HIST_BINS] = {0};
+    pj_uint64_t sum = 0, sum_sq = 0, lap_sq = 0, sad = 0;
+    pj_int64_t lap_sum = 0;
+    pj_uint32_t dark = 0, changed = 0, top = 0;
+    int w, h, cells, y, i;
+    pj_uint8_t *tmp;
+    double mean, lap_mean, lap_cells;
+
+    PJ_ASSERT_RETURN(grid && frame && scores, PJ_EINVAL);
+    PJ_ASSERT_RETURN(frame->format == AV_PIX_FMT_YUV420P ||
+                     frame->format == AV_PIX_FMT_YUVJ420P, PJ_ENOTSUP);
+    PJ_ASSERT_RETURN(frame->width > 0 && frame->height > 0, PJ_EINVAL);
+
+    w = grid->width;
+    h = (frame->height * w / frame->width) & ~1;
+    if (h < 4) {
+        h = 4;
+    }
+    if (h != grid->height && grid_resize(grid, h) != PJ_SUCCESS) {
+        return PJ_ENOMEM;
+    }
+    cells = w * h;
+
+    if (ScalePlane(frame->data[0], frame->linesize[0], frame->width, frame->height,
+                   grid->cur, w, w, h, kFilterBox) != 0)
+    {
+        return PJ_EINVAL;
+    }
+
+    for (y = 0; y < h; ++y) {
+        const pj_uint8_t *row = grid->cur + y * w;
+
+        moments_row(row, w, &sum, &sum_sq, &dark);
+        histogram(row, w, hist);
+        if (y > 0 && y < h - 1) {
+            laplacian_row(row - w, row, row + w, w, &lap_sum, &lap_sq);
+        }
+        if (grid->has_prev) {
+            sad += sad_row(row, grid->prev + y * w, w, motion_thresh, &changed);
+        }
+    }
+
+    for (i = 0; i < PS_ANALYTICS_HIST_BINS; ++i) {
+        top = PJ_MAX(top, hist[i]);
+    }
+
+    mean = (double)sum / cells;
+    lap_cells = (double)(w - 2) * (h - 2);
+    lap_mean = lap_sum / lap_cells;
+
+    pj_bzero(scores, sizeof(*scores));
+    scores->mean_luma = (float)mean;
+    scores->dark_ratio = (float)dark / cells;
+    scores->contrast = (float)sqrt(PJ_MAX(0.0, (double)sum_sq / cells - mean * mean));
+    scores->sharpness = (float)(lap_sq / lap_cells - lap_mean * lap_mean);
+    scores->dominant_bin = (float)top / cells;
+    scores->has_previous = grid->has_prev;
+    if (grid->has_prev) {
+        scores->motion = (float)sad / cells;
+        scores->motion_area = (float)changed / cells;
+    }
+
+    /* this picture is the reference of the next one */
+    tmp = grid->prev;
+    grid->prev = grid->cur;
+    grid->cur = tmp;
+    grid->has_prev = PJ_TRUE;
+
+    return PJ_SUCCESS;
+}
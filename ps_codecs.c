@@ -10,6 +10,10 @@
 #include <pj/string.h>
 #include <pj/os.h>
 
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include "include/pjsua.h"
 #include "include/pjsua_internal.h"
 
@@ -23,8 +27,12 @@
                                                LIBAVCODEC_VERSION_MINOR >= minor))
 
 #include "include/ps_util.h"
+#include "include/ps_yuv.h"
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libavutil/motion_vector.h>
+#include <pj/hash.h>
 #if LIBAVCODEC_VER_AT_LEAST(53,20)
   /* Needed by 264 so far, on libavcodec 53.20 */
 # include <libavutil/opt.h>
@@ -133,8 +141,125 @@ static struct ps_factory {
     pj_pool_t                        *pool;
     pj_mutex_t                        *mutex;
     pjmedia_ps_codec_callback *ps_codec_callback;
+
+    /* Native snapshot pipeline */
+    pj_bool_t                    native_snapshot;
+    pjmedia_ps_snapshot_sink     snapshot_sink;
+    AVCodec                      *jpeg_enc;
+
+    /* Duplicate i frame detection */
+    pj_bool_t                    dedup;
+
+    /* Motion detection from motion vectors */
+    pj_bool_t                    motion;
+    pjmedia_ps_motion_param      motion_param;
+
+    /* Continuous decode, ps_live_stream by callee id */
+    pj_hash_table_t              *live_streams;
+    unsigned                     live_count;
+
+    /* Workers of continuous decode and motion detection, started on
+     * first use
+     */
+    struct ps_worker             *workers;
+    unsigned                     worker_cnt;
 } ps_factory;
 
+struct ps_private;
+
+/* Worker state of one callee: continuous decode, motion detection and
+ * native snapshot. An entry is unlinked once the stream is not live and
+ * no codec refers to it, and freed by its worker after the jobs queued
+ * before. The hash table, ff and codec_refs are guarded by the factory
+ * mutex, the latest picture by the stream mutex. The decoders are only
+ * used by the worker the stream is queued to.
+ */
+typedef struct ps_live_stream {
+    char                         callee_id[PJSIP_MAX_URL_SIZE];
+    pj_hash_entry_buf            hentry;
+    pj_bool_t                    enable;    /**< Live, read without lock*/
+    struct ps_private            *ff;       /**< Codec decoding it      */
+    unsigned                     codec_refs;/**< Codecs holding it      */
+    pthread_mutex_t              mutex;
+    AVFrame                      *latest;   /**< Latest picture         */
+    pj_bool_t                    mv_pending;/**< Motion since the last
+                                                 i frame passed on,
+                                                 atomic                 */
+    pjmedia_ps_live_param        live_param;/**< Under factory mutex   */
+
+    /* worker side */
+    unsigned                     hash;      /**< Picks the worker       */
+    pj_bool_t                    gap;       /**< A frame was not queued,
+                                                 under the worker mutex */
+    AVCodecContext               *ctx;
+    AVFrame                      *frame;
+    pj_bool_t                    synced;
+    AVCodecContext               *mv_ctx;
+    AVFrame                      *mv_frame;
+    float                        *mv_grid;
+    unsigned                     mv_grid_size;
+    pj_bool_t                    mv_synced;
+    unsigned                     mv_count;  /**< Pictures since the last
+                                                 analysed one           */
+
+    /* Native snapshot, created on first use */
+    AVCodecContext               *snap_ctx;
+    AVFrame                      *snap_frame;
+    AVFrame                      *jpeg_frame;
+    AVPacket                     *jpeg_pkt;
+    AVCodecContext               *jpeg_ctx;
+    struct SwsContext            *sws_ctx;
+    pj_uint8_t                   *last_jpeg;/**< Of the last i frame,
+                                                 for duplicates         */
+    unsigned                     last_jpeg_size;
+    unsigned                     last_jpeg_len;
+} ps_live_stream;
+
+#define PS_WORKER_MAX       16
+#define PS_WORKER_QUEUE     64
+
+#define PS_CLOSE_LIVE       1
+#define PS_CLOSE_MOTION     2
+#define PS_CLOSE_SNAPSHOT   4
+#define PS_CLOSE_FREE       8   /**< Close all and free the stream  */
+
+/* A frame of a stream, data is NULL to close the decoders in close */
+typedef struct ps_live_job {
+    ps_live_stream               *ls;
+    enum AVCodecID               codec_id;
+    pj_bool_t                    is_i_frame;
+    pj_uint8_t                   *data;     /**< Padded copy, free()    */
+    unsigned                     len;
+    pj_bool_t                    live;
+    pj_bool_t                    motion;
+    pjmedia_ps_motion_param      motion_param;
+    pj_bool_t                    snapshot;  /**< Native snapshot        */
+    pj_bool_t                    is_duplicate;
+    unsigned                     close;
+} ps_live_job;
+
+/* Decodes the streams hashed to it in queue order. Frames take up to
+ * PS_WORKER_QUEUE slots, the rest is left for closing decoders.
+ */
+typedef struct ps_worker {
+    pj_thread_t                  *thread;
+    pthread_mutex_t              mutex;
+    pthread_cond_t               cond;
+    ps_live_job                  jobs[PS_WORKER_QUEUE * 2];
+    unsigned                     head;
+    unsigned                     count;
+    pj_bool_t                    quit;
+    ps_codec                     cb_codec;  /**< Passed to on_motion_cb
+                                                 and on_snapshot_cb     */
+} ps_worker;
+
+static pj_status_t ps_workers_start(void);
+static void ps_workers_stop(void);
+static ps_live_stream* ps_stream_create(const char *callee_id);
+static void ps_stream_release(ps_live_stream *ls);
+static void ps_stream_destroy(ps_live_stream *ls);
+static void ps_stream_post_close(ps_live_stream *ls, unsigned close);
+
 typedef struct ps_codec_desc ps_codec_desc;
 
 enum ps_codec_op {
@@ -143,6 +268,28 @@ enum ps_codec_op {
 	PS_CODEC_OP_SEEK            = 3,  // only seek
 };
 
+/* Parameter sets of the stream needed to skip the slice header fields the
+ * duplicate hash must ignore, only the last sps and pps are kept.
+ */
+typedef struct ps_hash_params {
+    pj_bool_t                    sps_valid;
+    unsigned                     sps_id;
+    pj_bool_t                    separate_colour_plane;
+    unsigned                     log2_max_frame_num;
+    pj_bool_t                    frame_mbs_only;
+    unsigned                     poc_type;
+    unsigned                     log2_max_poc_lsb;
+    pj_bool_t                    delta_pic_order_always_zero;
+
+    pj_bool_t                    pps_valid;
+    unsigned                     pps_id;
+    unsigned                     pps_sps_id;
+    pj_bool_t                    bottom_field_pic_order;
+    pj_bool_t                    redundant_pic_cnt_present;
+
+    unsigned                     vop_time_bits; /**< mpeg4, 0 without vol */
+} ps_hash_params;
+
 /* PS codecs private data. */
 typedef struct ps_private
 {
@@ -180,6 +327,20 @@ typedef struct ps_private
                                                 /**< Expected output format of
                                                      ps decoder            */
 
+    /* Duplicate detection, the hash of the last i frame */
+    pj_uint64_t                          last_i_hash;
+    ps_hash_params                       hash_params;
+
+    /* Codec of the last i frame, p frames carry no stream map */
+    enum AVCodecID                       video_codec_id;
+
+    /* Worker state of the callee */
+    ps_live_stream                      *live;
+
+    /* Callee of the stream, resolved once per rtcp cname */
+    char                                 callee_cname[32];
+    char                                 callee_id[PJSIP_MAX_URL_SIZE];
+
     void                                   *data;        /**< Codec specific data    */
 } ps_private;
 
@@ -501,6 +662,9 @@ PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_init(pjmedia_vid_codec_mgr *mgr,
         goto on_error;
     }
 
+    ps_factory.live_streams = pj_hash_create(pool, 64);
+    ps_factory.live_count = 0;
+
     ps_add_ref();
 //    avcodec_register_all();
 
@@ -743,6 +907,243 @@ PJ_DECL(pj_status_t) pjmedia_codec_ps_vid_init_cb(pjmedia_ps_codec_callback *cb)
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_set_native_snapshot(pj_bool_t enable,
+                                                             const pjmedia_ps_snapshot_sink *sink)
+{
+    PJ_ASSERT_RETURN(ps_factory.pool != NULL, PJ_EINVALIDOP);
+
+    if (enable && ps_factory.jpeg_enc == NULL) {
+        ps_factory.jpeg_enc = (AVCodec*)avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        if (ps_factory.jpeg_enc == NULL) {
+            PJ_LOG(2, (THIS_FILE, "Cannot find mjpeg encoder, native snapshot disabled"));
+            return PJ_ENOTFOUND;
+        }
+    }
+
+    pj_mutex_lock(ps_factory.mutex);
+
+    if (enable && ps_factory.workers == NULL) {
+        pj_status_t status = ps_workers_start();
+        if (status != PJ_SUCCESS) {
+            pj_mutex_unlock(ps_factory.mutex);
+            return status;
+        }
+    }
+
+    if (sink) {
+        pj_memcpy(&ps_factory.snapshot_sink, sink, sizeof(*sink));
+    } else {
+        pj_bzero(&ps_factory.snapshot_sink, sizeof(ps_factory.snapshot_sink));
+    }
+
+    if (ps_factory.native_snapshot && !enable) {
+        pj_hash_iterator_t it_buf, *it;
+
+        /* the snapshot decoders belong to the workers, let them close them */
+        it = pj_hash_first(ps_factory.live_streams, &it_buf);
+        while (it) {
+            ps_stream_post_close((ps_live_stream*)pj_hash_this(ps_factory.live_streams, it),
+                                 PS_CLOSE_SNAPSHOT);
+            it = pj_hash_next(ps_factory.live_streams, it);
+        }
+    }
+    ps_factory.native_snapshot = enable;
+
+    pj_mutex_unlock(ps_factory.mutex);
+
+    PJ_LOG(4, (THIS_FILE, "Native snapshot %s", enable ? "enabled" : "disabled"));
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_set_motion(pj_bool_t enable,
+                                                    const pjmedia_ps_motion_param *param)
+{
+    PJ_ASSERT_RETURN(ps_factory.pool != NULL, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(!param || (param->grid_w > 0 && param->grid_h > 0 &&
+                                param->grid_w * param->grid_h <= 4096), PJ_EINVAL);
+
+    pj_mutex_lock(ps_factory.mutex);
+
+    if (enable && ps_factory.workers == NULL) {
+        pj_status_t status = ps_workers_start();
+        if (status != PJ_SUCCESS) {
+            pj_mutex_unlock(ps_factory.mutex);
+            return status;
+        }
+    }
+
+    if (param) {
+        pj_memcpy(&ps_factory.motion_param, param, sizeof(*param));
+    } else {
+        ps_factory.motion_param.grid_w = 16;
+        ps_factory.motion_param.grid_h = 9;
+        ps_factory.motion_param.threshold = 1.0f;
+        ps_factory.motion_param.gate_snapshot = PJ_FALSE;
+        ps_factory.motion_param.interval = 5;
+    }
+    if (ps_factory.motion_param.interval == 0) {
+        ps_factory.motion_param.interval = 1;
+    }
+
+    if (ps_factory.motion && !enable) {
+        pj_hash_iterator_t it_buf, *it;
+
+        /* the decoders belong to the workers, let them close them */
+        it = pj_hash_first(ps_factory.live_streams, &it_buf);
+        while (it) {
+            ps_stream_post_close((ps_live_stream*)pj_hash_this(ps_factory.live_streams, it),
+                                 PS_CLOSE_MOTION);
+            it = pj_hash_next(ps_factory.live_streams, it);
+        }
+    }
+    ps_factory.motion = enable;
+
+    pj_mutex_unlock(ps_factory.mutex);
+
+    PJ_LOG(4, (THIS_FILE, "Motion detection %s", enable ? "enabled" : "disabled"));
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_set_live(const char *callee_id,
+                                                  pj_bool_t enable,
+                                                  const pjmedia_ps_live_param *param)
+{
+    ps_live_stream *ls;
+
+    PJ_ASSERT_RETURN(ps_factory.pool != NULL, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(callee_id && strlen(callee_id) < PJSIP_MAX_URL_SIZE, PJ_EINVAL);
+
+    pj_mutex_lock(ps_factory.mutex);
+
+    if (enable && ps_factory.workers == NULL) {
+        pj_status_t status = ps_workers_start();
+        if (status != PJ_SUCCESS) {
+            pj_mutex_unlock(ps_factory.mutex);
+            return status;
+        }
+    }
+
+    ls = (ps_live_stream*)pj_hash_get(ps_factory.live_streams, callee_id,
+                                      PJ_HASH_KEY_STRING, NULL);
+    if (ls == NULL && enable) {
+        ls = ps_stream_create(callee_id);
+        if (ls == NULL) {
+            pj_mutex_unlock(ps_factory.mutex);
+            return PJ_ENOMEM;
+        }
+    }
+
+    if (ls && enable) {
+        if (param) {
+            pj_memcpy(&ls->live_param, param, sizeof(*param));
+        } else {
+            pj_bzero(&ls->live_param, sizeof(ls->live_param));
+        }
+    }
+
+    if (ls && ls->enable != enable) {
+        __atomic_store_n(&ls->enable, enable, __ATOMIC_RELEASE);
+        if (enable) {
+            ps_factory.live_count++;
+        } else {
+            ps_factory.live_count--;
+
+            pthread_mutex_lock(&ls->mutex);
+            av_frame_free(&ls->latest);
+            pthread_mutex_unlock(&ls->mutex);
+
+            /* the decoder belongs to the worker, let it close it */
+            ps_stream_post_close(ls, PS_CLOSE_LIVE);
+            ps_stream_release(ls);
+        }
+    }
+
+    pj_mutex_unlock(ps_factory.mutex);
+
+    PJ_LOG(4, (THIS_FILE, "Continuous decode of %s %s", callee_id, enable ? "enabled" : "disabled"));
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_live_snapshot(const char *callee_id,
+                                                       const ps_jpeg_param *param,
+                                                       pj_uint8_t **jpeg,
+                                                       unsigned long *len)
+{
+    ps_live_stream *ls;
+    ps_jpeg_param def_param;
+    AVFrame *picture = NULL, *full = NULL;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(ps_factory.pool != NULL, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(callee_id && jpeg && len, PJ_EINVAL);
+
+    if (param == NULL) {
+        ps_jpeg_param_default(&def_param);
+        param = &def_param;
+    }
+
+    /* Only take a reference under the locks, encode outside of them. The
+     * factory mutex keeps the stream from being released meanwhile.
+     */
+    pj_mutex_lock(ps_factory.mutex);
+    ls = (ps_live_stream*)pj_hash_get(ps_factory.live_streams, callee_id,
+                                      PJ_HASH_KEY_STRING, NULL);
+    if (ls) {
+        pthread_mutex_lock(&ls->mutex);
+        if (ls->enable && ls->latest) {
+            picture = av_frame_alloc();
+            if (picture && av_frame_ref(picture, ls->latest) < 0) {
+                av_frame_free(&picture);
+            }
+        }
+        pthread_mutex_unlock(&ls->mutex);
+    }
+    pj_mutex_unlock(ps_factory.mutex);
+
+    if (picture == NULL) {
+        return PJ_ENOTFOUND;
+    }
+
+    /* The decoder may still reference the picture, convert into a copy */
+    full = av_frame_alloc();
+    if (full == NULL) {
+        av_frame_free(&picture);
+        return PJ_ENOMEM;
+    }
+    full->format = AV_PIX_FMT_YUVJ420P;
+    full->width = picture->width;
+    full->height = picture->height;
+    if (av_frame_get_buffer(full, 32) < 0) {
+        status = PJ_ENOMEM;
+        goto on_return;
+    }
+
+    status = ps_yuv_scale(picture, full, PJ_TRUE);
+    if (status == PJ_SUCCESS) {
+        status = ps_jpeg_encode(full, param, jpeg, len);
+    }
+
+on_return:
+    av_frame_free(&full);
+    av_frame_free(&picture);
+
+    return status;
+}
+
+PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_set_dedup(pj_bool_t enable)
+{
+    PJ_ASSERT_RETURN(ps_factory.pool != NULL, PJ_EINVALIDOP);
+
+    ps_factory.dedup = enable;
+
+    PJ_LOG(4, (THIS_FILE, "Duplicate i frame detection %s", enable ? "enabled" : "disabled"));
+
+    return PJ_SUCCESS;
+}
+
 /*
  * Unregister PS codecs factory from pjmedia endpoint.
  */
@@ -755,8 +1156,25 @@ PJ_DEF(pj_status_t) pjmedia_codec_ps_vid_deinit(void)
         return PJ_SUCCESS;
     }
 
+    /* The workers may still open decoders under the factory mutex */
+    ps_workers_stop();
+
     pj_mutex_lock(ps_factory.mutex);
 
+    /* The codecs are closed, free the streams left */
+    {
+        pj_hash_iterator_t it_buf, *it;
+
+        it = pj_hash_first(ps_factory.live_streams, &it_buf);
+        while (it) {
+            ps_live_stream *ls = (ps_live_stream*)pj_hash_this(ps_factory.live_streams, it);
+
+            it = pj_hash_next(ps_factory.live_streams, it);
+            ps_stream_destroy(ls);
+        }
+        ps_factory.live_streams = NULL;
+    }
+
     /* Unregister PS codecs factory. */
     status = pjmedia_vid_codec_mgr_unregister_factory(ps_factory.mgr, &ps_factory.base);
 
@@ -1051,6 +1469,9 @@ static pj_status_t open_ps_codec(ps_private *ff,
         ctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
         ctx->workaround_bugs = FF_BUG_AUTODETECT;
         ctx->opaque = ff;
+
+        /* Only i frames are fed by native snapshot, output them at once */
+        ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
     }
 
     /* Override generic params or apply specific params before opening
@@ -1221,8 +1642,26 @@ static pj_status_t ps_codec_close( pjmedia_vid_codec *codec )
     }
     ff->enc_ctx = NULL;
     ff->dec_ctx = NULL;
+    if (ff->live) {
+        if (ff->live->ff == ff) {
+            /* the call is gone, do not serve its last picture */
+            pthread_mutex_lock(&ff->live->mutex);
+            av_frame_free(&ff->live->latest);
+            pthread_mutex_unlock(&ff->live->mutex);
+            ps_stream_post_close(ff->live, PS_CLOSE_LIVE | PS_CLOSE_MOTION |
+                                           PS_CLOSE_SNAPSHOT);
+            ff->live->ff = NULL;
+        }
+        ff->live->codec_refs--;
+        ps_stream_release(ff->live);
+    }
+    ff->live = NULL;
     pj_mutex_unlock(ff_mutex);
 
+    ff->video_codec_id = AV_CODEC_ID_NONE;
+    ff->last_i_hash = 0;
+    pj_bzero(&ff->hash_params, sizeof(ff->hash_params));
+
     return PJ_SUCCESS;
 }
 
@@ -2050,69 +2489,1556 @@ static pj_status_t  ps_unpacketize(pjmedia_vid_codec *codec,
     return PJ_SUCCESS;
 }
 
-static pj_status_t ps_codec_decode( pjmedia_vid_codec *codec,
-                                        pj_size_t pkt_count,
-                                        pjmedia_frame packets[],
-                                        unsigned out_size,
-                                        pjmedia_frame *output)
+/*
+ * Native snapshot: (re)open jpeg encoder for the decoded picture size.
+ */
+static pj_status_t ps_native_open_jpeg(ps_live_stream *ls, int width, int height)
 {
-    ps_private *ff = (ps_private*)codec->codec_data;
-    pj_status_t status;
+    AVCodecContext *ctx = ls->jpeg_ctx;
+    int err;
 
-    PJ_ASSERT_RETURN(codec && pkt_count > 0 && packets && output, PJ_EINVAL);
+    if (ctx && ctx->width == width && ctx->height == height) {
+        return PJ_SUCCESS;
+    }
 
-    if (ff->whole) {
-        // assert not support
-        pj_assert(pkt_count==1);
-//        return ps_codec_decode_whole(codec, &packets[0], out_size, output);
-        return PJ_EINVAL;
-    } else {
-        pjmedia_frame whole_frm;
+    pj_mutex_lock(ps_factory.mutex);
+    if (ctx) {
+        avcodec_free_context(&ls->jpeg_ctx);
+    }
 
-        ps_codec ps;
-        ps.packets = packets;
-        ps.pkt_count = pkt_count;
-        ps.pkt_idx = 0;
-        ps.current_buf = packets[0].buf;
-        ps.remain_buf_len = packets[0].size;
-        ps.dec_buf = ff->dec_buf;
-        ps.dec_buf_size = ff->dec_buf_size;
-        ps.dec_data_len = 0;
-        ps.is_i_frame = PJ_FALSE;
-        // copy cname from buf
-        if (strlen(output->buf) > 0) {
-            for (int i = 0; i < pjsua_var.call_cnt; i++) {
-                if (pj_strcmp2(&pjsua_var.calls[i].cname, output->buf) == 0) {
-                    pj_str_t *remote_info = &pjsua_var.calls[i].inv->dlg->remote.info_str;
-                    if (remote_info->slen +1 < PJSIP_MAX_URL_SIZE) {
-                        pj_memcpy(ps.callee_id, remote_info->ptr, remote_info->slen);
-                        ps.callee_id[remote_info->slen] = 0;
-                    }
-                }
-            }
+    ctx = avcodec_alloc_context3(ps_factory.jpeg_enc);
+    if (ctx == NULL) {
+        pj_mutex_unlock(ps_factory.mutex);
+        return PJ_ENOMEM;
+    }
+
+    ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->time_base.num = 1;
+    ctx->time_base.den = 1;
+
+    err = avcodec_open2(ctx, ps_factory.jpeg_enc, NULL);
+    pj_mutex_unlock(ps_factory.mutex);
+
+    if (err < 0) {
+        print_ps_err(err);
+        avcodec_free_context(&ctx);
+        return PJMEDIA_CODEC_EFAILED;
+    }
+
+    ls->jpeg_ctx = ctx;
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * Native snapshot: open the i frame decoder of the stream, on the worker.
+ */
+static pj_status_t ps_native_open(ps_live_stream *ls, enum AVCodecID codec_id)
+{
+    const AVCodec *dec;
+    AVCodecContext *ctx;
+    int err;
+
+    if (ls->snap_ctx && ls->snap_ctx->codec_id == codec_id) {
+        return PJ_SUCCESS;
+    }
+
+    dec = avcodec_find_decoder(codec_id);
+    if (dec == NULL) {
+        return PJ_ENOTFOUND;
+    }
+
+    avcodec_free_context(&ls->snap_ctx);
+
+    if (ls->snap_frame == NULL) {
+        ls->snap_frame = av_frame_alloc();
+    }
+    if (ls->jpeg_frame == NULL) {
+        ls->jpeg_frame = av_frame_alloc();
+    }
+    if (ls->jpeg_pkt == NULL) {
+        ls->jpeg_pkt = av_packet_alloc();
+    }
+    if (!ls->snap_frame || !ls->jpeg_frame || !ls->jpeg_pkt) {
+        return PJ_ENOMEM;
+    }
+
+    ctx = avcodec_alloc_context3(dec);
+    if (ctx == NULL) {
+        return PJ_ENOMEM;
+    }
+
+    /* Lone i frames, a picture is wanted out of every packet */
+    ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+    pj_mutex_lock(ps_factory.mutex);
+    err = avcodec_open2(ctx, dec, NULL);
+    pj_mutex_unlock(ps_factory.mutex);
+
+    if (err < 0) {
+        print_ps_err(err);
+        avcodec_free_context(&ctx);
+        return PJMEDIA_CODEC_EFAILED;
+    }
+
+    ls->snap_ctx = ctx;
+
+    return PJ_SUCCESS;
+}
+
+static void ps_native_close(ps_live_stream *ls)
+{
+    avcodec_free_context(&ls->snap_ctx);
+    avcodec_free_context(&ls->jpeg_ctx);
+    if (ls->sws_ctx) {
+        sws_freeContext(ls->sws_ctx);
+        ls->sws_ctx = NULL;
+    }
+    av_frame_free(&ls->snap_frame);
+    av_frame_free(&ls->jpeg_frame);
+    av_packet_free(&ls->jpeg_pkt);
+    av_freep(&ls->last_jpeg);
+    ls->last_jpeg_size = ls->last_jpeg_len = 0;
+}
+
+/*
+ * Native snapshot: convert decoded picture to full range yuv420p for jpeg.
+ * The decoder keeps referencing its picture, so it is scaled into our own
+ * frame, expanding the range on the way.
+ */
+static AVFrame* ps_native_convert(ps_live_stream *ls, AVFrame *src)
+{
+    AVFrame *dst = ls->jpeg_frame;
+
+    if (src->format == AV_PIX_FMT_YUVJ420P) {
+        return src;
+    }
+
+    if (dst->width != src->width || dst->height != src->height) {
+        av_frame_unref(dst);
+        dst->format = AV_PIX_FMT_YUVJ420P;
+        dst->width = src->width;
+        dst->height = src->height;
+        if (av_frame_get_buffer(dst, 32) < 0) {
+            return NULL;
         }
+    }
+    dst->format = AV_PIX_FMT_YUVJ420P;
 
-        status = ps_unpacketize(codec, &ps);
-        if (status != PJ_SUCCESS) {
-#ifdef TRACE_PS
-//            FILE *fptr;
-//            char filename[256];
-//            sprintf(filename, "./%d_%d.bin", packets[i].timestamp.u64, i);
-//
-//            if ((fptr = fopen(filename,"ab")) != NULL){
-//               fwrite(packets[i].buf, packets[i].size, 1, fptr);
-//               fclose(fptr);
-//            }
-#endif // TRACE_PS
-            int idx = ps.pkt_idx;
-            PJ_PERROR(3,(THIS_FILE, status, "Unpacketize error. ts: %d, idx: %d, rtp_seq: %d, expect len: %d, real len: %d",
-                packets[idx].timestamp.u64, idx, packets[idx].rtp_seq, ps.total_video_pes_len, ps.dec_data_len));
+    if (src->format == AV_PIX_FMT_YUV420P) {
+        if (ps_yuv_scale(src, dst, PJ_TRUE) != PJ_SUCCESS) {
+            return NULL;
         }
+        return dst;
+    }
 
-        whole_frm.buf = ff->dec_buf;
-        whole_frm.size = ps.dec_data_len;
-        whole_frm.timestamp = output->timestamp = packets[ps.pkt_idx].timestamp;
-        whole_frm.bit_info = 0;
+    ls->sws_ctx = sws_getCachedContext(ls->sws_ctx,
+                                       src->width, src->height, src->format,
+                                       src->width, src->height, AV_PIX_FMT_YUVJ420P,
+                                       SWS_BILINEAR, NULL, NULL, NULL);
+    if (ls->sws_ctx == NULL) {
+        return NULL;
+    }
+
+    sws_scale(ls->sws_ctx, (const uint8_t * const*)src->data, src->linesize,
+              0, src->height, dst->data, dst->linesize);
+
+    return dst;
+}
+
+/*
+ * Native snapshot: pass a jpeg to the C sink or the snapshot callback.
+ */
+static void ps_native_emit(ps_worker *w, const ps_live_job *job,
+                           const pj_uint8_t *jpeg, unsigned len)
+{
+    pjmedia_ps_codec_callback *cb = ps_factory.ps_codec_callback;
+    pjmedia_ps_snapshot_sink *sink = &ps_factory.snapshot_sink;
+
+    if (sink->on_snapshot) {
+        (*sink->on_snapshot)(sink->user_data, job->ls->callee_id, jpeg, len);
+    } else if (cb && cb->on_snapshot_cb) {
+        pj_ansi_strcpy(w->cb_codec.callee_id, job->ls->callee_id);
+        w->cb_codec.video_codec_id = job->codec_id;
+        w->cb_codec.is_i_frame = PJ_TRUE;
+        w->cb_codec.is_duplicate = job->is_duplicate;
+        (*cb->on_snapshot_cb)(&w->cb_codec, jpeg, len);
+    }
+}
+
+/* A snapshot sink or callback is set */
+static pj_bool_t ps_native_has_sink(void)
+{
+    pjmedia_ps_codec_callback *cb = ps_factory.ps_codec_callback;
+
+    return ps_factory.snapshot_sink.on_snapshot != NULL ||
+           (cb && cb->on_snapshot_cb);
+}
+
+/*
+ * Native snapshot: decode a queued i frame with the decoder of the stream,
+ * encode it to jpeg and pass it on, on the worker. A duplicate i frame
+ * passes the jpeg of the previous one again.
+ */
+static void ps_native_work(ps_worker *w, ps_live_job *job)
+{
+    ps_live_stream *ls = job->ls;
+    AVPacket avpacket;
+    AVFrame *picture;
+    pj_status_t status;
+    int err;
+
+    if (job->is_duplicate && ls->last_jpeg_len > 0) {
+        PJ_LOG(5, (THIS_FILE, "Duplicate i frame of %s, re-emit last jpeg", ls->callee_id));
+        ps_native_emit(w, job, ls->last_jpeg, ls->last_jpeg_len);
+        return;
+    }
+
+    status = ps_native_open(ls, job->codec_id);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4, (THIS_FILE, status, "Native snapshot error"));
+        return;
+    }
+
+    av_init_packet(&avpacket);
+    avpacket.data = job->data;
+    avpacket.size = (int)job->len;
+    avpacket.flags = AV_PKT_FLAG_KEY;
+
+    err = avcodec_send_packet(ls->snap_ctx, &avpacket);
+    if (err < 0) {
+        print_ps_err(err);
+        avcodec_flush_buffers(ls->snap_ctx);
+        return;
+    }
+
+    err = avcodec_receive_frame(ls->snap_ctx, ls->snap_frame);
+    if (err == AVERROR(EAGAIN)) {
+        PJ_LOG(5, (THIS_FILE, "Native snapshot got no picture yet"));
+        return;
+    } else if (err < 0) {
+        print_ps_err(err);
+        return;
+    }
+
+    picture = ps_native_convert(ls, ls->snap_frame);
+    if (picture == NULL) {
+        PJ_PERROR(4, (THIS_FILE, PJ_ENOMEM, "Native snapshot error"));
+        goto on_return;
+    }
+
+    status = ps_native_open_jpeg(ls, picture->width, picture->height);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4, (THIS_FILE, status, "Native snapshot error"));
+        goto on_return;
+    }
+
+    err = avcodec_send_frame(ls->jpeg_ctx, picture);
+    if (err >= 0) {
+        err = avcodec_receive_packet(ls->jpeg_ctx, ls->jpeg_pkt);
+    }
+    if (err < 0) {
+        print_ps_err(err);
+        goto on_return;
+    }
+
+    ps_native_emit(w, job, ls->jpeg_pkt->data, ls->jpeg_pkt->size);
+
+    /* Kept for re-emitting on duplicate i frames */
+    if (ps_factory.dedup) {
+        av_fast_malloc(&ls->last_jpeg, &ls->last_jpeg_size, ls->jpeg_pkt->size);
+        if (ls->last_jpeg) {
+            pj_memcpy(ls->last_jpeg, ls->jpeg_pkt->data, ls->jpeg_pkt->size);
+            ls->last_jpeg_len = ls->jpeg_pkt->size;
+        } else {
+            ls->last_jpeg_size = ls->last_jpeg_len = 0;
+        }
+    }
+    av_packet_unref(ls->jpeg_pkt);
+
+on_return:
+    av_frame_unref(ls->snap_frame);
+}
+
+/*
+ * MurmurHash64A, eight bytes per round.
+ */
+static pj_uint64_t ps_hash64(const pj_uint8_t *data, pj_size_t len, pj_uint64_t h)
+{
+    const pj_uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const pj_uint8_t *end = data + (len & ~(pj_size_t)7);
+    pj_uint64_t k;
+
+    h ^= len * m;
+
+    for (; data != end; data += 8) {
+        pj_memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (len & 7) {
+    case 7: h ^= (pj_uint64_t)data[6] << 48;
+    case 6: h ^= (pj_uint64_t)data[5] << 40;
+    case 5: h ^= (pj_uint64_t)data[4] << 32;
+    case 4: h ^= (pj_uint64_t)data[3] << 24;
+    case 3: h ^= (pj_uint64_t)data[2] << 16;
+    case 2: h ^= (pj_uint64_t)data[1] << 8;
+    case 1: h ^= (pj_uint64_t)data[0];
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+/* Bit reader over the rbsp of a nal unit or an mpeg4 start code unit.
+ * Emulation prevention bytes are skipped when epb is set, reading past
+ * the end sets error.
+ */
+typedef struct ps_bits {
+    const pj_uint8_t            *p;
+    const pj_uint8_t            *end;
+    unsigned                    bit;    /**< Bits used of *p            */
+    unsigned                    zeros;  /**< Zero bytes before p        */
+    pj_bool_t                   epb;
+    pj_bool_t                   error;
+} ps_bits;
+
+static void ps_bits_init(ps_bits *b, const pj_uint8_t *p,
+                         const pj_uint8_t *end, pj_bool_t epb)
+{
+    pj_bzero(b, sizeof(*b));
+    b->p = p;
+    b->end = end;
+    b->epb = epb;
+}
+
+static unsigned ps_bits_read1(ps_bits *b)
+{
+    unsigned v;
+
+    if (b->p >= b->end) {
+        b->error = PJ_TRUE;
+        return 0;
+    }
+
+    v = (*b->p >> (7 - b->bit)) & 1;
+    if (++b->bit == 8) {
+        b->bit = 0;
+        b->zeros = (*b->p == 0) ? b->zeros + 1 : 0;
+        b->p++;
+        if (b->epb && b->zeros >= 2 && b->p < b->end && *b->p == 3) {
+            b->p++;
+            b->zeros = 0;
+        }
+    }
+
+    return v;
+}
+
+static unsigned ps_bits_read(ps_bits *b, unsigned n)
+{
+    unsigned v = 0;
+
+    while (n--) {
+        v = (v << 1) | ps_bits_read1(b);
+    }
+
+    return v;
+}
+
+/* Exp-Golomb coded unsigned, ue(v) */
+static unsigned ps_bits_ue(ps_bits *b)
+{
+    unsigned zeros = 0;
+
+    while (ps_bits_read1(b) == 0 && !b->error) {
+        if (++zeros > 31) {
+            b->error = PJ_TRUE;
+            return 0;
+        }
+    }
+
+    return ((1u << zeros) - 1) + ps_bits_read(b, zeros);
+}
+
+/* Exp-Golomb coded signed, se(v) */
+static int ps_bits_se(ps_bits *b)
+{
+    unsigned k = ps_bits_ue(b);
+
+    return (k & 1) ? (int)((k + 1) / 2) : -(int)(k / 2);
+}
+
+/* First whole byte not read yet */
+static const pj_uint8_t* ps_bits_byte(const ps_bits *b)
+{
+    return b->bit ? b->p + 1 : b->p;
+}
+
+static void ps_h264_parse_sps(ps_hash_params *hp, const pj_uint8_t *rbsp,
+                              const pj_uint8_t *end)
+{
+    ps_bits b;
+    unsigned profile_idc, i, n;
+
+    hp->sps_valid = PJ_FALSE;
+    ps_bits_init(&b, rbsp, end, PJ_TRUE);
+
+    profile_idc = ps_bits_read(&b, 8);
+    ps_bits_read(&b, 16);               /* constraint flags, level_idc */
+    hp->sps_id = ps_bits_ue(&b);
+    hp->separate_colour_plane = PJ_FALSE;
+
+    if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+        profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
+        profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
+        profile_idc == 138 || profile_idc == 139 || profile_idc == 134 ||
+        profile_idc == 135)
+    {
+        unsigned chroma_format_idc = ps_bits_ue(&b);
+
+        if (chroma_format_idc == 3) {
+            hp->separate_colour_plane = ps_bits_read1(&b);
+        }
+        ps_bits_ue(&b);                 /* bit_depth_luma_minus8 */
+        ps_bits_ue(&b);                 /* bit_depth_chroma_minus8 */
+        ps_bits_read1(&b);              /* qpprime_y_zero_transform_bypass */
+
+        if (ps_bits_read1(&b)) {        /* seq_scaling_matrix_present */
+            n = (chroma_format_idc != 3) ? 8 : 12;
+            for (i = 0; i < n && !b.error; ++i) {
+                if (ps_bits_read1(&b)) {
+                    unsigned size = i < 6 ? 16 : 64, j;
+                    int last = 8, next = 8;
+
+                    for (j = 0; j < size && !b.error; ++j) {
+                        if (next != 0) {
+                            next = (last + ps_bits_se(&b) + 256) % 256;
+                        }
+                        last = (next == 0) ? last : next;
+                    }
+                }
+            }
+        }
+    }
+
+    hp->log2_max_frame_num = ps_bits_ue(&b) + 4;
+    hp->poc_type = ps_bits_ue(&b);
+    if (hp->poc_type == 0) {
+        hp->log2_max_poc_lsb = ps_bits_ue(&b) + 4;
+    } else if (hp->poc_type == 1) {
+        hp->delta_pic_order_always_zero = ps_bits_read1(&b);
+        ps_bits_se(&b);                 /* offset_for_non_ref_pic */
+        ps_bits_se(&b);                 /* offset_for_top_to_bottom_field */
+        n = ps_bits_ue(&b);
+        for (i = 0; i < n && !b.error; ++i) {
+            ps_bits_se(&b);             /* offset_for_ref_frame */
+        }
+    }
+    ps_bits_ue(&b);                     /* max_num_ref_frames */
+    ps_bits_read1(&b);                  /* gaps_in_frame_num_allowed */
+    ps_bits_ue(&b);                     /* pic_width_in_mbs_minus1 */
+    ps_bits_ue(&b);                     /* pic_height_in_map_units_minus1 */
+    hp->frame_mbs_only = ps_bits_read1(&b);
+
+    hp->sps_valid = !b.error && hp->log2_max_frame_num <= 16 &&
+                    hp->log2_max_poc_lsb <= 16;
+}
+
+static void ps_h264_parse_pps(ps_hash_params *hp, const pj_uint8_t *rbsp,
+                              const pj_uint8_t *end)
+{
+    ps_bits b;
+
+    hp->pps_valid = PJ_FALSE;
+    ps_bits_init(&b, rbsp, end, PJ_TRUE);
+
+    hp->pps_id = ps_bits_ue(&b);
+    hp->pps_sps_id = ps_bits_ue(&b);
+    ps_bits_read1(&b);                  /* entropy_coding_mode */
+    hp->bottom_field_pic_order = ps_bits_read1(&b);
+    if (ps_bits_ue(&b) != 0) {
+        /* slice groups are not parsed, their slices are hashed whole */
+        return;
+    }
+    ps_bits_ue(&b);                     /* num_ref_idx_l0_default_minus1 */
+    ps_bits_ue(&b);                     /* num_ref_idx_l1_default_minus1 */
+    ps_bits_read(&b, 3);                /* weighted_pred, weighted_bipred */
+    ps_bits_se(&b);                     /* pic_init_qp_minus26 */
+    ps_bits_se(&b);                     /* pic_init_qs_minus26 */
+    ps_bits_se(&b);                     /* chroma_qp_index_offset */
+    ps_bits_read(&b, 2);                /* deblocking control, constrained intra */
+    hp->redundant_pic_cnt_present = ps_bits_read1(&b);
+
+    hp->pps_valid = !b.error;
+}
+
+/*
+ * Skip the header of an intra h264 slice up to and including
+ * slice_qp_delta, so frame_num, idr_pic_id and the picture order count are
+ * not hashed. Returns the first byte of what follows, NULL when the slice
+ * can not be parsed.
+ */
+static const pj_uint8_t* ps_h264_slice_data(const ps_hash_params *hp,
+                                            const pj_uint8_t *unit,
+                                            const pj_uint8_t *end,
+                                            int *qp_delta)
+{
+    unsigned nal_ref_idc = (unit[0] >> 5) & 3;
+    pj_bool_t idr = (unit[0] & 0x1f) == 5;
+    pj_bool_t field_pic = PJ_FALSE;
+    unsigned slice_type;
+    ps_bits b;
+
+    if (!hp->sps_valid || !hp->pps_valid || hp->pps_sps_id != hp->sps_id) {
+        return NULL;
+    }
+
+    ps_bits_init(&b, unit + 1, end, PJ_TRUE);
+
+    ps_bits_ue(&b);                     /* first_mb_in_slice */
+    slice_type = ps_bits_ue(&b) % 5;
+    if (slice_type != 2 && slice_type != 4) {
+        /* only intra slices, p and b slices carry reference lists */
+        return NULL;
+    }
+    if (ps_bits_ue(&b) != hp->pps_id) {
+        return NULL;
+    }
+    if (hp->separate_colour_plane) {
+        ps_bits_read(&b, 2);            /* colour_plane_id */
+    }
+    ps_bits_read(&b, hp->log2_max_frame_num);
+    if (!hp->frame_mbs_only) {
+        field_pic = ps_bits_read1(&b);
+        if (field_pic) {
+            ps_bits_read1(&b);          /* bottom_field_flag */
+        }
+    }
+    if (idr) {
+        ps_bits_ue(&b);                 /* idr_pic_id */
+    }
+    if (hp->poc_type == 0) {
+        ps_bits_read(&b, hp->log2_max_poc_lsb);
+        if (hp->bottom_field_pic_order && !field_pic) {
+            ps_bits_se(&b);             /* delta_pic_order_cnt_bottom */
+        }
+    } else if (hp->poc_type == 1 && !hp->delta_pic_order_always_zero) {
+        ps_bits_se(&b);                 /* delta_pic_order_cnt[0] */
+        if (hp->bottom_field_pic_order && !field_pic) {
+            ps_bits_se(&b);             /* delta_pic_order_cnt[1] */
+        }
+    }
+    if (hp->redundant_pic_cnt_present) {
+        ps_bits_ue(&b);                 /* redundant_pic_cnt */
+    }
+    if (nal_ref_idc != 0) {
+        /* dec_ref_pic_marking */
+        if (idr) {
+            ps_bits_read(&b, 2);        /* no_output_of_prior_pics, long_term */
+        } else if (ps_bits_read1(&b)) {
+            unsigned op;
+
+            while ((op = ps_bits_ue(&b)) != 0 && !b.error) {
+                if (op == 1 || op == 3) {
+                    ps_bits_ue(&b);     /* difference_of_pic_nums_minus1 */
+                }
+                if (op == 2) {
+                    ps_bits_ue(&b);     /* long_term_pic_num */
+                }
+                if (op == 3 || op == 6) {
+                    ps_bits_ue(&b);     /* long_term_frame_idx */
+                }
+                if (op == 4) {
+                    ps_bits_ue(&b);     /* max_long_term_frame_idx_plus1 */
+                }
+            }
+        }
+    }
+    *qp_delta = ps_bits_se(&b);
+
+    if (b.error || ps_bits_byte(&b) >= end) {
+        return NULL;
+    }
+
+    return ps_bits_byte(&b);
+}
+
+static void ps_mpeg4_parse_vol(ps_hash_params *hp, const pj_uint8_t *data,
+                               const pj_uint8_t *end)
+{
+    unsigned ver = 1, resolution;
+    ps_bits b;
+
+    hp->vop_time_bits = 0;
+    ps_bits_init(&b, data, end, PJ_FALSE);
+
+    ps_bits_read(&b, 9);                /* random_accessible_vol, type */
+    if (ps_bits_read1(&b)) {            /* is_object_layer_identifier */
+        ver = ps_bits_read(&b, 4);
+        ps_bits_read(&b, 3);            /* priority */
+    }
+    if (ps_bits_read(&b, 4) == 15) {    /* aspect_ratio_info, extended par */
+        ps_bits_read(&b, 16);
+    }
+    if (ps_bits_read1(&b)) {            /* vol_control_parameters */
+        ps_bits_read(&b, 3);            /* chroma_format, low_delay */
+        if (ps_bits_read1(&b)) {        /* vbv_parameters */
+            ps_bits_read(&b, 32);
+            ps_bits_read(&b, 32);
+            ps_bits_read(&b, 15);
+        }
+    }
+    if (ps_bits_read(&b, 2) == 3 && ver != 1) {
+        ps_bits_read(&b, 4);            /* video_object_layer_shape_extension */
+    }
+    ps_bits_read1(&b);                  /* marker */
+    resolution = ps_bits_read(&b, 16);
+    if (b.error || resolution == 0) {
+        return;
+    }
+
+    /* vop_time_increment takes the bits to count to resolution - 1 */
+    for (hp->vop_time_bits = 1; ((resolution - 1) >> hp->vop_time_bits) != 0;
+         ++hp->vop_time_bits)
+        ;
+}
+
+/*
+ * Skip the timing of an mpeg4 vop header, modulo_time_base and
+ * vop_time_increment, which change between otherwise identical vops.
+ * Returns the first byte of what follows, NULL without a vol.
+ */
+static const pj_uint8_t* ps_mpeg4_vop_data(const ps_hash_params *hp,
+                                           const pj_uint8_t *unit,
+                                           const pj_uint8_t *end)
+{
+    ps_bits b;
+
+    if (hp->vop_time_bits == 0) {
+        return NULL;
+    }
+
+    ps_bits_init(&b, unit + 1, end, PJ_FALSE);
+
+    ps_bits_read(&b, 2);                /* vop_coding_type */
+    while (ps_bits_read1(&b) && !b.error)
+        ;                               /* modulo_time_base */
+    ps_bits_read1(&b);                  /* marker */
+    ps_bits_read(&b, hp->vop_time_bits);
+    ps_bits_read1(&b);                  /* marker */
+
+    if (b.error || ps_bits_byte(&b) >= end) {
+        return NULL;
+    }
+
+    return ps_bits_byte(&b);
+}
+
+/*
+ * Hash one nal unit (or mpeg4 start code unit) if it carries slice data,
+ * parameter sets are kept to parse the slice headers. The header fields
+ * which change between otherwise identical i frames are skipped, a slice
+ * which can not be parsed is hashed whole and never matches.
+ */
+static pj_uint64_t ps_hash_unit(ps_hash_params *hp, enum AVCodecID codec_id,
+                                const pj_uint8_t *unit, const pj_uint8_t *end,
+                                pj_uint64_t h)
+{
+    const pj_uint8_t *data = NULL;
+    int qp_delta = 0;
+
+    if (end - unit < 2) {
+        return h;
+    }
+
+    if (codec_id == AV_CODEC_ID_H264) {
+        int type = unit[0] & 0x1f;
+
+        if (type == 7) {
+            ps_h264_parse_sps(hp, unit + 1, end);
+            return h;
+        } else if (type == 8) {
+            ps_h264_parse_pps(hp, unit + 1, end);
+            return h;
+        } else if (type < 1 || type > 5) {
+            return h;
+        }
+
+        data = ps_h264_slice_data(hp, unit, end, &qp_delta);
+        h = ps_hash64((const pj_uint8_t*)&qp_delta, sizeof(qp_delta), h);
+    } else {
+        if (unit[0] >= 0x20 && unit[0] <= 0x2f) {
+            ps_mpeg4_parse_vol(hp, unit + 1, end);
+            return h;
+        } else if (unit[0] != 0xb6) {
+            return h;
+        }
+
+        data = ps_mpeg4_vop_data(hp, unit, end);
+    }
+
+    if (data == NULL) {
+        data = unit;
+    }
+
+    return ps_hash64(data, end - data, h);
+}
+
+/*
+ * Fingerprint the slice data of an annex b i frame. Only coded slices are
+ * hashed (h264 nal 1 - 5, mpeg4 vop), sei, aud and parameter sets are not.
+ */
+static pj_uint64_t ps_bitstream_hash(ps_private *ff, const ps_codec *ppc)
+{
+    const pj_uint8_t *end = ppc->dec_buf + ppc->dec_data_len;
+    const pj_uint8_t *unit = NULL, *p;
+    pj_uint64_t h = 0;
+
+    for (p = ppc->dec_buf; p + 3 <= end; ++p) {
+        if (p[0] != 0 || p[1] != 0 || p[2] != 1) {
+            continue;
+        }
+
+        /* the start code ends the previous unit */
+        if (unit) {
+            h = ps_hash_unit(&ff->hash_params, ppc->video_codec_id, unit, p, h);
+        }
+        unit = p + 3;
+        p += 2;
+    }
+
+    if (unit && unit < end) {
+        h = ps_hash_unit(&ff->hash_params, ppc->video_codec_id, unit, end, h);
+    }
+
+    return h;
+}
+
+/*
+ * Create the worker state of a callee, called with the factory mutex held.
+ * It is allocated outside the factory pool, streams come and go.
+ */
+static ps_live_stream* ps_stream_create(const char *callee_id)
+{
+    ps_live_stream *ls = (ps_live_stream*)calloc(1, sizeof(ps_live_stream));
+
+    if (ls == NULL) {
+        return NULL;
+    }
+
+    pj_ansi_strcpy(ls->callee_id, callee_id);
+    pthread_mutex_init(&ls->mutex, NULL);
+    ls->hash = pj_hash_calc(0, callee_id, PJ_HASH_KEY_STRING);
+    pj_hash_set_np(ps_factory.live_streams, ls->callee_id, PJ_HASH_KEY_STRING,
+                   0, ls->hentry, ls);
+
+    return ls;
+}
+
+/*
+ * Find the worker state of the stream. It is created for motion detection
+ * and native snapshot, continuous decode creates it when the stream is set
+ * live.
+ */
+static ps_live_stream* ps_stream_lookup(ps_private *ff, const ps_codec *ppc)
+{
+    ps_live_stream *ls = ff->live;
+
+    if (ls && pj_ansi_strcmp(ls->callee_id, ppc->callee_id) == 0) {
+        return ls;
+    }
+
+    pj_mutex_lock(ps_factory.mutex);
+    if (ls) {
+        if (ls->ff == ff) {
+            ls->ff = NULL;
+        }
+        ls->codec_refs--;
+        ps_stream_release(ls);
+    }
+    ls = (ps_live_stream*)pj_hash_get(ps_factory.live_streams, ppc->callee_id,
+                                      PJ_HASH_KEY_STRING, NULL);
+    if (ls == NULL && (ps_factory.motion || ps_factory.native_snapshot)) {
+        ls = ps_stream_create(ppc->callee_id);
+    }
+    if (ls) {
+        ls->ff = ff;
+        ls->codec_refs++;
+    }
+    ff->live = ls;
+    pj_mutex_unlock(ps_factory.mutex);
+
+    return ls;
+}
+
+/*
+ * Motion detection: open the motion vector decoder for the stream codec,
+ * on the worker.
+ */
+static pj_status_t ps_motion_open(ps_live_stream *ls, enum AVCodecID codec_id)
+{
+    const AVCodec *dec;
+    AVDictionary *opts = NULL;
+    AVCodecContext *ctx;
+    int err;
+
+    if (ls->mv_ctx && ls->mv_ctx->codec_id == codec_id) {
+        return PJ_SUCCESS;
+    }
+
+    dec = avcodec_find_decoder(codec_id);
+    if (dec == NULL) {
+        return PJ_ENOTFOUND;
+    }
+
+    avcodec_free_context(&ls->mv_ctx);
+
+    ctx = avcodec_alloc_context3(dec);
+    if (ctx == NULL) {
+        return PJ_ENOMEM;
+    }
+
+    /* The vectors are parsed from the bitstream, no picture leaves this
+     * decoder, so the pixel reconstruction is skipped as far as it goes.
+     */
+    ctx->thread_count = 1;
+    ctx->skip_idct = AVDISCARD_ALL;
+    ctx->skip_loop_filter = AVDISCARD_ALL;
+    ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    av_dict_set(&opts, "flags2", "+export_mvs", 0);
+
+    pj_mutex_lock(ps_factory.mutex);
+    err = avcodec_open2(ctx, dec, &opts);
+    pj_mutex_unlock(ps_factory.mutex);
+    av_dict_free(&opts);
+
+    if (err < 0) {
+        print_ps_err(err);
+        avcodec_free_context(&ctx);
+        return PJMEDIA_CODEC_EFAILED;
+    }
+
+    if (ls->mv_frame == NULL && (ls->mv_frame = av_frame_alloc()) == NULL) {
+        avcodec_free_context(&ctx);
+        return PJ_ENOMEM;
+    }
+
+    ls->mv_ctx = ctx;
+    ls->mv_synced = PJ_FALSE;
+    ls->mv_count = 0;
+
+    return PJ_SUCCESS;
+}
+
+static void ps_motion_close(ps_live_stream *ls)
+{
+    avcodec_free_context(&ls->mv_ctx);
+    av_frame_free(&ls->mv_frame);
+    av_freep(&ls->mv_grid);
+    ls->mv_grid_size = 0;
+    ls->mv_synced = PJ_FALSE;
+    ls->mv_count = 0;
+}
+
+/*
+ * Motion detection: sum the motion vector lengths of a picture into the
+ * activity grid, weighted by block area relative to the cell area.
+ */
+static float ps_motion_grid(ps_live_stream *ls, const AVFrame *frame,
+                            const pjmedia_ps_motion_param *param)
+{
+    const AVFrameSideData *sd;
+    unsigned cells = param->grid_w * param->grid_h;
+    float cell_area, activity = 0;
+    unsigned i, n;
+
+    pj_bzero(ls->mv_grid, cells * sizeof(float));
+
+    sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+    if (sd == NULL || frame->width <= 0 || frame->height <= 0) {
+        return 0;
+    }
+
+    cell_area = (float)frame->width * frame->height / cells;
+    n = sd->size / sizeof(AVMotionVector);
+
+    for (i = 0; i < n; ++i) {
+        const AVMotionVector *mv = (const AVMotionVector*)sd->data + i;
+        int dx = mv->motion_x, dy = mv->motion_y;
+        unsigned cx, cy;
+        float len;
+
+        if (dx == 0 && dy == 0) {
+            continue;
+        }
+        if (mv->dst_x < 0 || mv->dst_x >= frame->width ||
+            mv->dst_y < 0 || mv->dst_y >= frame->height)
+        {
+            continue;
+        }
+
+        len = (float)(FFABS(dx) + FFABS(dy)) / (mv->motion_scale ? mv->motion_scale : 1);
+        cx = mv->dst_x * param->grid_w / frame->width;
+        cy = mv->dst_y * param->grid_h / frame->height;
+        ls->mv_grid[cy * param->grid_w + cx] += len * mv->w * mv->h / cell_area;
+    }
+
+    for (i = 0; i < cells; ++i) {
+        activity += ls->mv_grid[i];
+    }
+
+    return activity / cells;
+}
+
+/*
+ * Motion detection: feed a queued frame to the motion vector decoder, on
+ * the worker. Every frame is decoded to keep the reference chain, only one
+ * picture in interval is analysed and passed to on_motion_cb. Decoding
+ * starts at the first i frame.
+ */
+static void ps_motion_work(ps_worker *w, ps_live_job *job)
+{
+    pjmedia_ps_codec_callback *cb = ps_factory.ps_codec_callback;
+    const pjmedia_ps_motion_param *param = &job->motion_param;
+    ps_live_stream *ls = job->ls;
+    unsigned cells = param->grid_w * param->grid_h;
+    AVPacket avpacket;
+    int err;
+
+    if (job->is_i_frame) {
+        pj_status_t status = ps_motion_open(ls, job->codec_id);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(5, (THIS_FILE, status, "Motion detection error"));
+            return;
+        }
+        ls->mv_synced = PJ_TRUE;
+    }
+
+    if (ls->mv_ctx == NULL || !ls->mv_synced) {
+        return;
+    }
+
+    av_fast_malloc(&ls->mv_grid, &ls->mv_grid_size, cells * sizeof(float));
+    if (ls->mv_grid == NULL) {
+        ls->mv_grid_size = 0;
+        return;
+    }
+
+    av_init_packet(&avpacket);
+    avpacket.data = job->data;
+    avpacket.size = (int)job->len;
+    avpacket.flags = job->is_i_frame ? AV_PKT_FLAG_KEY : 0;
+
+    err = avcodec_send_packet(ls->mv_ctx, &avpacket);
+    if (err < 0) {
+        /* lost a reference, wait for the next i frame */
+        print_ps_err(err);
+        ls->mv_synced = PJ_FALSE;
+        avcodec_flush_buffers(ls->mv_ctx);
+        return;
+    }
+
+    while ((err = avcodec_receive_frame(ls->mv_ctx, ls->mv_frame)) >= 0) {
+        if (++ls->mv_count >= param->interval) {
+            float activity = ps_motion_grid(ls, ls->mv_frame, param);
+
+            ls->mv_count = 0;
+            if (activity >= param->threshold) {
+                __atomic_store_n(&ls->mv_pending, PJ_TRUE, __ATOMIC_RELEASE);
+            }
+            if (cb && cb->on_motion_cb) {
+                pj_ansi_strcpy(w->cb_codec.callee_id, ls->callee_id);
+                w->cb_codec.video_codec_id = job->codec_id;
+                (*cb->on_motion_cb)(&w->cb_codec, ls->mv_grid, param->grid_w,
+                                    param->grid_h, activity);
+            }
+        }
+        av_frame_unref(ls->mv_frame);
+    }
+}
+
+static void ps_live_close(ps_live_stream *ls)
+{
+    avcodec_free_context(&ls->ctx);
+    av_frame_free(&ls->frame);
+    ls->synced = PJ_FALSE;
+}
+
+/*
+ * Continuous decode: open the decoder on the first i frame, on the worker.
+ */
+static pj_status_t ps_live_open(ps_live_stream *ls, enum AVCodecID codec_id)
+{
+    const AVCodec *dec;
+    AVCodecContext *ctx;
+    int err;
+
+    if (ls->ctx && ls->ctx->codec_id == codec_id) {
+        return PJ_SUCCESS;
+    }
+
+    dec = avcodec_find_decoder(codec_id);
+    if (dec == NULL) {
+        return PJ_ENOTFOUND;
+    }
+
+    ps_live_close(ls);
+
+    ctx = avcodec_alloc_context3(dec);
+    if (ctx == NULL) {
+        return PJ_ENOMEM;
+    }
+
+    /* Threads as granted to the stream, frame threads hold several
+     * pictures so only big pictures get them, the rest decodes low delay
+     */
+    pj_mutex_lock(ps_factory.mutex);
+    ctx->thread_count = ls->live_param.threads ? ls->live_param.threads : 1;
+    if (ls->live_param.frame_threads && ctx->thread_count > 1) {
+        ctx->thread_type = FF_THREAD_FRAME;
+    } else {
+        ctx->thread_type = FF_THREAD_SLICE;
+        ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    err = avcodec_open2(ctx, dec, NULL);
+    pj_mutex_unlock(ps_factory.mutex);
+
+    if (err < 0) {
+        print_ps_err(err);
+        avcodec_free_context(&ctx);
+        return PJMEDIA_CODEC_EFAILED;
+    }
+
+    if ((ls->frame = av_frame_alloc()) == NULL) {
+        avcodec_free_context(&ctx);
+        return PJ_ENOMEM;
+    }
+
+    ls->ctx = ctx;
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * Continuous decode: decode a queued frame and keep the latest picture. A
+ * broken reference chain waits for the next i frame.
+ */
+static void ps_live_work(ps_live_job *job)
+{
+    ps_live_stream *ls = job->ls;
+    AVPacket avpacket;
+    int err;
+
+    if (job->is_i_frame) {
+        pj_status_t status = ps_live_open(ls, job->codec_id);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(5, (THIS_FILE, status, "Continuous decode error"));
+            return;
+        }
+        ls->synced = PJ_TRUE;
+    }
+
+    if (ls->ctx == NULL || !ls->synced) {
+        return;
+    }
+
+    av_init_packet(&avpacket);
+    avpacket.data = job->data;
+    avpacket.size = (int)job->len;
+    avpacket.flags = job->is_i_frame ? AV_PKT_FLAG_KEY : 0;
+
+    err = avcodec_send_packet(ls->ctx, &avpacket);
+    if (err < 0) {
+        print_ps_err(err);
+        ls->synced = PJ_FALSE;
+        avcodec_flush_buffers(ls->ctx);
+        return;
+    }
+
+    while ((err = avcodec_receive_frame(ls->ctx, ls->frame)) >= 0) {
+        /* Hold exactly one picture per stream, the previous is released */
+        pthread_mutex_lock(&ls->mutex);
+        if (ls->enable) {
+            if (ls->latest == NULL) {
+                ls->latest = av_frame_alloc();
+            }
+            if (ls->latest) {
+                av_frame_unref(ls->latest);
+                av_frame_move_ref(ls->latest, ls->frame);
+            }
+        }
+        pthread_mutex_unlock(&ls->mutex);
+        av_frame_unref(ls->frame);
+    }
+}
+
+/*
+ * Run a job on the worker of its stream. A decoder whose feature was turned
+ * off is closed with the first frame not meant for it.
+ */
+static void ps_stream_work(ps_worker *w, ps_live_job *job)
+{
+    ps_live_stream *ls = job->ls;
+
+    if (job->data == NULL) {
+        if (job->close & PS_CLOSE_FREE) {
+            ps_stream_destroy(ls);
+            return;
+        }
+        if (job->close & PS_CLOSE_LIVE) {
+            ps_live_close(ls);
+        }
+        if (job->close & PS_CLOSE_MOTION) {
+            ps_motion_close(ls);
+        }
+        if (job->close & PS_CLOSE_SNAPSHOT) {
+            ps_native_close(ls);
+        }
+        return;
+    }
+
+    if (job->live && __atomic_load_n(&ls->enable, __ATOMIC_ACQUIRE)) {
+        ps_live_work(job);
+    } else if (ls->ctx) {
+        ps_live_close(ls);
+    }
+
+    if (job->motion) {
+        ps_motion_work(w, job);
+    } else if (ls->mv_ctx) {
+        ps_motion_close(ls);
+    }
+
+    if (job->snapshot) {
+        ps_native_work(w, job);
+    }
+}
+
+static int ps_worker_thread(void *arg)
+{
+    ps_worker *w = (ps_worker*)arg;
+    ps_live_job job;
+
+    for (;;) {
+        pthread_mutex_lock(&w->mutex);
+        while (w->count == 0 && !w->quit) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->quit) {
+            pthread_mutex_unlock(&w->mutex);
+            break;
+        }
+        job = w->jobs[w->head];
+        w->head = (w->head + 1) % PJ_ARRAY_SIZE(w->jobs);
+        w->count--;
+        pthread_mutex_unlock(&w->mutex);
+
+        ps_stream_work(w, &job);
+        free(job.data);
+    }
+
+    return 0;
+}
+
+/* Queue a job to the worker of the stream, frames are refused when the
+ * frame slots are taken.
+ */
+static pj_bool_t ps_worker_push(ps_worker *w, const ps_live_job *job)
+{
+    unsigned limit = job->data ? PS_WORKER_QUEUE : PJ_ARRAY_SIZE(w->jobs);
+
+    if (w->count >= limit) {
+        return PJ_FALSE;
+    }
+
+    w->jobs[(w->head + w->count) % PJ_ARRAY_SIZE(w->jobs)] = *job;
+    w->count++;
+    pthread_cond_signal(&w->cond);
+
+    return PJ_TRUE;
+}
+
+static ps_worker* ps_worker_of(const ps_live_stream *ls)
+{
+    return &ps_factory.workers[ls->hash % ps_factory.worker_cnt];
+}
+
+/* Called with the factory mutex held, one worker per online cpu */
+static pj_status_t ps_workers_start(void)
+{
+    ps_worker *workers;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned i, cnt;
+    pj_status_t status;
+
+    cnt = cpus < 1 ? 1 : (cpus > PS_WORKER_MAX ? PS_WORKER_MAX : (unsigned)cpus);
+
+    workers = (ps_worker*)pj_pool_calloc(ps_factory.pool, cnt, sizeof(ps_worker));
+    if (workers == NULL) {
+        return PJ_ENOMEM;
+    }
+    ps_factory.workers = workers;
+    ps_factory.worker_cnt = cnt;
+
+    for (i = 0; i < cnt; ++i) {
+        pthread_mutex_init(&workers[i].mutex, NULL);
+        pthread_cond_init(&workers[i].cond, NULL);
+        status = pj_thread_create(ps_factory.pool, "ps_worker", &ps_worker_thread,
+                                  &workers[i], 0, 0, &workers[i].thread);
+        if (status != PJ_SUCCESS) {
+            ps_workers_stop();
+            return status;
+        }
+    }
+
+    return PJ_SUCCESS;
+}
+
+static void ps_workers_stop(void)
+{
+    ps_worker *workers = ps_factory.workers;
+    pj_hash_iterator_t it_buf, *it;
+    unsigned i;
+
+    if (workers == NULL) {
+        return;
+    }
+
+    for (i = 0; i < ps_factory.worker_cnt; ++i) {
+        ps_worker *w = &workers[i];
+
+        if (w->thread) {
+            pthread_mutex_lock(&w->mutex);
+            w->quit = PJ_TRUE;
+            pthread_cond_signal(&w->cond);
+            pthread_mutex_unlock(&w->mutex);
+
+            pj_thread_join(w->thread);
+            pj_thread_destroy(w->thread);
+        }
+
+        for (; w->count > 0; w->count--) {
+            ps_live_job *job = &w->jobs[w->head];
+
+            /* unlinked already, queued after the other jobs of the stream */
+            if (job->close & PS_CLOSE_FREE) {
+                ps_stream_destroy(job->ls);
+            }
+            free(job->data);
+            w->head = (w->head + 1) % PJ_ARRAY_SIZE(w->jobs);
+        }
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+    }
+    ps_factory.workers = NULL;
+    ps_factory.worker_cnt = 0;
+
+    /* no worker is left to use the decoders */
+    it = pj_hash_first(ps_factory.live_streams, &it_buf);
+    while (it) {
+        ps_live_stream *ls = (ps_live_stream*)pj_hash_this(ps_factory.live_streams, it);
+
+        ps_live_close(ls);
+        ps_motion_close(ls);
+        ps_native_close(ls);
+        pthread_mutex_lock(&ls->mutex);
+        av_frame_free(&ls->latest);
+        pthread_mutex_unlock(&ls->mutex);
+
+        it = pj_hash_next(ps_factory.live_streams, it);
+    }
+}
+
+/*
+ * Copy the frame to the worker of the stream for continuous decode, motion
+ * detection and native snapshot, the media thread does not decode. After a
+ * frame was refused the following ones are dropped up to the next i frame,
+ * so the decoders never see a gap.
+ */
+static pj_status_t ps_stream_post(ps_live_stream *ls, const ps_codec *ppc,
+                                  pj_bool_t snapshot)
+{
+    ps_worker *w;
+    ps_live_job job;
+    pj_bool_t queued = PJ_FALSE;
+
+    if (ps_factory.workers == NULL) {
+        return PJ_EINVALIDOP;
+    }
+    if (ppc->dec_data_len == 0) {
+        return PJ_SUCCESS;
+    }
+
+    pj_bzero(&job, sizeof(job));
+    job.live = __atomic_load_n(&ls->enable, __ATOMIC_ACQUIRE);
+    job.motion = ps_factory.motion;
+    job.snapshot = snapshot;
+    if (!job.live && !job.motion && !job.snapshot) {
+        return PJ_SUCCESS;
+    }
+    job.motion_param = ps_factory.motion_param;
+    job.is_duplicate = ppc->is_duplicate;
+
+    w = ps_worker_of(ls);
+
+    job.ls = ls;
+    job.codec_id = ppc->video_codec_id;
+    job.is_i_frame = ppc->is_i_frame;
+    job.len = ppc->dec_data_len;
+    job.data = (pj_uint8_t*)malloc(job.len + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (job.data == NULL) {
+        return PJ_ENOMEM;
+    }
+    pj_memcpy(job.data, ppc->dec_buf, job.len);
+    pj_bzero(job.data + job.len, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    pthread_mutex_lock(&w->mutex);
+    if (job.is_i_frame || !ls->gap) {
+        queued = ps_worker_push(w, &job);
+        ls->gap = !queued;
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    if (!queued) {
+        free(job.data);
+        return PJ_ETOOMANY;
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Have the worker close decoders of the stream, PS_CLOSE_* in close */
+static void ps_stream_post_close(ps_live_stream *ls, unsigned close)
+{
+    ps_worker *w;
+    ps_live_job job;
+    pj_bool_t queued;
+
+    if (ps_factory.workers == NULL) {
+        return;
+    }
+
+    w = ps_worker_of(ls);
+    pj_bzero(&job, sizeof(job));
+    job.ls = ls;
+    job.close = close;
+
+    pthread_mutex_lock(&w->mutex);
+    queued = ps_worker_push(w, &job);
+    pthread_mutex_unlock(&w->mutex);
+
+    if (!queued) {
+        PJ_LOG(4, (THIS_FILE, "Worker queue full, decoders of %s closed with their next frame", ls->callee_id));
+    }
+}
+
+/*
+ * Free the worker state, on its worker or when no worker is left.
+ */
+static void ps_stream_destroy(ps_live_stream *ls)
+{
+    ps_live_close(ls);
+    ps_motion_close(ls);
+    ps_native_close(ls);
+    av_frame_free(&ls->latest);
+    pthread_mutex_destroy(&ls->mutex);
+    free(ls);
+}
+
+/*
+ * Unlink the worker state once the stream is not live and no codec holds
+ * it, called with the factory mutex held. The worker frees it after the
+ * jobs queued before. A stream whose free job finds no room stays linked,
+ * a later release or the factory deinit frees it.
+ */
+static void ps_stream_release(ps_live_stream *ls)
+{
+    ps_worker *w;
+    ps_live_job job;
+    pj_bool_t queued;
+
+    if (ls->enable || ls->codec_refs > 0) {
+        return;
+    }
+
+    pj_hash_set(NULL, ps_factory.live_streams, ls->callee_id,
+                PJ_HASH_KEY_STRING, 0, NULL);
+
+    if (ps_factory.workers == NULL) {
+        ps_stream_destroy(ls);
+        return;
+    }
+
+    w = ps_worker_of(ls);
+    pj_bzero(&job, sizeof(job));
+    job.ls = ls;
+    job.close = PS_CLOSE_FREE;
+
+    pthread_mutex_lock(&w->mutex);
+    queued = ps_worker_push(w, &job);
+    pthread_mutex_unlock(&w->mutex);
+
+    if (!queued) {
+        pj_hash_set_np(ps_factory.live_streams, ls->callee_id, PJ_HASH_KEY_STRING,
+                       0, ls->hentry, ls);
+    }
+}
+
+
+/*
+ * Find the call of the rtcp cname and keep its remote uri as the callee
+ * of the stream, so the call table is only scanned when the cname changes.
+ */
+static void ps_resolve_callee(ps_private *ff, const char *cname)
+{
+    unsigned i;
+
+    ff->callee_id[0] = 0;
+    pj_ansi_strncpy(ff->callee_cname, cname, sizeof(ff->callee_cname) - 1);
+    ff->callee_cname[sizeof(ff->callee_cname) - 1] = 0;
+
+    for (i = 0; i < pjsua_var.call_slots; i++) {
+        pjsua_call *call = &PJSUA_CALL(i);
+        pj_str_t *remote_info;
+
+        if (call->inv == NULL || call->inv->dlg == NULL ||
+            pj_strcmp2(&call->cname, cname) != 0)
+        {
+            continue;
+        }
+
+        remote_info = &call->inv->dlg->remote.info_str;
+        if (remote_info->slen + 1 < PJSIP_MAX_URL_SIZE) {
+            pj_memcpy(ff->callee_id, remote_info->ptr, remote_info->slen);
+            ff->callee_id[remote_info->slen] = 0;
+        }
+        return;
+    }
+}
+
+
+static pj_status_t ps_codec_decode( pjmedia_vid_codec *codec,
+                                        pj_size_t pkt_count,
+                                        pjmedia_frame packets[],
+                                        unsigned out_size,
+                                        pjmedia_frame *output)
+{
+    ps_private *ff = (ps_private*)codec->codec_data;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(codec && pkt_count > 0 && packets && output, PJ_EINVAL);
+
+    if (ff->whole) {
+        // assert not support
+        pj_assert(pkt_count==1);
+//        return ps_codec_decode_whole(codec, &packets[0], out_size, output);
+        return PJ_EINVAL;
+    } else {
+        pjmedia_frame whole_frm;
+        ps_live_stream *ls = NULL;
+        pj_bool_t gated, snapshot;
+
+        ps_codec ps;
+        ps.packets = packets;
+        ps.pkt_count = pkt_count;
+        ps.pkt_idx = 0;
+        ps.current_buf = packets[0].buf;
+        ps.remain_buf_len = packets[0].size;
+        ps.dec_buf = ff->dec_buf;
+        ps.dec_buf_size = ff->dec_buf_size;
+        ps.dec_data_len = 0;
+        ps.is_i_frame = PJ_FALSE;
+        ps.callee_id[0] = 0;
+        ps.bitstream_hash = 0;
+        ps.is_duplicate = PJ_FALSE;
+        /* only i frames carry the stream map, p frames keep the last codec */
+        ps.video_codec_id = ff->video_codec_id ? ff->video_codec_id :
+                             (ff->dec ? ff->dec->id : AV_CODEC_ID_NONE);
+        // copy cname from buf
+        if (strlen(output->buf) > 0) {
+            if (!ff->callee_id[0] || strcmp(ff->callee_cname, output->buf) != 0) {
+                ps_resolve_callee(ff, output->buf);
+            }
+            pj_ansi_strcpy(ps.callee_id, ff->callee_id);
+        }
+
+        status = ps_unpacketize(codec, &ps);
+        if (status != PJ_SUCCESS) {
+#ifdef TRACE_PS
+//            FILE *fptr;
+//            char filename[256];
+//            sprintf(filename, "./%d_%d.bin", packets[i].timestamp.u64, i);
+//
+//            if ((fptr = fopen(filename,"ab")) != NULL){
+//               fwrite(packets[i].buf, packets[i].size, 1, fptr);
+//               fclose(fptr);
+//            }
+#endif // TRACE_PS
+            int idx = ps.pkt_idx;
+            PJ_PERROR(3,(THIS_FILE, status, "Unpacketize error. ts: %d, idx: %d, rtp_seq: %d, expect len: %d, real len: %d",
+                packets[idx].timestamp.u64, idx, packets[idx].rtp_seq, ps.total_video_pes_len, ps.dec_data_len));
+        }
+
+        if (ps.is_i_frame && ps.video_codec_id != AV_CODEC_ID_NONE) {
+            ff->video_codec_id = ps.video_codec_id;
+        }
+
+        whole_frm.buf = ff->dec_buf;
+        whole_frm.size = ps.dec_data_len;
+        whole_frm.timestamp = output->timestamp = packets[ps.pkt_idx].timestamp;
+        whole_frm.bit_info = 0;
+
+        if ((ps_factory.live_count > 0 || ps_factory.motion ||
+             ps_factory.native_snapshot) && ps.callee_id[0])
+        {
+            ls = ps_stream_lookup(ff, &ps);
+        }
+
+        /* without motion since the last one i frames are not snapshot, a
+         * stream without callee is never gated
+         */
+        gated = ls && ps.is_i_frame && ps_factory.motion &&
+                ps_factory.motion_param.gate_snapshot &&
+                !__atomic_exchange_n(&ls->mv_pending, PJ_FALSE, __ATOMIC_ACQ_REL);
+
+        if (ps.is_i_frame && ps_factory.dedup && !gated) {
+            ps.bitstream_hash = ps_bitstream_hash(ff, &ps);
+            ps.is_duplicate = (ps.bitstream_hash != 0 && ps.bitstream_hash == ff->last_i_hash);
+            ff->last_i_hash = ps.bitstream_hash;
+        }
+
+        /* The worker decodes, encodes and passes on the native snapshot,
+         * streams without callee go to the decode callback instead
+         */
+        snapshot = ls && ps.is_i_frame && ps_factory.native_snapshot &&
+                   !gated && ps_native_has_sink();
+
+        if (ls) {
+            status = ps_stream_post(ls, &ps, snapshot);
+            if (status != PJ_SUCCESS) {
+                PJ_PERROR(5, (THIS_FILE, status, "Drop frame of %s", ps.callee_id));
+                if (snapshot) {
+                    PJ_PERROR(4, (THIS_FILE, status, "Native snapshot not queued, fall back to decode callback"));
+                    snapshot = PJ_FALSE;
+                }
+            }
+        }
+
+        if (gated || snapshot) {
+            return PJ_SUCCESS;
+        }
 
         if(ps_factory.ps_codec_callback != NULL && ps_factory.ps_codec_callback->on_decode_cb != NULL) {
             if(ps.is_i_frame) {
@@ -0,0 +1,449 @@
+#include "include/ps_event_ring.h"
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/string.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define THIS_FILE   "ps_event_ring.c"
+
+#define CACHE_LINE  64
+
+/*
+ * Bounded ring after Dmitry Vyukov: every cell carries a sequence number
+ * telling if it is free for the producer at pos or full for the reader at
+ * pos, producers claim cells with a single compare and swap.
+ */
+typedef struct ps_event_cell {
+    pj_size_t   seq;
+    ps_event    ev;
+} ps_event_cell;
+
+/* pjsua event which did not fit in the ring */
+typedef struct ps_event_spill {
+    struct ps_event_spill   *next;
+    ps_event                ev;
+} ps_event_spill;
+
+struct ps_event_ring {
+    ps_event_cell   *cells;
+    pj_size_t       mask;
+    sem_t           sem;
+
+    /* Kept events go to the spill list while it is not empty, so they stay
+     * in order. The reader takes it once the ring is empty.
+     */
+    pthread_mutex_t spill_mutex;
+    ps_event_spill  *spill_head;
+    ps_event_spill  *spill_tail;
+    pj_size_t       spilled;
+
+    /* written by the producers */
+    pj_size_t       enqueue_pos __attribute__((aligned(CACHE_LINE)));
+    pj_uint64_t     dropped;
+
+    /* written by the reader */
+    pj_size_t       dequeue_pos __attribute__((aligned(CACHE_LINE)));
+    int             waiting;
+    int             closed;
+};
+
+pj_status_t ps_event_ring_create(unsigned capacity, ps_event_ring **p_ring)
+{
+    ps_event_ring *ring;
+    pj_size_t size = 2, i;
+
+    PJ_ASSERT_RETURN(capacity > 0 && p_ring, PJ_EINVAL);
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    if (posix_memalign((void**)&ring, CACHE_LINE, sizeof(*ring)) != 0) {
+        return PJ_ENOMEM;
+    }
+    pj_bzero(ring, sizeof(*ring));
+
+    ring->cells = (ps_event_cell*)malloc(size * sizeof(ps_event_cell));
+    if (ring->cells == NULL) {
+        free(ring);
+        return PJ_ENOMEM;
+    }
+    for (i = 0; i < size; ++i) {
+        ring->cells[i].seq = i;
+    }
+    ring->mask = size - 1;
+
+    if (sem_init(&ring->sem, 0, 0) != 0) {
+        free(ring->cells);
+        free(ring);
+        return PJ_RETURN_OS_ERROR(errno);
+    }
+    pthread_mutex_init(&ring->spill_mutex, NULL);
+
+    *p_ring = ring;
+
+    return PJ_SUCCESS;
+}
+
+static void wake_reader(ps_event_ring *ring)
+{
+    /* pairs with the fence of the reader going to sleep */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_ACQ_REL))
+    {
+        sem_post(&ring->sem);
+    }
+}
+
+static pj_status_t ring_push(ps_event_ring *ring, const ps_event *ev, pj_bool_t count_drop)
+{
+    ps_event_cell *cell;
+    pj_size_t pos;
+
+    pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        pj_ssize_t dif;
+
+        cell = &ring->cells[pos & ring->mask];
+        dif = (pj_ssize_t)__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pj_ssize_t)pos;
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, PJ_TRUE,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        } else if (dif < 0) {
+            if (count_drop) {
+                __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+            }
+            return PJ_ETOOMANY;
+        } else {
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->ev = *ev;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    wake_reader(ring);
+
+    return PJ_SUCCESS;
+}
+
+pj_status_t ps_event_ring_post(ps_event_ring *ring, const ps_event *ev)
+{
+    PJ_ASSERT_RETURN(ring && ev, PJ_EINVAL);
+
+    if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+        return PJ_EINVALIDOP;
+    }
+
+    return ring_push(ring, ev, PJ_TRUE);
+}
+
+pj_status_t ps_event_ring_post_kept(ps_event_ring *ring, const ps_event *ev)
+{
+    ps_event_spill *spill;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(ring && ev, PJ_EINVAL);
+
+    pthread_mutex_lock(&ring->spill_mutex);
+
+    if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+        status = PJ_EINVALIDOP;
+    } else if (ring->spill_head != NULL ||
+               ring_push(ring, ev, PJ_FALSE) != PJ_SUCCESS)
+    {
+        spill = (ps_event_spill*)malloc(sizeof(ps_event_spill));
+        if (spill == NULL) {
+            __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+            status = PJ_ENOMEM;
+        } else {
+            spill->next = NULL;
+            spill->ev = *ev;
+            if (ring->spill_tail) {
+                ring->spill_tail->next = spill;
+            } else {
+                ring->spill_head = spill;
+            }
+            ring->spill_tail = spill;
+            __atomic_add_fetch(&ring->spilled, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_mutex_unlock(&ring->spill_mutex);
+
+    if (status == PJ_SUCCESS) {
+        wake_reader(ring);
+    }
+
+    return status;
+}
+
+pj_status_t ps_event_post_frame(ps_event_ring *ring, const ps_codec *ps)
+{
+    ps_event ev;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(ring && ps, PJ_EINVAL);
+
+    ev.type = PS_EVENT_FRAME;
+    pj_ansi_strncpy(ev.callee_id, ps->callee_id, sizeof(ev.callee_id) - 1);
+    ev.callee_id[sizeof(ev.callee_id) - 1] = '\0';
+    ev.codec_id = ps->video_codec_id;
+    ev.is_duplicate = ps->is_duplicate;
+    ev.size = ps->dec_data_len;
+
+    ev.buf = (pj_uint8_t*)malloc(ps->dec_data_len + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (ev.buf == NULL) {
+        return PJ_ENOMEM;
+    }
+    memcpy(ev.buf, ps->dec_buf, ps->dec_data_len);
+    /* ffmpeg reads past the end of the packet, keep padding zeroed */
+    memset(ev.buf + ps->dec_data_len, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    status = ps_event_ring_post(ring, &ev);
+    if (status != PJ_SUCCESS) {
+        free(ev.buf);
+    }
+
+    return status;
+}
+
+/* the callbacks run while the account is still valid */
+static void *acc_user_data(pjsua_acc_id acc_id)
+{
+    if (!pjsua_acc_is_valid(acc_id)) {
+        return NULL;
+    }
+
+    return pjsua_acc_get_user_data(acc_id);
+}
+
+static void event_init(ps_event *ev, ps_event_type type, pjsua_acc_id acc_id,
+                       pjsua_call_id call_id)
+{
+    pj_bzero(ev, sizeof(*ev));
+    ev->type = type;
+    ev->acc_id = acc_id;
+    ev->call_id = call_id;
+    ev->acc_user_data = acc_user_data(acc_id);
+}
+
+static void copy_str(char *dst, pj_size_t size, const pj_str_t *src)
+{
+    pj_size_t len = 0;
+
+    if (src && src->slen > 0) {
+        len = PJ_MIN((pj_size_t)src->slen, size - 1);
+        pj_memcpy(dst, src->ptr, len);
+    }
+    dst[len] = '\0';
+}
+
+void ps_event_fill_reg(ps_event *ev, ps_event_type type, pjsua_acc_id acc_id,
+                       pj_bool_t renew, const pjsua_reg_info *info)
+{
+    event_init(ev, type, acc_id, PJSUA_INVALID_ID);
+    ev->renew = renew;
+
+    if (info == NULL) {
+        return;
+    }
+
+    ev->renew = info->renew;
+    if (info->cbparam) {
+        ev->status = info->cbparam->status;
+        ev->code = info->cbparam->code;
+        ev->expiration = (unsigned)info->cbparam->expiration;
+        copy_str(ev->reason, sizeof(ev->reason), &info->cbparam->reason);
+    }
+}
+
+void ps_event_fill_call(ps_event *ev, ps_event_type type, pjsua_call_id call_id)
+{
+    pjsua_call_info ci;
+
+    event_init(ev, type, PJSUA_INVALID_ID, call_id);
+
+    if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS) {
+        return;
+    }
+
+    ev->acc_id = ci.acc_id;
+    ev->acc_user_data = acc_user_data(ci.acc_id);
+    ev->call_state = ci.state;
+    ev->media_status = ci.media_status;
+    ev->code = ci.last_status;
+    copy_str(ev->reason, sizeof(ev->reason), &ci.last_status_text);
+}
+
+pj_status_t ps_event_fill_pager(ps_event *ev, pjsua_call_id call_id,
+                                pjsua_acc_id acc_id, const pj_str_t *from,
+                                const pj_str_t *to, const pj_str_t *mime_type,
+                                const pj_str_t *body)
+{
+    event_init(ev, PS_EVENT_PAGER, acc_id, call_id);
+
+    copy_str(ev->from, sizeof(ev->from), from);
+    copy_str(ev->to, sizeof(ev->to), to);
+    copy_str(ev->mime_type, sizeof(ev->mime_type), mime_type);
+
+    if (body && body->slen > 0) {
+        ev->buf = (pj_uint8_t*)malloc(body->slen);
+        if (ev->buf == NULL) {
+            return PJ_ENOMEM;
+        }
+        pj_memcpy(ev->buf, body->ptr, body->slen);
+        ev->size = (unsigned)body->slen;
+    }
+
+    return PJ_SUCCESS;
+}
+
+void ps_event_fill_acc_released(ps_event *ev, void *acc_user_data)
+{
+    event_init(ev, PS_EVENT_ACC_RELEASED, PJSUA_INVALID_ID, PJSUA_INVALID_ID);
+    ev->acc_user_data = acc_user_data;
+}
+
+static unsigned ring_pop(ps_event_ring *ring, ps_event *out, unsigned max)
+{
+    unsigned n = 0;
+
+    while (n < max) {
+        pj_size_t pos = ring->dequeue_pos;
+        ps_event_cell *cell = &ring->cells[pos & ring->mask];
+
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+            break;
+        }
+
+        out[n++] = cell->ev;
+        __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+        ring->dequeue_pos = pos + 1;
+    }
+
+    return n;
+}
+
+/* Spilled events are newer than the kept events in the ring, so they are
+ * only taken once the ring is empty.
+ */
+static unsigned spill_pop(ps_event_ring *ring, ps_event *out, unsigned max)
+{
+    unsigned n = 0;
+
+    if (__atomic_load_n(&ring->spilled, __ATOMIC_ACQUIRE) == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ring->spill_mutex);
+    while (n < max && ring->spill_head) {
+        ps_event_spill *spill = ring->spill_head;
+
+        out[n++] = spill->ev;
+        ring->spill_head = spill->next;
+        if (ring->spill_head == NULL) {
+            ring->spill_tail = NULL;
+        }
+        free(spill);
+    }
+    __atomic_sub_fetch(&ring->spilled, n, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ring->spill_mutex);
+
+    return n;
+}
+
+static unsigned events_pop(ps_event_ring *ring, ps_event *out, unsigned max)
+{
+    unsigned n = ring_pop(ring, out, max);
+
+    return n > 0 ? n : spill_pop(ring, out, max);
+}
+
+static pj_bool_t ring_ready(ps_event_ring *ring)
+{
+    ps_event_cell *cell = &ring->cells[ring->dequeue_pos & ring->mask];
+
+    return __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) == ring->dequeue_pos + 1 ||
+           __atomic_load_n(&ring->spilled, __ATOMIC_ACQUIRE) > 0 ||
+           __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+}
+
+unsigned ps_event_ring_drain(ps_event_ring *ring, ps_event *out, unsigned max)
+{
+    unsigned n;
+
+    PJ_ASSERT_RETURN(ring && out && max, 0);
+
+    for (;;) {
+        n = events_pop(ring, out, max);
+        if (n > 0 || __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+            /* a post may land between the last pop and the close */
+            return n > 0 ? n : events_pop(ring, out, max);
+        }
+
+        /* producers only touch the semaphore while the reader sleeps */
+        __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (ring_ready(ring) && __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_ACQ_REL)) {
+            continue;
+        }
+
+        /* either nothing is ready or a producer took the flag and posts */
+        while (sem_wait(&ring->sem) != 0 && errno == EINTR) {
+        }
+    }
+}
+
+pj_uint64_t ps_event_ring_dropped(ps_event_ring *ring)
+{
+    PJ_ASSERT_RETURN(ring, 0);
+
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
+
+void ps_event_ring_close(ps_event_ring *ring)
+{
+    PJ_ASSERT_ON_FAIL(ring, return);
+
+    /* no kept post is half way once closed is set */
+    pthread_mutex_lock(&ring->spill_mutex);
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ring->spill_mutex);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&ring->waiting, 0, __ATOMIC_ACQ_REL)) {
+        sem_post(&ring->sem);
+    }
+}
+
+void ps_event_ring_destroy(ps_event_ring *ring)
+{
+    ps_event ev;
+
+    if (ring == NULL) {
+        return;
+    }
+
+    while (events_pop(ring, &ev, 1) == 1) {
+        if (ev.type == PS_EVENT_FRAME || ev.type == PS_EVENT_PAGER) {
+            free(ev.buf);
+        }
+    }
+
+    pthread_mutex_destroy(&ring->spill_mutex);
+    sem_destroy(&ring->sem);
+    free(ring->cells);
+    free(ring);
+}
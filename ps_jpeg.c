@@ -0,0 +1,203 @@
+#include "include/ps_jpeg.h"
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/string.h>
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <jpeglib.h>
+
+
+#define THIS_FILE   "ps_jpeg.c"
+
+#define ALIGN_UP(v, a)  (((v) + (a) - 1) & ~((a) - 1))
+
+/* libjpeg calls exit() on error by default, jump back instead */
+struct ps_jpeg_error {
+    struct jpeg_error_mgr pub;
+    jmp_buf               jmp;
+};
+
+static void ps_jpeg_error_exit(j_common_ptr cinfo)
+{
+    struct ps_jpeg_error *err = (struct ps_jpeg_error*)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    PJ_LOG(3, (THIS_FILE, "Jpeg encode error: %s", msg));
+
+    longjmp(err->jmp, 1);
+}
+
+static void ps_jpeg_output_message(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    PJ_LOG(5, (THIS_FILE, "Jpeg encode: %s", msg));
+}
+
+void ps_jpeg_param_default(ps_jpeg_param *param)
+{
+    param->quality = 85;
+    param->subsamp = PS_JPEG_420;
+    param->optimize = PJ_FALSE;
+}
+
+static const pj_uint8_t* plane_row(const AVFrame *src, int plane, int row, int rows)
+{
+    if (row >= rows) {
+        row = rows - 1;
+    }
+    return src->data[plane] + row * src->linesize[plane];
+}
+
+/* Duplicate every chroma sample horizontally for 4:4:4 */
+static void upsample_row(const pj_uint8_t *src, pj_uint8_t *dst, int width)
+{
+    int x;
+
+    for (x = 0; x < width; ++x) {
+        dst[x] = src[x >> 1];
+    }
+}
+
+pj_status_t ps_jpeg_encode(const AVFrame *src, const ps_jpeg_param *param,
+                           pj_uint8_t **out, unsigned long *out_len)
+{
+    struct jpeg_compress_struct cinfo;
+    struct ps_jpeg_error jerr;
+    JSAMPROW y_rows[16], u_rows[16], v_rows[16];
+    JSAMPARRAY planes[3];
+    pj_uint8_t * volatile up_buf = NULL;
+    int cw, ch, up_w, rows_per_pass, y, i;
+
+    PJ_ASSERT_RETURN(src && param && out && out_len, PJ_EINVAL);
+    PJ_ASSERT_RETURN(src->format == AV_PIX_FMT_YUVJ420P ||
+                     src->format == AV_PIX_FMT_YUV420P, PJ_ENOTSUP);
+
+    /* Jpeg is full range, limited frames must be expanded first */
+    if (src->format != AV_PIX_FMT_YUVJ420P && src->color_range != AVCOL_RANGE_JPEG) {
+        return PJ_EINVALIDOP;
+    }
+
+    cw = (src->width + 1) / 2;
+    ch = (src->height + 1) / 2;
+    up_w = ALIGN_UP(src->width, 8);
+
+    /* libjpeg reads whole blocks, the padding of the rows must cover them */
+    if (src->linesize[0] < ALIGN_UP(src->width, 8) ||
+        src->linesize[1] < ALIGN_UP(cw, 8) || src->linesize[2] < ALIGN_UP(cw, 8)) {
+        return PJ_ENOTSUP;
+    }
+
+    if (param->subsamp == PS_JPEG_444) {
+        up_buf = (pj_uint8_t*)malloc(2 * 8 * up_w);
+        if (up_buf == NULL) {
+            return PJ_ENOMEM;
+        }
+    }
+
+    *out = NULL;
+    *out_len = 0;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = &ps_jpeg_error_exit;
+    jerr.pub.output_message = &ps_jpeg_output_message;
+
+    if (setjmp(jerr.jmp)) {
+        jpeg_destroy_compress(&cinfo);
+        free(up_buf);
+        free(*out);
+        *out = NULL;
+        *out_len = 0;
+        return PJ_EUNKNOWN;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, out, out_len);
+
+    cinfo.image_width = src->width;
+    cinfo.image_height = src->height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_colorspace(&cinfo, JCS_YCbCr);
+    jpeg_set_quality(&cinfo, param->quality, TRUE);
+
+    cinfo.raw_data_in = TRUE;
+    cinfo.optimize_coding = param->optimize ? TRUE : FALSE;
+#if JPEG_LIB_VERSION >= 70
+    cinfo.do_fancy_downsampling = FALSE;
+#endif
+
+    switch (param->subsamp) {
+    case PS_JPEG_420:
+        cinfo.comp_info[0].h_samp_factor = 2;
+        cinfo.comp_info[0].v_samp_factor = 2;
+        rows_per_pass = 16;
+        break;
+    case PS_JPEG_422:
+        cinfo.comp_info[0].h_samp_factor = 2;
+        cinfo.comp_info[0].v_samp_factor = 1;
+        rows_per_pass = 8;
+        break;
+    default:
+        cinfo.comp_info[0].h_samp_factor = 1;
+        cinfo.comp_info[0].v_samp_factor = 1;
+        rows_per_pass = 8;
+        break;
+    }
+    for (i = 1; i < 3; ++i) {
+        cinfo.comp_info[i].h_samp_factor = 1;
+        cinfo.comp_info[i].v_samp_factor = 1;
+    }
+
+    planes[0] = y_rows;
+    planes[1] = u_rows;
+    planes[2] = v_rows;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    for (y = 0; y < src->height; y += rows_per_pass) {
+        for (i = 0; i < rows_per_pass; ++i) {
+            y_rows[i] = (JSAMPROW)plane_row(src, 0, y + i, src->height);
+        }
+
+        switch (param->subsamp) {
+        case PS_JPEG_420:
+            /* Chroma rows are used as they are */
+            for (i = 0; i < 8; ++i) {
+                u_rows[i] = (JSAMPROW)plane_row(src, 1, y / 2 + i, ch);
+                v_rows[i] = (JSAMPROW)plane_row(src, 2, y / 2 + i, ch);
+            }
+            break;
+        case PS_JPEG_422:
+            /* Every chroma row is referenced twice, no copy needed */
+            for (i = 0; i < 8; ++i) {
+                u_rows[i] = (JSAMPROW)plane_row(src, 1, (y + i) / 2, ch);
+                v_rows[i] = (JSAMPROW)plane_row(src, 2, (y + i) / 2, ch);
+            }
+            break;
+        default:
+            for (i = 0; i < 8; ++i) {
+                u_rows[i] = up_buf + i * up_w;
+                v_rows[i] = up_buf + (8 + i) * up_w;
+                upsample_row(plane_row(src, 1, (y + i) / 2, ch), u_rows[i], up_w);
+                upsample_row(plane_row(src, 2, (y + i) / 2, ch), v_rows[i], up_w);
+            }
+            break;
+        }
+
+        jpeg_write_raw_data(&cinfo, planes, rows_per_pass);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(up_buf);
+
+    return PJ_SUCCESS;
+}
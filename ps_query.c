@@ -0,0 +1,231 @@
+#include "include/ps_query.h"
+#include "include/pjsua_internal.h"
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/string.h>
+#include <stdlib.h>
+
+
+#define THIS_FILE   "ps_query.c"
+
+static void copy_str(char *dst, pj_size_t size, const pj_str_t *src)
+{
+    pj_size_t len = 0;
+
+    if (src->slen > 0) {
+        len = PJ_MIN((pj_size_t)src->slen, size - 1);
+        pj_memcpy(dst, src->ptr, len);
+    }
+    dst[len] = '\0';
+}
+
+static pj_uint32_t msec_of(const pj_time_val *t)
+{
+    return (pj_uint32_t)(t->sec * 1000 + t->msec);
+}
+
+pj_status_t ps_query_accounts(ps_acc_entry entries[], unsigned *count)
+{
+    unsigned n = 0, i;
+
+    PJ_ASSERT_RETURN(entries && count, PJ_EINVAL);
+
+    PJSUA_LOCK();
+
+    if (pjsua_var.acc_cnt > *count) {
+        *count = pjsua_var.acc_cnt;
+        PJSUA_UNLOCK();
+        return PJ_ETOOSMALL;
+    }
+
+    for (i = 0; i < pjsua_var.acc_slots && n < *count; ++i) {
+        pjsua_acc_info info;
+        const pjsua_acc_info *ai = &info;
+        ps_acc_entry *e = &entries[n];
+
+        if (!PJSUA_ACC(i).valid || pjsua_acc_get_info(i, &info) != PJ_SUCCESS) {
+            continue;
+        }
+
+        e->id = ai->id;
+        e->is_default = ai->is_default;
+        e->has_registration = ai->has_registration;
+        e->online_status = ai->online_status;
+        e->expires = ai->expires;
+        e->status = ai->status;
+        e->reg_last_err = ai->reg_last_err;
+        copy_str(e->uri, sizeof(e->uri), &ai->acc_uri);
+        copy_str(e->status_text, sizeof(e->status_text), &ai->status_text);
+        copy_str(e->online_status_text, sizeof(e->online_status_text), &ai->online_status_text);
+        ++n;
+    }
+    *count = n;
+
+    PJSUA_UNLOCK();
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * Copy the ids of the calls, the call table must be locked. The calls are
+ * queried one by one after the lock is released, each with its own short
+ * locking, so a scan of thousands of calls never holds up pjsua. ids is
+ * NULL without calls and must be freed.
+ */
+static pj_status_t copy_call_ids(pjsua_call_id **ids, unsigned *cnt)
+{
+    unsigned i, c = 0;
+
+    *ids = NULL;
+    *cnt = 0;
+    if (pjsua_var.call_cnt == 0) {
+        return PJ_SUCCESS;
+    }
+
+    *ids = (pjsua_call_id*)malloc(pjsua_var.call_cnt * sizeof(pjsua_call_id));
+    if (*ids == NULL) {
+        return PJ_ENOMEM;
+    }
+
+    for (i = 0; i < pjsua_var.call_slots && c < pjsua_var.call_cnt; ++i) {
+        if (PJSUA_CALL(i).inv) {
+            (*ids)[c++] = i;
+        }
+    }
+    *cnt = c;
+
+    return PJ_SUCCESS;
+}
+
+/* The number of media of the calls, the call table must be locked. */
+static unsigned media_count(void)
+{
+    unsigned i, n = 0;
+
+    for (i = 0; i < pjsua_var.call_slots; ++i) {
+        if (PJSUA_CALL(i).inv) {
+            n += PJSUA_CALL(i).med_cnt;
+        }
+    }
+
+    return n;
+}
+
+pj_status_t ps_query_calls(ps_call_entry entries[], unsigned *count)
+{
+    pjsua_call_id *ids;
+    unsigned n = 0, cnt, i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(entries && count, PJ_EINVAL);
+
+    PJSUA_LOCK();
+
+    if (pjsua_var.call_cnt > *count) {
+        *count = pjsua_var.call_cnt;
+        PJSUA_UNLOCK();
+        return PJ_ETOOSMALL;
+    }
+
+    status = copy_call_ids(&ids, &cnt);
+
+    PJSUA_UNLOCK();
+
+    if (status != PJ_SUCCESS) {
+        return status;
+    }
+
+    /* Calls ended since the ids were copied are skipped */
+    for (i = 0; i < cnt && n < *count; ++i) {
+        pjsua_call_info ci;
+        ps_call_entry *e = &entries[n];
+
+        if (pjsua_call_get_info(ids[i], &ci) != PJ_SUCCESS) {
+            continue;
+        }
+
+        e->id = ci.id;
+        e->acc_id = ci.acc_id;
+        e->state = ci.state;
+        e->media_status = ci.media_status;
+        e->last_status = ci.last_status;
+        e->media_cnt = ci.media_cnt;
+        e->connect_msec = msec_of(&ci.connect_duration);
+        e->total_msec = msec_of(&ci.total_duration);
+        copy_str(e->remote_info, sizeof(e->remote_info), &ci.remote_info);
+        copy_str(e->call_id, sizeof(e->call_id), &ci.call_id);
+        ++n;
+    }
+    *count = n;
+
+    free(ids);
+
+    return PJ_SUCCESS;
+}
+
+pj_status_t ps_query_streams(ps_stream_entry entries[], unsigned *count)
+{
+    pjsua_call_id *ids;
+    unsigned n = 0, needed, cnt, i, m;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(entries && count, PJ_EINVAL);
+
+    PJSUA_LOCK();
+
+    needed = media_count();
+    if (needed > *count) {
+        *count = needed;
+        PJSUA_UNLOCK();
+        return PJ_ETOOSMALL;
+    }
+
+    status = copy_call_ids(&ids, &cnt);
+
+    PJSUA_UNLOCK();
+
+    if (status != PJ_SUCCESS) {
+        return status;
+    }
+
+    for (i = 0; i < cnt && n < *count; ++i) {
+        pjsua_call_info ci;
+
+        if (pjsua_call_get_info(ids[i], &ci) != PJ_SUCCESS) {
+            continue;
+        }
+
+        for (m = 0; m < ci.media_cnt && n < *count; ++m) {
+            const pjsua_call_media_info *mi = &ci.media[m];
+            ps_stream_entry *e = &entries[n++];
+            pjsua_stream_stat stat;
+
+            pj_bzero(e, sizeof(*e));
+            e->call_id = ci.id;
+            e->med_idx = mi->index;
+            e->type = mi->type;
+            e->dir = mi->dir;
+            e->status = mi->status;
+
+            if (mi->status != PJSUA_CALL_MEDIA_ACTIVE ||
+                pjsua_call_get_stream_stat(ci.id, mi->index, &stat) != PJ_SUCCESS)
+            {
+                continue;
+            }
+
+            e->has_stat = PJ_TRUE;
+            e->rx_pkt = stat.rtcp.rx.pkt;
+            e->rx_bytes = stat.rtcp.rx.bytes;
+            e->rx_loss = stat.rtcp.rx.loss;
+            e->rx_jitter_usec = (pj_uint32_t)stat.rtcp.rx.jitter.mean;
+            e->tx_pkt = stat.rtcp.tx.pkt;
+            e->tx_bytes = stat.rtcp.tx.bytes;
+        }
+    }
+    *count = n;
+
+    free(ids);
+
+    return PJ_SUCCESS;
+}
@@ -0,0 +1,317 @@
+#include "include/ps_yuv.h"
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/string.h>
+
+#include <stdlib.h>
+#include <libyuv.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+#define THIS_FILE   "ps_yuv.c"
+
+#define IS_I420(fmt)    ((fmt) == AV_PIX_FMT_YUV420P || (fmt) == AV_PIX_FMT_YUVJ420P)
+
+/* Limited (mpeg) to full (jpeg) range: (in - offset) * scale in 13 bit
+ * fixed point, rounded, plus center, saturated to 0 - 255. Arithmetic
+ * instead of a table, so 16 samples go through sse2 at a time.
+ */
+#define RANGE_SHIFT     13
+#define LUMA_SCALE      9539    /* 255 / 219 */
+#define CHROMA_SCALE    9326    /* 255 / 224 */
+
+typedef struct range_param {
+    int offset;
+    int scale;
+    int center;
+} range_param;
+
+static const range_param luma_range = { 16, LUMA_SCALE, 0 };
+static const range_param chroma_range = { 128, CHROMA_SCALE, 128 };
+
+static pj_uint8_t clip_uint8(int v)
+{
+    return (pj_uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+#if defined(__SSE2__)
+/* 8 offset samples to 8 expanded ones, (v, 1) pairs times (scale,
+ * rounding) pairs sum to v * scale + rounding in 32 bits.
+ */
+static __m128i expand_epi16(__m128i v, __m128i ones, __m128i coef, __m128i center)
+{
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(v, ones), coef);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(v, ones), coef);
+
+    lo = _mm_srai_epi32(lo, RANGE_SHIFT);
+    hi = _mm_srai_epi32(hi, RANGE_SHIFT);
+
+    return _mm_add_epi16(_mm_packs_epi32(lo, hi), center);
+}
+#endif
+
+static void expand_row(pj_uint8_t *row, int width, const range_param *rp)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i offset = _mm_set1_epi16((short)rp->offset);
+    const __m128i center = _mm_set1_epi16((short)rp->center);
+    const __m128i coef = _mm_set1_epi32(((1 << (RANGE_SHIFT - 1)) << 16) | rp->scale);
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(px, zero), offset);
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(px, zero), offset);
+
+        lo = expand_epi16(lo, ones, coef, center);
+        hi = expand_epi16(hi, ones, coef, center);
+        _mm_storeu_si128((__m128i*)(row + x), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        int v = ((row[x] - rp->offset) * rp->scale + (1 << (RANGE_SHIFT - 1))) >> RANGE_SHIFT;
+        row[x] = clip_uint8(v + rp->center);
+    }
+}
+
+static void expand_plane(pj_uint8_t *plane, int stride, int width, int height,
+                         const range_param *rp)
+{
+    int y;
+
+    for (y = 0; y < height; ++y) {
+        expand_row(plane + y * stride, width, rp);
+    }
+}
+
+pj_bool_t ps_yuv_is_full_range(const AVFrame *frame)
+{
+    return frame->format == AV_PIX_FMT_YUVJ420P ||
+           frame->color_range == AVCOL_RANGE_JPEG;
+}
+
+pj_status_t ps_yuv_expand_range(AVFrame *frame)
+{
+    int cw, ch;
+
+    PJ_ASSERT_RETURN(frame && IS_I420(frame->format), PJ_EINVAL);
+
+    if (ps_yuv_is_full_range(frame)) {
+        frame->format = AV_PIX_FMT_YUVJ420P;
+        return PJ_SUCCESS;
+    }
+
+    cw = (frame->width + 1) / 2;
+    ch = (frame->height + 1) / 2;
+    expand_plane(frame->data[0], frame->linesize[0], frame->width, frame->height, &luma_range);
+    expand_plane(frame->data[1], frame->linesize[1], cw, ch, &chroma_range);
+    expand_plane(frame->data[2], frame->linesize[2], cw, ch, &chroma_range);
+
+    frame->format = AV_PIX_FMT_YUVJ420P;
+    frame->color_range = AVCOL_RANGE_JPEG;
+
+    return PJ_SUCCESS;
+}
+
+pj_status_t ps_yuv_scale(const AVFrame *src, AVFrame *dst, pj_bool_t full_range)
+{
+    int ret;
+
+    PJ_ASSERT_RETURN(src && dst, PJ_EINVAL);
+    PJ_ASSERT_RETURN(IS_I420(src->format) && IS_I420(dst->format), PJ_ENOTSUP);
+
+    if (src->width == dst->width && src->height == dst->height) {
+        ret = I420Copy(src->data[0], src->linesize[0],
+                       src->data[1], src->linesize[1],
+                       src->data[2], src->linesize[2],
+                       dst->data[0], dst->linesize[0],
+                       dst->data[1], dst->linesize[1],
+                       dst->data[2], dst->linesize[2],
+                       src->width, src->height);
+    } else {
+        ret = I420Scale(src->data[0], src->linesize[0],
+                        src->data[1], src->linesize[1],
+                        src->data[2], src->linesize[2],
+                        src->width, src->height,
+                        dst->data[0], dst->linesize[0],
+                        dst->data[1], dst->linesize[1],
+                        dst->data[2], dst->linesize[2],
+                        dst->width, dst->height, kFilterBox);
+    }
+
+    if (ret != 0) {
+        PJ_LOG(3, (THIS_FILE, "Scale %dx%d to %dx%d error: %d",
+                   src->width, src->height, dst->width, dst->height, ret));
+        return PJ_EINVAL;
+    }
+
+    /* Range of dst follows src until expanded */
+    dst->format = src->format;
+    dst->color_range = src->color_range;
+
+    if (full_range) {
+        return ps_yuv_expand_range(dst);
+    }
+
+    return PJ_SUCCESS;
+}
+
+pj_status_t ps_yuv_to_rgb(const AVFrame *src, pj_uint8_t *dst, int dst_stride,
+                          ps_yuv_rgb_fmt fmt)
+{
+    int ret = -1;
+
+    PJ_ASSERT_RETURN(src && dst && IS_I420(src->format), PJ_EINVAL);
+
+#define YUV_ARGS    src->data[0], src->linesize[0], \
+                    src->data[1], src->linesize[1], \
+                    src->data[2], src->linesize[2]
+
+    if (!ps_yuv_is_full_range(src)) {
+        /* libyuv rgb24 is b, g, r in memory, raw is r, g, b */
+        switch (fmt) {
+        case PS_YUV_RGB24:
+            ret = I420ToRAW(YUV_ARGS, dst, dst_stride, src->width, src->height);
+            break;
+        case PS_YUV_BGR24:
+            ret = I420ToRGB24(YUV_ARGS, dst, dst_stride, src->width, src->height);
+            break;
+        case PS_YUV_BGRA:
+            ret = I420ToARGB(YUV_ARGS, dst, dst_stride, src->width, src->height);
+            break;
+        }
+    } else if (fmt == PS_YUV_BGRA) {
+        ret = J420ToARGB(YUV_ARGS, dst, dst_stride, src->width, src->height);
+    } else if (fmt == PS_YUV_BGR24) {
+        ret = I420ToRGB24Matrix(YUV_ARGS, dst, dst_stride, &kYuvJPEGConstants,
+                                src->width, src->height);
+    } else {
+        /* raw is rgb24 with u and v swapped, as libyuv does it */
+        ret = I420ToRGB24Matrix(src->data[0], src->linesize[0],
+                                src->data[2], src->linesize[2],
+                                src->data[1], src->linesize[1],
+                                dst, dst_stride, &kYvuJPEGConstants,
+                                src->width, src->height);
+    }
+
+#undef YUV_ARGS
+
+    return ret == 0 ? PJ_SUCCESS : PJ_EINVAL;
+}
+
+pj_status_t ps_yuv_to_planar_rgb(const AVFrame *src, int width, int height,
+                                 pj_bool_t as_float, void *dst)
+{
+    const pj_uint8_t *y_plane, *u_plane, *v_plane;
+    int y_stride, u_stride, v_stride;
+    pj_uint8_t *scaled = NULL, *argb;
+    int plane_size = width * height;
+    int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    int ret = 0, x, y;
+
+    PJ_ASSERT_RETURN(src && dst && IS_I420(src->format), PJ_EINVAL);
+    PJ_ASSERT_RETURN(width > 0 && height > 0, PJ_EINVAL);
+
+    argb = (pj_uint8_t*)malloc(4 * width);
+    if (argb == NULL) {
+        return PJ_ENOMEM;
+    }
+
+    if (src->width == width && src->height == height) {
+        y_plane = src->data[0]; y_stride = src->linesize[0];
+        u_plane = src->data[1]; u_stride = src->linesize[1];
+        v_plane = src->data[2]; v_stride = src->linesize[2];
+    } else {
+        scaled = (pj_uint8_t*)malloc(plane_size + 2 * cw * ch);
+        if (scaled == NULL) {
+            free(argb);
+            return PJ_ENOMEM;
+        }
+        y_plane = scaled; y_stride = width;
+        u_plane = scaled + plane_size; u_stride = cw;
+        v_plane = u_plane + cw * ch; v_stride = cw;
+
+        ret = I420Scale(src->data[0], src->linesize[0],
+                        src->data[1], src->linesize[1],
+                        src->data[2], src->linesize[2],
+                        src->width, src->height,
+                        (pj_uint8_t*)y_plane, y_stride,
+                        (pj_uint8_t*)u_plane, u_stride,
+                        (pj_uint8_t*)v_plane, v_stride,
+                        width, height, kFilterBilinear);
+    }
+
+    /* One row at a time through argb (b, g, r, a in memory) */
+    for (y = 0; y < height && ret == 0; ++y) {
+        ret = (ps_yuv_is_full_range(src) ? J420ToARGB : I420ToARGB)
+                (y_plane + y * y_stride, y_stride,
+                 u_plane + (y / 2) * u_stride, u_stride,
+                 v_plane + (y / 2) * v_stride, v_stride,
+                 argb, 4 * width, width, 1);
+        if (ret != 0) {
+            break;
+        }
+
+        if (as_float) {
+            float *r = (float*)dst + y * width;
+            float *g = r + plane_size;
+            float *b = g + plane_size;
+
+            for (x = 0; x < width; ++x) {
+                b[x] = argb[4 * x] * (1.0f / 255.0f);
+                g[x] = argb[4 * x + 1] * (1.0f / 255.0f);
+                r[x] = argb[4 * x + 2] * (1.0f / 255.0f);
+            }
+        } else {
+            pj_uint8_t *r = (pj_uint8_t*)dst + y * width;
+            pj_uint8_t *g = r + plane_size;
+            pj_uint8_t *b = g + plane_size;
+
+            for (x = 0; x < width; ++x) {
+                b[x] = argb[4 * x];
+                g[x] = argb[4 * x + 1];
+                r[x] = argb[4 * x + 2];
+            }
+        }
+    }
+
+    free(scaled);
+    free(argb);
+
+    return ret == 0 ? PJ_SUCCESS : PJ_EINVAL;
+}
+
+pj_status_t ps_yuv_crop(const AVFrame *src, AVFrame *view,
+                        int x, int y, int width, int height)
+{
+    PJ_ASSERT_RETURN(src && view && IS_I420(src->format), PJ_EINVAL);
+
+    x = PJ_MAX(x, 0) & ~1;
+    y = PJ_MAX(y, 0) & ~1;
+    width = PJ_MIN(width, src->width - x) & ~1;
+    height = PJ_MIN(height, src->height - y) & ~1;
+    if (width <= 0 || height <= 0) {
+        return PJ_EINVAL;
+    }
+
+    view->data[0] = src->data[0] + y * src->linesize[0] + x;
+    view->data[1] = src->data[1] + (y / 2) * src->linesize[1] + x / 2;
+    view->data[2] = src->data[2] + (y / 2) * src->linesize[2] + x / 2;
+    view->linesize[0] = src->linesize[0];
+    view->linesize[1] = src->linesize[1];
+    view->linesize[2] = src->linesize[2];
+    view->width = width;
+    view->height = height;
+    view->format = src->format;
+    view->color_range = src->color_range;
+
+    return PJ_SUCCESS;
+}
@@ -0,0 +1,270 @@
+package gua
+
+/*
+#include "include/ps_query.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"sync"
+)
+
+/****************************query strings*******************************/
+
+// queryIntern hands out the strings of the previous poll of one table
+// instead of allocating, uris and status texts rarely change between two
+// polls. It keeps what the last two polls saw, so it grows with the number
+// of accounts or calls and a string gone from the table is dropped with
+// the next poll.
+type queryIntern struct {
+	mutex sync.Mutex
+	cur   map[string]string
+	prev  map[string]string
+}
+
+func newQueryIntern() *queryIntern {
+	return &queryIntern{cur: make(map[string]string), prev: make(map[string]string)}
+}
+
+// next starts a poll, the maps are swapped and reused.
+func (qi *queryIntern) next() {
+	qi.mutex.Lock()
+	defer qi.mutex.Unlock()
+
+	qi.prev, qi.cur = qi.cur, qi.prev
+	for s := range qi.cur {
+		delete(qi.cur, s)
+	}
+}
+
+func (qi *queryIntern) intern(p *C.char, size int) string {
+	b := cBytes(p, size)
+
+	qi.mutex.Lock()
+	defer qi.mutex.Unlock()
+
+	// map lookups by string(b) do not allocate
+	if s, ok := qi.cur[string(b)]; ok {
+		return s
+	}
+
+	s, ok := qi.prev[string(b)]
+	if !ok {
+		s = string(b)
+	}
+	qi.cur[s] = s
+
+	return s
+}
+
+var (
+	accStrings  = newQueryIntern()
+	callStrings = newQueryIntern()
+)
+
+// The account and call tables grow up to thousands of entries, the query
+// entries start small and grow to what the last query needed.
+const queryEntries = 64
+
+var (
+	accEntryPool = sync.Pool{New: func() interface{} {
+		entries := make([]C.ps_acc_entry, queryEntries)
+		return &entries
+	}}
+	callEntryPool = sync.Pool{New: func() interface{} {
+		entries := make([]C.ps_call_entry, queryEntries)
+		return &entries
+	}}
+	streamEntryPool = sync.Pool{New: func() interface{} {
+		entries := make([]C.ps_stream_entry, queryEntries)
+		return &entries
+	}}
+)
+
+/****************************accounts*******************************/
+
+// QueryAccounts appends the info of every account to dst[:0] with a single
+// call into pjsua, pass the slice of the previous poll to reuse it.
+func (gc *GuaContext) QueryAccounts(dst []AccountInfo) ([]AccountInfo, error) {
+	pooled := accEntryPool.Get().(*[]C.ps_acc_entry)
+	defer accEntryPool.Put(pooled)
+
+	var count C.uint
+	err := gc.exec.run(func() error {
+		for {
+			count = C.uint(len(*pooled))
+			ret := C.ps_query_accounts(&(*pooled)[0], &count)
+			if ret == C.PJ_ETOOSMALL {
+				*pooled = make([]C.ps_acc_entry, count)
+				continue
+			}
+			if ret != C.PJ_SUCCESS {
+				return errors.New(fmt.Sprintf("query accounts error: %d", ret))
+			}
+
+			return nil
+		}
+	})
+	if err != nil {
+		return dst[:0], err
+	}
+
+	entries := *pooled
+	dst = dst[:0]
+	accStrings.next()
+	for i := 0; i < int(count); i++ {
+		e := &entries[i]
+		dst = append(dst, AccountInfo{
+			id:               AccountId(e.id),
+			isDefault:        e.is_default != 0,
+			uri:              accStrings.intern(&e.uri[0], C.PJSIP_MAX_URL_SIZE),
+			regIsConfigured:  e.has_registration != 0,
+			regIsActive:      e.has_registration > 0 && e.expires > 0 && e.expires != C.PJSIP_EXPIRES_NOT_SPECIFIED && (e.status/100 == 2),
+			regExpiresSec:    int(e.expires),
+			regStatus:        StatusCode(e.status),
+			regStatusText:    accStrings.intern(&e.status_text[0], C.PS_QUERY_TEXT_SIZE),
+			regLastErr:       int(e.reg_last_err),
+			onlineStatus:     e.online_status != 0,
+			onlineStatusText: accStrings.intern(&e.online_status_text[0], C.PS_QUERY_TEXT_SIZE),
+		})
+	}
+
+	return dst, nil
+}
+
+/****************************calls*******************************/
+
+// CallInfo is the state of one call. State and MediaStatus are
+// pjsip_inv_state and pjsua_call_media_status values.
+type CallInfo struct {
+	Id          int
+	AccId       AccountId
+	State       int
+	MediaStatus int
+	LastStatus  StatusCode
+	MediaCount  int
+	// since the call was answered, 0 before
+	ConnectMsec int
+	TotalMsec   int
+	RemoteInfo  string
+	SipCallId   string
+}
+
+// QueryCalls appends the info of every call to dst[:0] with a single call
+// into pjsua.
+func (gc *GuaContext) QueryCalls(dst []CallInfo) ([]CallInfo, error) {
+	pooled := callEntryPool.Get().(*[]C.ps_call_entry)
+	defer callEntryPool.Put(pooled)
+
+	var count C.uint
+	err := gc.exec.run(func() error {
+		for {
+			count = C.uint(len(*pooled))
+			ret := C.ps_query_calls(&(*pooled)[0], &count)
+			if ret == C.PJ_ETOOSMALL {
+				*pooled = make([]C.ps_call_entry, count)
+				continue
+			}
+			if ret != C.PJ_SUCCESS {
+				return errors.New(fmt.Sprintf("query calls error: %d", ret))
+			}
+
+			return nil
+		}
+	})
+	if err != nil {
+		return dst[:0], err
+	}
+
+	entries := *pooled
+	dst = dst[:0]
+	callStrings.next()
+	for i := 0; i < int(count); i++ {
+		e := &entries[i]
+		dst = append(dst, CallInfo{
+			Id:          int(e.id),
+			AccId:       AccountId(e.acc_id),
+			State:       int(e.state),
+			MediaStatus: int(e.media_status),
+			LastStatus:  StatusCode(e.last_status),
+			MediaCount:  int(e.media_cnt),
+			ConnectMsec: int(e.connect_msec),
+			TotalMsec:   int(e.total_msec),
+			RemoteInfo:  callStrings.intern(&e.remote_info[0], C.PJSIP_MAX_URL_SIZE),
+			SipCallId:   callStrings.intern(&e.call_id[0], C.PS_QUERY_TEXT_SIZE),
+		})
+	}
+
+	return dst, nil
+}
+
+/****************************streams*******************************/
+
+// StreamInfo is one media of a call. Type, Dir and Status are pjmedia_type,
+// pjmedia_dir and pjsua_call_media_status values, the counters come from
+// rtcp and are only set for active media.
+type StreamInfo struct {
+	CallId       int
+	Index        int
+	Type         int
+	Dir          int
+	Status       int
+	HasStat      bool
+	RxPackets    uint32
+	RxBytes      uint32
+	RxLoss       uint32
+	RxJitterUsec uint32
+	TxPackets    uint32
+	TxBytes      uint32
+}
+
+// QueryStreams appends every media of every call to dst[:0] with a single
+// call into pjsua.
+func (gc *GuaContext) QueryStreams(dst []StreamInfo) ([]StreamInfo, error) {
+	pooled := streamEntryPool.Get().(*[]C.ps_stream_entry)
+	defer streamEntryPool.Put(pooled)
+
+	var count C.uint
+	err := gc.exec.run(func() error {
+		for {
+			count = C.uint(len(*pooled))
+			ret := C.ps_query_streams(&(*pooled)[0], &count)
+			if ret == C.PJ_ETOOSMALL {
+				*pooled = make([]C.ps_stream_entry, count)
+				continue
+			}
+			if ret != C.PJ_SUCCESS {
+				return errors.New(fmt.Sprintf("query streams error: %d", ret))
+			}
+
+			return nil
+		}
+	})
+	if err != nil {
+		return dst[:0], err
+	}
+
+	entries := *pooled
+	dst = dst[:0]
+	for i := 0; i < int(count); i++ {
+		e := &entries[i]
+		dst = append(dst, StreamInfo{
+			CallId:       int(e.call_id),
+			Index:        int(e.med_idx),
+			Type:         int(e._type),
+			Dir:          int(e.dir),
+			Status:       int(e.status),
+			HasStat:      e.has_stat != 0,
+			RxPackets:    uint32(e.rx_pkt),
+			RxBytes:      uint32(e.rx_bytes),
+			RxLoss:       uint32(e.rx_loss),
+			RxJitterUsec: uint32(e.rx_jitter_usec),
+			TxPackets:    uint32(e.tx_pkt),
+			TxBytes:      uint32(e.tx_bytes),
+		})
+	}
+
+	return dst, nil
+}
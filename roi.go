@@ -0,0 +1,212 @@
+package gua
+
+/*
+#include "include/ps_yuv.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"log"
+	"sync"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// SnapshotRegion is a rectangle of the decoded picture delivered as its
+// own jpeg. Width or Height of the output may be 0 to keep the region
+// size, Quality is 1 to 100, 0 uses the snapshot encoder default.
+type SnapshotRegion struct {
+	Name      string
+	X         int
+	Y         int
+	Width     int
+	Height    int
+	OutWidth  int
+	OutHeight int
+	Quality   int
+}
+
+// RegionConsumer receives the region snapshots of one decoded frame. It is
+// used instead of DecodedDataConsumer.OnConsumer for streams with regions.
+type RegionConsumer interface {
+	OnRegions(calleeId string, regions []SnapshotVariant)
+}
+
+// SetStreamRegions sets the regions snapshots of a callee are cut to, nil
+// goes back to whole pictures.
+func SetStreamRegions(calleeId string, regions []SnapshotRegion) {
+	ss := getStream(calleeId)
+
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.regions = append([]SnapshotRegion(nil), regions...)
+	ss.regionsVersion++
+	ss.lastJpeg = nil
+	ss.lastVariants = nil
+}
+
+func (ss *streamState) snapshotRegions() ([]SnapshotRegion, int) {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	return ss.regions, ss.regionsVersion
+}
+
+/****************************region stage*******************************/
+
+// regionCut is one region of the stage. The crop is a view into the
+// decoded planes, frame is only allocated when the region is scaled or
+// the view can not be fed to the jpeg encoder as it is.
+type regionCut struct {
+	region SnapshotRegion
+	x      int
+	y      int
+	width  int
+	height int
+	frame  *gmf.Frame
+}
+
+// regionStage is built once per stream and rebuilt when the regions or
+// the decoded picture size change.
+type regionStage struct {
+	mutex   sync.Mutex
+	srcW    int
+	srcH    int
+	version int
+	cuts    []*regionCut
+}
+
+func (rs *regionStage) free() {
+	for _, c := range rs.cuts {
+		if c.frame != nil {
+			c.frame.Free()
+		}
+	}
+	rs.cuts = nil
+}
+
+// needsCopy tells if the jpeg encoder would read past the right edge of
+// the source rows, it reads whole 8 pixel blocks.
+func needsCopy(af *C.AVFrame, x, width int) bool {
+	align8 := func(v int) int { return (v + 7) &^ 7 }
+	return x+align8(width) > int(af.linesize[0]) || x/2+align8((width+1)/2) > int(af.linesize[1])
+}
+
+func (rs *regionStage) build(regions []SnapshotRegion, version int, af *C.AVFrame) error {
+	rs.free()
+	rs.srcW, rs.srcH, rs.version = int(af.width), int(af.height), version
+
+	for _, r := range regions {
+		var view C.AVFrame
+		if ret := C.ps_yuv_crop(af, &view, C.int(r.X), C.int(r.Y), C.int(r.Width), C.int(r.Height)); ret != C.PJ_SUCCESS {
+			return errors.New(fmt.Sprintf("region %s outside of %dx%d picture", r.Name, rs.srcW, rs.srcH))
+		}
+
+		c := &regionCut{region: r, width: int(view.width), height: int(view.height)}
+		c.x, c.y = r.X&^1, r.Y&^1
+		rs.cuts = append(rs.cuts, c)
+
+		w, h := outputSize(SnapshotOutput{Width: r.OutWidth, Height: r.OutHeight}, c.width, c.height)
+		if w == c.width && h == c.height && !needsCopy(af, c.x, c.width) {
+			continue
+		}
+
+		c.frame = gmf.NewFrame().SetWidth(w).SetHeight(h).SetFormat(gmf.AV_PIX_FMT_YUVJ420P)
+		if err := c.frame.ImgAlloc(); err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
+
+// encode cuts and encodes every region of a full range frame in parallel.
+func (rs *regionStage) encode(af *C.AVFrame, jc jpegConfig) []SnapshotVariant {
+	variants := make([]SnapshotVariant, len(rs.cuts))
+
+	var wg sync.WaitGroup
+	for i, c := range rs.cuts {
+		wg.Add(1)
+		go func(i int, c *regionCut) {
+			defer wg.Done()
+
+			variants[i].Name = c.region.Name
+
+			var view C.AVFrame
+			if ret := C.ps_yuv_crop(af, &view, C.int(c.x), C.int(c.y), C.int(c.width), C.int(c.height)); ret != C.PJ_SUCCESS {
+				log.Printf("crop %s region error: %d\n", c.region.Name, ret)
+				return
+			}
+
+			src := &view
+			if c.frame != nil {
+				dst := avFrame(c.frame)
+				if ret := C.ps_yuv_scale(src, dst, C.PJ_TRUE); ret != C.PJ_SUCCESS {
+					log.Printf("scale %s region error: %d\n", c.region.Name, ret)
+					return
+				}
+				src = dst
+			}
+			variants[i].Width, variants[i].Height = int(src.width), int(src.height)
+
+			rjc := jc
+			if c.region.Quality > 0 {
+				rjc.SetQuality(c.region.Quality)
+			}
+
+			data, err := encodeTurboJpegAV(src, rjc)
+			if err != nil {
+				log.Printf("encode %s region error: %v\n", c.region.Name, err)
+				return
+			}
+			variants[i].Data = data
+		}(i, c)
+	}
+	wg.Wait()
+
+	return variants
+}
+
+func (ss *streamState) regionStage() *regionStage {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	if ss.regionStageState == nil {
+		ss.regionStageState = &regionStage{version: -1}
+	}
+
+	return ss.regionStageState
+}
+
+// encodeRegions delivers the regions of the decoded frame, it returns false
+// when the stream has no regions or they could not be set up. The frame
+// must be full range already.
+func encodeRegions(ss *streamState, frame *gmf.Frame, rc RegionConsumer) bool {
+	regions, version := ss.snapshotRegions()
+	if len(regions) == 0 {
+		return false
+	}
+
+	af := avFrame(frame)
+
+	rs := ss.regionStage()
+	rs.mutex.Lock()
+	defer rs.mutex.Unlock()
+
+	if rs.version != version || rs.srcW != int(af.width) || rs.srcH != int(af.height) {
+		if err := rs.build(regions, version, af); err != nil {
+			log.Printf("build region stage for callee[%s] error: %v\n", ss.calleeId, err)
+			rs.free()
+			rs.version = -1
+			return false
+		}
+	}
+
+	_, jc := currentSnapshotEncoder()
+	rc.OnRegions(ss.calleeId, rs.encode(af, jc))
+
+	return true
+}
@@ -0,0 +1,100 @@
+package gua
+
+/*
+#include <stdlib.h>
+#include "include/ps_jpeg.h"
+
+*/
+import "C"
+import (
+	"errors"
+	"fmt"
+	"sync"
+	"unsafe"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// Snapshot is a jpeg lent to a SnapshotConsumer. Data may point into C
+// memory and is valid until Release, after which neither the Snapshot nor
+// Data may be used.
+type Snapshot struct {
+	CalleeId string
+	Data     []byte
+
+	cbuf unsafe.Pointer // C owned jpeg, freed on release
+	gbuf []byte         // pooled Go buffer, returned on release
+}
+
+// SnapshotConsumer receives borrowed snapshots. It is used instead of
+// DecodedDataConsumer.OnConsumer, and must Release every snapshot, which
+// it may keep past the call until then.
+type SnapshotConsumer interface {
+	OnSnapshot(s *Snapshot)
+}
+
+var (
+	snapshotPool = sync.Pool{New: func() interface{} { return new(Snapshot) }}
+	jpegBufPool  sync.Pool
+)
+
+// Release gives the memory of the snapshot back.
+func (s *Snapshot) Release() {
+	if s.cbuf != nil {
+		C.free(s.cbuf)
+	}
+	if s.gbuf != nil {
+		jpegBufPool.Put(s.gbuf[:0])
+	}
+
+	*s = Snapshot{}
+	snapshotPool.Put(s)
+}
+
+func newSnapshot(calleeId string) *Snapshot {
+	s := snapshotPool.Get().(*Snapshot)
+	s.CalleeId = calleeId
+	return s
+}
+
+// copySnapshot lends a pooled copy of a jpeg which is only valid during
+// the call that produced it.
+func copySnapshot(calleeId string, jpeg unsafe.Pointer, size int) *Snapshot {
+	s := newSnapshot(calleeId)
+
+	if b, ok := jpegBufPool.Get().([]byte); ok && cap(b) >= size {
+		s.gbuf = b[:size]
+	} else {
+		s.gbuf = make([]byte, size)
+	}
+	copy(s.gbuf, borrowBytes((*C.uint8_t)(jpeg), size))
+	s.Data = s.gbuf
+
+	return s
+}
+
+// encodeBorrowedSnapshot encodes a full range frame and lends the jpeg
+// without copying it into Go memory. Only the mjpeg fallback copies.
+func encodeBorrowedSnapshot(calleeId string, frame *gmf.Frame) (*Snapshot, error) {
+	if enc, jc := currentSnapshotEncoder(); enc == SnapshotEncoderTurboJpeg {
+		param := jc.param()
+
+		var out *C.pj_uint8_t
+		var outLen C.ulong
+		if ret := C.ps_jpeg_encode(avFrame(frame), &param, &out, &outLen); ret == C.PJ_SUCCESS {
+			s := newSnapshot(calleeId)
+			s.cbuf = unsafe.Pointer(out)
+			s.Data = borrowBytes((*C.uint8_t)(unsafe.Pointer(out)), int(outLen))
+			return s, nil
+		}
+	}
+
+	data, err := encodeMjpeg(frame)
+	if err != nil {
+		return nil, errors.New(fmt.Sprintf("encode snapshot error: %v", err))
+	}
+
+	s := newSnapshot(calleeId)
+	s.Data = data
+	return s, nil
+}
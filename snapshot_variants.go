@@ -0,0 +1,255 @@
+package gua
+
+import (
+	"errors"
+	"fmt"
+	"log"
+	"sort"
+	"strconv"
+	"sync"
+
+	"github.com/peace0phmind/gmf"
+)
+
+// SnapshotOutput is one size a snapshot is delivered in. Width or Height may
+// be 0 to keep the aspect ratio, Quality is the jpeg quality, 1 to 100 (best),
+// 0 uses the encoder default.
+type SnapshotOutput struct {
+	Name    string
+	Width   int
+	Height  int
+	Quality int
+}
+
+// SnapshotVariant is a snapshot encoded for one SnapshotOutput.
+type SnapshotVariant struct {
+	Name   string
+	Width  int
+	Height int
+	Data   []byte
+}
+
+// VariantConsumer receives all variants of one decoded frame at once. It is
+// used instead of DecodedDataConsumer.OnConsumer for streams with outputs.
+type VariantConsumer interface {
+	OnVariants(calleeId string, variants []SnapshotVariant)
+}
+
+// SetStreamOutputs sets the sizes the snapshots of a callee are delivered
+// in, nil goes back to a single full size snapshot.
+func SetStreamOutputs(calleeId string, outputs []SnapshotOutput) {
+	ss := getStream(calleeId)
+
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.outputs = append([]SnapshotOutput(nil), outputs...)
+	ss.outputsVersion++
+	ss.lastJpeg = nil
+	ss.lastVariants = nil
+}
+
+func (ss *streamState) snapshotOutputs() ([]SnapshotOutput, int) {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	return ss.outputs, ss.outputsVersion
+}
+
+/****************************scaler pyramid*******************************/
+
+// pyramidLevel scales the previous level (or the decoded picture for the
+// first level) to one output size and encodes it.
+type pyramidLevel struct {
+	output SnapshotOutput
+	width  int
+	height int
+	frame  *gmf.Frame
+	occ    *gmf.CodecCtx
+}
+
+// scalerPyramid is cached per stream and rebuilt when the decoded picture or
+// the outputs change. Levels are ordered from the biggest to the smallest.
+type scalerPyramid struct {
+	mutex   sync.Mutex
+	srcW    int
+	srcH    int
+	srcFmt  int32
+	version int
+	enc     SnapshotEncoder
+	levels  []*pyramidLevel
+}
+
+func outputSize(o SnapshotOutput, srcW, srcH int) (int, int) {
+	w, h := o.Width, o.Height
+
+	switch {
+	case w <= 0 && h <= 0:
+		w, h = srcW, srcH
+	case w <= 0:
+		w = srcW * h / srcH
+	case h <= 0:
+		h = srcH * w / srcW
+	}
+
+	// yuv420p needs even sizes
+	return (w + 1) &^ 1, (h + 1) &^ 1
+}
+
+func (sp *scalerPyramid) free() {
+	for _, l := range sp.levels {
+		if l.frame != nil {
+			l.frame.Free()
+		}
+		if l.occ != nil {
+			gmf.Release(l.occ)
+		}
+	}
+	sp.levels = nil
+}
+
+func (sp *scalerPyramid) build(outputs []SnapshotOutput, version int, srcW, srcH int, srcFmt int32, enc SnapshotEncoder) error {
+	if srcFmt != gmf.AV_PIX_FMT_YUV420P && srcFmt != gmf.AV_PIX_FMT_YUVJ420P {
+		return fmt.Errorf("unsupported pixel format: %d", srcFmt)
+	}
+
+	sp.free()
+	sp.srcW, sp.srcH, sp.srcFmt, sp.version, sp.enc = srcW, srcH, srcFmt, version, enc
+
+	sorted := append([]SnapshotOutput(nil), outputs...)
+	sort.SliceStable(sorted, func(i, j int) bool {
+		wi, hi := outputSize(sorted[i], srcW, srcH)
+		wj, hj := outputSize(sorted[j], srcW, srcH)
+		return wi*hi > wj*hj
+	})
+
+	for _, o := range sorted {
+		l := &pyramidLevel{output: o}
+		l.width, l.height = outputSize(o, srcW, srcH)
+		sp.levels = append(sp.levels, l)
+
+		var err error
+		l.frame = gmf.NewFrame().SetWidth(l.width).SetHeight(l.height).SetFormat(gmf.AV_PIX_FMT_YUVJ420P)
+		if err = l.frame.ImgAlloc(); err != nil {
+			return err
+		}
+
+		// libjpeg-turbo levels encode straight from the frame
+		if enc == SnapshotEncoderTurboJpeg {
+			continue
+		}
+
+		if l.occ = gmf.NewCodecCtx(encoder); l.occ == nil {
+			return errors.New("unable to create encode codec context")
+		}
+		l.occ.SetPixFmt(gmf.AV_PIX_FMT_YUVJ420P).SetWidth(l.width).SetHeight(l.height)
+		l.occ.SetTimeBase(gmf.AVR{Num: 1, Den: 1})
+
+		var pairs []gmf.Pair
+		if o.Quality > 0 {
+			q := strconv.Itoa(mjpegQscale(o.Quality))
+			pairs = []gmf.Pair{{Key: "qmin", Val: q}, {Key: "qmax", Val: q}}
+		}
+		if err = l.occ.Open(gmf.NewDict(pairs)); err != nil {
+			return fmt.Errorf("open %s encoder error: %v", o.Name, err)
+		}
+	}
+
+	return nil
+}
+
+// encode scales the decoded frame down the pyramid, then encodes all levels
+// in parallel. The first level expands the range to full for jpeg.
+func (sp *scalerPyramid) encode(frame *gmf.Frame, jc jpegConfig) []SnapshotVariant {
+	src := frame
+	for _, l := range sp.levels {
+		if err := scaleFrame(src, l.frame, true); err != nil {
+			log.Printf("scale %s variant error: %v\n", l.output.Name, err)
+			return nil
+		}
+		src = l.frame
+	}
+
+	variants := make([]SnapshotVariant, len(sp.levels))
+
+	var wg sync.WaitGroup
+	for i, l := range sp.levels {
+		wg.Add(1)
+		go func(i int, l *pyramidLevel) {
+			defer wg.Done()
+
+			variants[i] = SnapshotVariant{Name: l.output.Name, Width: l.width, Height: l.height}
+
+			if l.occ == nil {
+				ljc := jc
+				if l.output.Quality > 0 {
+					ljc.SetQuality(l.output.Quality)
+				}
+
+				data, err := encodeTurboJpeg(l.frame, ljc)
+				if err != nil {
+					log.Printf("encode %s variant error: %v\n", l.output.Name, err)
+					return
+				}
+				variants[i].Data = data
+				return
+			}
+
+			packets, err := l.occ.Encode([]*gmf.Frame{l.frame}, -1)
+			if err != nil {
+				log.Printf("encode %s variant error: %v\n", l.output.Name, err)
+				return
+			}
+
+			for _, op := range packets {
+				variants[i].Data = op.Data()
+				op.Free()
+			}
+		}(i, l)
+	}
+	wg.Wait()
+
+	return variants
+}
+
+func (ss *streamState) scalerPyramid() *scalerPyramid {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	if ss.pyramid == nil {
+		ss.pyramid = &scalerPyramid{version: -1}
+	}
+
+	return ss.pyramid
+}
+
+// encodeVariants delivers the decoded frame in every output size of the
+// stream, it returns false when the stream has no outputs or they could not
+// be set up, so the plain snapshot is delivered instead.
+func encodeVariants(ss *streamState, frame *gmf.Frame, vc VariantConsumer) bool {
+	outputs, version := ss.snapshotOutputs()
+	if len(outputs) == 0 {
+		return false
+	}
+
+	sp := ss.scalerPyramid()
+	sp.mutex.Lock()
+	defer sp.mutex.Unlock()
+
+	enc, jc := currentSnapshotEncoder()
+
+	if sp.version != version || sp.enc != enc || sp.srcW != frame.Width() || sp.srcH != frame.Height() || sp.srcFmt != frame.Format() {
+		if err := sp.build(outputs, version, frame.Width(), frame.Height(), frame.Format(), enc); err != nil {
+			log.Printf("build scaler pyramid for callee[%s] error: %v\n", ss.calleeId, err)
+			sp.free()
+			sp.version = -1
+			return false
+		}
+	}
+
+	variants := sp.encode(frame, jc)
+	ss.setLastVariants(variants)
+	vc.OnVariants(ss.calleeId, variants)
+
+	return true
+}
@@ -0,0 +1,194 @@
+package gua
+
+import (
+	"sync"
+)
+
+// DecodeClass tells how urgent the snapshots of a stream are.
+type DecodeClass int
+
+const (
+	// background snapshot sweeps
+	DecodeClassBackground DecodeClass = iota
+	// operator live-view
+	DecodeClassInteractive
+	// alarm triggered cameras
+	DecodeClassAlarm
+
+	decodeClassCount = 3
+)
+
+func (dc DecodeClass) String() string {
+	switch dc {
+	case DecodeClassInteractive:
+		return "interactive"
+	case DecodeClassAlarm:
+		return "alarm"
+	default:
+		return "background"
+	}
+}
+
+// priority of the class in the decode scheduler, 0 is served first.
+func (dc DecodeClass) priority() int {
+	switch dc {
+	case DecodeClassInteractive:
+		return 0
+	case DecodeClassAlarm:
+		return 1
+	default:
+		return 2
+	}
+}
+
+/****************************stream state*******************************/
+
+// streamState keeps per callee decode settings and what was learned from
+// previously decoded frames.
+type streamState struct {
+	mutex    sync.Mutex
+	calleeId string
+	class    DecodeClass
+
+	profile     DecodeProfile
+	nextProfile *DecodeProfile
+
+	outputs        []SnapshotOutput
+	outputsVersion int
+	pyramid        *scalerPyramid
+
+	// size of the last decoded picture, 0 until the first decode
+	width  int
+	height int
+
+	// last snapshot, re-emitted for duplicate i frames
+	lastJpeg     []byte
+	lastVariants []SnapshotVariant
+
+	analyticsState *streamAnalytics
+
+	regions          []SnapshotRegion
+	regionsVersion   int
+	regionStageState *regionStage
+
+	// nil unless the stream is decoded on demand
+	lazy *lazyState
+
+	// threads held by the live decoder, nil unless the stream is live
+	liveThreads *decodeThreadConfig
+	liveClass   DecodeClass
+}
+
+var (
+	streamsMutex sync.RWMutex
+	streams      = make(map[string]*streamState)
+)
+
+func getStream(calleeId string) *streamState {
+	streamsMutex.RLock()
+	ss, ok := streams[calleeId]
+	streamsMutex.RUnlock()
+
+	if ok {
+		return ss
+	}
+
+	streamsMutex.Lock()
+	defer streamsMutex.Unlock()
+
+	if ss, ok = streams[calleeId]; !ok {
+		ss = &streamState{calleeId: calleeId, class: DecodeClassBackground}
+		streams[calleeId] = ss
+	}
+
+	return ss
+}
+
+func (ss *streamState) decodeClass() DecodeClass {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	return ss.class
+}
+
+// decodeParams is what a decode needs of the stream, read before the decode
+// so no stream lock is held while decoding.
+type decodeParams struct {
+	class   DecodeClass
+	width   int
+	height  int
+	profile DecodeProfile
+	// profile was requested for the next frame only
+	requested bool
+}
+
+func (ss *streamState) decodeParams() decodeParams {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	dp := decodeParams{class: ss.class, width: ss.width, height: ss.height, profile: ss.profile}
+	if ss.nextProfile != nil {
+		dp.profile, dp.requested = *ss.nextProfile, true
+	}
+
+	return dp
+}
+
+// decoded records the size of a decoded picture and consumes the profile
+// requested for it.
+func (ss *streamState) decoded(dp decodeParams, width, height int) {
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.width, ss.height = width, height
+	if dp.requested && ss.nextProfile != nil && *ss.nextProfile == dp.profile {
+		ss.nextProfile = nil
+	}
+}
+
+// SetStreamDecodeClass sets the decode class of a callee, streams are
+// background until told otherwise.
+func SetStreamDecodeClass(calleeId string, class DecodeClass) {
+	ss := getStream(calleeId)
+
+	ss.mutex.Lock()
+	defer ss.mutex.Unlock()
+
+	ss.class = class
+}
+
+// RemoveStream forgets the settings of a callee.
+func RemoveStream(calleeId string) {
+	streamsMutex.Lock()
+	defer streamsMutex.Unlock()
+
+	if ss, ok := streams[calleeId]; ok {
+		// read the fields, the getters create what is missing
+		ss.mutex.Lock()
+		sp, sa, ls, rs := ss.pyramid, ss.analyticsState, ss.lazy, ss.regionStageState
+		ss.mutex.Unlock()
+
+		if sp != nil {
+			sp.mutex.Lock()
+			sp.free()
+			sp.version = -1
+			sp.mutex.Unlock()
+		}
+		if sa != nil {
+			sa.free()
+		}
+		if ls != nil {
+			ls.free()
+		}
+		// the budget is not kept for a stream which is gone
+		ss.setLiveThreads(DecodeClassBackground, nil)
+		if rs != nil {
+			rs.mutex.Lock()
+			rs.free()
+			rs.version = -1
+			rs.mutex.Unlock()
+		}
+	}
+	delete(streams, calleeId)
+	forgetCalleeId(calleeId)
+}
@@ -0,0 +1,84 @@
+package gua
+
+/*
+#include "include/ps_codecs.h"
+
+*/
+import "C"
+import (
+	"bytes"
+	"sync"
+	"unsafe"
+)
+
+// stringIntern hands out one string per distinct value instead of building
+// a new one with C.GoString every time.
+type stringIntern struct {
+	mutex sync.RWMutex
+	m     map[string]string
+}
+
+func newStringIntern() *stringIntern {
+	return &stringIntern{m: make(map[string]string)}
+}
+
+func (si *stringIntern) intern(b []byte) string {
+	// map lookups by string(b) do not allocate
+	si.mutex.RLock()
+	s, ok := si.m[string(b)]
+	si.mutex.RUnlock()
+
+	if ok {
+		return s
+	}
+
+	si.mutex.Lock()
+	defer si.mutex.Unlock()
+
+	if s, ok = si.m[string(b)]; !ok {
+		s = string(b)
+		si.m[s] = s
+	}
+
+	return s
+}
+
+func (si *stringIntern) forget(s string) {
+	si.mutex.Lock()
+	defer si.mutex.Unlock()
+
+	delete(si.m, s)
+}
+
+// cBytes returns the bytes of a NUL terminated C array of size bytes.
+func cBytes(p *C.char, size int) []byte {
+	b := (*[1 << 30]byte)(unsafe.Pointer(p))[:size:size]
+	if n := bytes.IndexByte(b, 0); n >= 0 {
+		b = b[:n]
+	}
+
+	return b
+}
+
+// Callee ids are interned, every frame of a stream hands out the same
+// string. They are forgotten when the stream is removed.
+var calleeIds = newStringIntern()
+
+func internCalleeId(b []byte) string {
+	return calleeIds.intern(b)
+}
+
+func forgetCalleeId(calleeId string) {
+	calleeIds.forget(calleeId)
+}
+
+// calleeIdOf returns the interned callee id of the codec.
+func calleeIdOf(ps *C.ps_codec) string {
+	return calleeIdFrom(&ps.callee_id[0])
+}
+
+// calleeIdFrom returns the interned callee id of a PJSIP_MAX_URL_SIZE
+// buffer.
+func calleeIdFrom(p *C.char) string {
+	return internCalleeId(cBytes(p, C.PJSIP_MAX_URL_SIZE))
+}
@@ -1,19 +1,79 @@
 package gua
 
 /*
+#include <stdlib.h>
 #include "include/pjsua.h"
 
 
 */
 import "C"
+import "unsafe"
+
+const arenaChunkSize = 1024
 
 func pj2Str(str *C.struct_pj_str_t) string {
 	return C.GoStringN(str.ptr, C.int(str.slen))
 }
 
-func str2Pj(str string) C.struct_pj_str_t {
+/****************************string arena*******************************/
+
+// strArena bump allocates the C strings of a config object from C memory
+// chunks, which are released together. pjsua copies what it keeps, so the
+// strings only need to live until the config was handed over.
+type strArena struct {
+	chunks []arenaChunk
+	used   int
+}
+
+type arenaChunk struct {
+	p    unsafe.Pointer
+	size int
+}
+
+// str2Pj copies str into the arena, the pj_str_t is not NUL terminated.
+func (a *strArena) str2Pj(str string) C.struct_pj_str_t {
 	output_str := C.struct_pj_str_t{}
-	output_str.ptr = C.CString(str)
-	output_str.slen = C.long(len(str))
+
+	n := len(str)
+	if n == 0 {
+		return output_str
+	}
+
+	if len(a.chunks) == 0 || a.used+n > a.chunks[len(a.chunks)-1].size {
+		size := arenaChunkSize
+		if n > size {
+			size = n
+		}
+		a.chunks = append(a.chunks, arenaChunk{p: C.malloc(C.size_t(size)), size: size})
+		a.used = 0
+	}
+
+	p := unsafe.Pointer(uintptr(a.chunks[len(a.chunks)-1].p) + uintptr(a.used))
+	copy((*[1 << 30]byte)(p)[:n:n], str)
+	a.used += n
+
+	output_str.ptr = (*C.char)(p)
+	output_str.slen = C.long(n)
 	return output_str
 }
+
+// reset forgets every string, the first chunk is kept for reuse.
+func (a *strArena) reset() {
+	if len(a.chunks) == 0 {
+		return
+	}
+
+	for _, c := range a.chunks[1:] {
+		C.free(c.p)
+	}
+	a.chunks = a.chunks[:1]
+	a.used = 0
+}
+
+func (a *strArena) free() {
+	for _, c := range a.chunks {
+		C.free(c.p)
+	}
+	a.chunks = nil
+	a.used = 0
+}